@@ -0,0 +1,407 @@
+#include "hospital.h"
+#include "patient.h"
+#include "message_queue.h"
+#include "scheduler.h"
+#include "logger.h"
+#include "department.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <getopt.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/wait.h>
+#include <time.h>
+
+// Benchmark limits and defaults
+#define MAX_BENCH_RESULTS 64
+#define MAX_BENCH_NAME 64
+#define MAX_BENCH_UNIT 16
+#define DEFAULT_TOLERANCE 25.0       // Allowed regression in percent
+#define BENCH_REPETITIONS 5          // Median of this many runs is reported
+#define MSG_BENCH_ITERATIONS 20000
+#define LATENCY_BENCH_ITERATIONS 5000
+#define LOGGER_BENCH_PROCESSES 4
+#define LOGGER_BENCH_MESSAGES 5000
+#define LOGGER_BENCH_FILE "/tmp/hospital_bench_logger.log"
+
+// Single benchmark measurement
+typedef struct {
+    char name[MAX_BENCH_NAME];
+    double value;
+    char unit[MAX_BENCH_UNIT];
+    int higher_is_better;
+} BenchResult;
+
+static BenchResult results[MAX_BENCH_RESULTS];
+static int num_results = 0;
+
+// Record a measurement
+static void add_result(const char *name, double value, const char *unit, int higher_is_better) {
+    if (num_results >= MAX_BENCH_RESULTS) return;
+
+    BenchResult *r = &results[num_results++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    snprintf(r->unit, sizeof(r->unit), "%s", unit);
+    r->value = value;
+    r->higher_is_better = higher_is_better;
+
+    printf("  %-36s %14.2f %s\n", name, value, unit);
+    fflush(stdout);
+}
+
+// Monotonic wall clock in seconds
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Median of repeated runs, to damp scheduler noise
+static double median(double *values, int count) {
+    qsort(values, count, sizeof(double), compare_doubles);
+    return values[count / 2];
+}
+
+// Message transport throughput: one sender, one receiver process
+static void bench_message_throughput(int iterations) {
+    int msg_queue_id = create_message_queue(IPC_PRIVATE);
+    if (msg_queue_id == -1) return;
+
+    Patient *patient = create_patient(1, ROUTE_A);
+    double rates[BENCH_REPETITIONS];
+
+    for (int rep = 0; rep < BENCH_REPETITIONS; rep++) {
+        double start = now_seconds();
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            Message msg;
+            for (int i = 0; i < iterations; i++) {
+                receive_message_from_department(msg_queue_id, OPD, &msg, 1);
+            }
+            _exit(0);
+        }
+
+        for (int i = 0; i < iterations; i++) {
+            send_message_to_department(msg_queue_id, OPD, patient);
+        }
+        waitpid(pid, NULL, 0);
+
+        rates[rep] = iterations / (now_seconds() - start);
+    }
+    add_result("msgq_throughput", median(rates, BENCH_REPETITIONS), "msg/s", 1);
+
+    free(patient);
+    destroy_message_queue(msg_queue_id);
+}
+
+// Message transport latency: ping-pong between two processes
+static void bench_message_latency(int iterations) {
+    int msg_queue_id = create_message_queue(IPC_PRIVATE);
+    if (msg_queue_id == -1) return;
+
+    Patient *patient = create_patient(1, ROUTE_B);
+    double *samples = (double*)malloc(sizeof(double) * iterations);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        Message msg;
+        for (int i = 0; i < iterations; i++) {
+            receive_message_from_department(msg_queue_id, EMERGENCY, &msg, 1);
+            send_message_to_department(msg_queue_id, BILLING, patient);
+        }
+        _exit(0);
+    }
+
+    Message msg;
+    for (int i = 0; i < iterations; i++) {
+        double start = now_seconds();
+        send_message_to_department(msg_queue_id, EMERGENCY, patient);
+        receive_message_from_department(msg_queue_id, BILLING, &msg, 1);
+        samples[i] = (now_seconds() - start) / 2.0;  // One-way latency
+    }
+    waitpid(pid, NULL, 0);
+
+    median(samples, iterations);  // Sorts the samples
+    add_result("msgq_latency_p50", samples[iterations / 2] * 1e9, "ns", 0);
+    add_result("msgq_latency_p99", samples[(iterations * 99) / 100] * 1e9, "ns", 0);
+
+    free(samples);
+    free(patient);
+    destroy_message_queue(msg_queue_id);
+}
+
+// Logger throughput with several processes writing to one log file
+static void bench_logger_contention(int processes, int messages_per_process) {
+    close_logger();
+    if (init_logger(LOGGER_BENCH_FILE) != 0) return;
+
+    pid_t pids[LOGGER_BENCH_PROCESSES];
+    double rates[BENCH_REPETITIONS];
+
+    for (int rep = 0; rep < BENCH_REPETITIONS; rep++) {
+        double start = now_seconds();
+
+        for (int p = 0; p < processes; p++) {
+            pids[p] = fork();
+            if (pids[p] == 0) {
+                for (int i = 0; i < messages_per_process; i++) {
+                    log_message(LOG_INFO, "Department %s: Patient %d arrived",
+                                get_department_name((DepartmentType)(p % NUM_DEPARTMENTS)), i);
+                }
+                _exit(0);
+            }
+        }
+        for (int p = 0; p < processes; p++) {
+            waitpid(pids[p], NULL, 0);
+        }
+
+        rates[rep] = (processes * messages_per_process) / (now_seconds() - start);
+    }
+    add_result("logger_throughput_4proc", median(rates, BENCH_REPETITIONS), "msg/s", 1);
+
+    close_logger();
+    unlink(LOGGER_BENCH_FILE);
+    init_logger("/dev/null");
+}
+
+// Make room in a queue for count messages. Returns -1 if the kernel limit
+// (msgmnb, or what an unprivileged process may raise it to) is too low.
+static int fit_queue(int msg_queue_id, int count) {
+    if (message_queue_capacity(msg_queue_id) >= count) return 0;
+
+    struct msqid_ds info;
+    if (msgctl(msg_queue_id, IPC_STAT, &info) == -1) return -1;
+    info.msg_qbytes = (msglen_t)count * sizeof(Message);
+    if (msgctl(msg_queue_id, IPC_SET, &info) == -1) return -1;
+    return message_queue_capacity(msg_queue_id) >= count ? 0 : -1;
+}
+
+// Scheduler cost per completion message as the patient count grows
+static void bench_scheduler_scaling() {
+    // The whole completion backlog is sent before the scheduler drains it.
+    // 256 fill a default queue (msgmnb 16384 / 64-byte messages); a queue
+    // too small is enlarged, and sizes it still cannot hold are skipped.
+    const int patient_counts[] = {32, 128, 256};
+
+    for (size_t c = 0; c < sizeof(patient_counts) / sizeof(int); c++) {
+        int n = patient_counts[c];
+        int msg_queue_id = create_message_queue(IPC_PRIVATE);
+        if (msg_queue_id == -1) return;
+        if (fit_queue(msg_queue_id, n) != 0) {
+            fprintf(stderr, "Skipping scheduler_completion_n%d: a message queue cannot hold %d completions\n",
+                    n, n);
+            destroy_message_queue(msg_queue_id);
+            continue;
+        }
+
+        Patient **patients = (Patient**)malloc(sizeof(Patient*) * n);
+        double costs[BENCH_REPETITIONS];
+
+        for (int rep = 0; rep < BENCH_REPETITIONS; rep++) {
+            for (int i = 0; i < n; i++) {
+                // Last hop of Route D, so each completion discharges the patient
+                patients[i] = create_patient(i + 1, ROUTE_D);
+                patients[i]->current_dept_index = 2;
+
+                Message completion;
+                completion.msg_type = BILLING + 1;
+                completion.patient_id = patients[i]->id;
+                completion.route_type = ROUTE_D;
+                completion.current_dept_index = 2;
+                send_completion_message(msg_queue_id, &completion, 1);
+            }
+
+            MessageScheduler scheduler;
+            init_message_scheduler(&scheduler, msg_queue_id, msg_queue_id, patients, NULL, NULL);
+            scheduler.num_patients = n;
+            scheduler.start = patients[0]->arrival_time;
+
+            double start = now_seconds();
+            round_robin_message_scheduler(&scheduler);
+            costs[rep] = (now_seconds() - start) / n * 1e9;
+
+            for (int i = 0; i < n; i++) {
+                free(patients[i]);
+            }
+        }
+
+        char name[MAX_BENCH_NAME];
+        snprintf(name, sizeof(name), "scheduler_completion_n%d", n);
+        add_result(name, median(costs, BENCH_REPETITIONS), "ns", 0);
+
+        free(patients);
+        destroy_message_queue(msg_queue_id);
+    }
+}
+
+// End-to-end run of the simulator binary, reported as patients per second
+static void bench_end_to_end(const char *simulator_path) {
+    char resolved[PATH_MAX];
+    if (!realpath(simulator_path, resolved)) {
+        fprintf(stderr, "Simulator not found: %s\n", simulator_path);
+        return;
+    }
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) return;
+
+    double start = now_seconds();
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Run in /tmp so the log file does not clobber the working tree
+        close(pipe_fds[0]);
+        dup2(pipe_fds[1], STDOUT_FILENO);
+        if (chdir("/tmp") != 0) _exit(1);
+        execl(resolved, resolved, (char*)NULL);
+        _exit(1);
+    }
+    close(pipe_fds[1]);
+
+    // Scan the report for the processed patient count
+    FILE *output = fdopen(pipe_fds[0], "r");
+    char line[512];
+    int patients = 0;
+    while (fgets(line, sizeof(line), output)) {
+        sscanf(line, "Total Patients Processed : %d", &patients);
+    }
+    fclose(output);
+
+    int status;
+    waitpid(pid, &status, 0);
+    double elapsed = now_seconds() - start;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || patients == 0) {
+        fprintf(stderr, "End-to-end run failed\n");
+        return;
+    }
+    add_result("e2e_patients_per_sec", patients / elapsed, "patients/s", 1);
+}
+
+// Write results as CSV
+static int write_results(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return -1;
+    }
+
+    fprintf(out, "benchmark,value,unit,better\n");
+    for (int i = 0; i < num_results; i++) {
+        fprintf(out, "%s,%.4f,%s,%s\n", results[i].name, results[i].value,
+                results[i].unit, results[i].higher_is_better ? "higher" : "lower");
+    }
+
+    fclose(out);
+    return 0;
+}
+
+// Compare results with a stored baseline, returns number of regressions
+static int compare_with_baseline(const char *path, double tolerance) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "Failed to open baseline %s\n", path);
+        return -1;
+    }
+
+    printf("\nComparison against baseline %s (tolerance %.1f%%):\n", path, tolerance);
+    printf("  %-36s %14s %14s %9s\n", "benchmark", "baseline", "current", "change");
+
+    int regressions = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        char name[MAX_BENCH_NAME], unit[MAX_BENCH_UNIT], better[16];
+        double baseline;
+        if (sscanf(line, "%63[^,],%lf,%15[^,],%15s", name, &baseline, unit, better) != 4) {
+            continue;  // Header or malformed line
+        }
+
+        for (int i = 0; i < num_results; i++) {
+            if (strcmp(results[i].name, name) != 0) continue;
+
+            double change = baseline != 0.0 ?
+                            (results[i].value - baseline) / baseline * 100.0 : 0.0;
+            int worse = results[i].higher_is_better ? (change < -tolerance) : (change > tolerance);
+            regressions += worse;
+
+            printf("  %-36s %14.2f %14.2f %+8.1f%% %s\n", name, baseline,
+                   results[i].value, change, worse ? "REGRESSION" : "ok");
+            break;
+        }
+    }
+
+    fclose(in);
+    return regressions;
+}
+
+static void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  -o FILE   Write results as CSV to FILE\n");
+    printf("  -b FILE   Compare results against baseline CSV FILE\n");
+    printf("  -t PCT    Regression tolerance in percent (default %.0f)\n", DEFAULT_TOLERANCE);
+    printf("  -s PATH   Simulator binary for the end-to-end benchmark\n");
+    printf("  -q        Quick mode, skip the end-to-end benchmark\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *output_path = NULL;
+    const char *baseline_path = NULL;
+    const char *simulator_path = "bin/hospital_simulator";
+    double tolerance = DEFAULT_TOLERANCE;
+    int quick = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:b:t:s:qh")) != -1) {
+        switch (opt) {
+            case 'o': output_path = optarg; break;
+            case 'b': baseline_path = optarg; break;
+            case 't': tolerance = atof(optarg); break;
+            case 's': simulator_path = optarg; break;
+            case 'q': quick = 1; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    // Hot paths log every event; keep the cost but discard the output
+    init_logger("/dev/null");
+    init_department_configs();
+
+    printf("Smart Hospital Simulator - Benchmarks\n\n");
+    bench_message_throughput(MSG_BENCH_ITERATIONS);
+    bench_message_latency(LATENCY_BENCH_ITERATIONS);
+    bench_logger_contention(LOGGER_BENCH_PROCESSES, LOGGER_BENCH_MESSAGES);
+    bench_scheduler_scaling();
+    if (!quick) {
+        bench_end_to_end(simulator_path);
+    }
+
+    close_logger();
+
+    if (output_path && write_results(output_path) != 0) {
+        return 1;
+    }
+
+    if (baseline_path) {
+        int regressions = compare_with_baseline(baseline_path, tolerance);
+        if (regressions < 0) {
+            return 1;
+        }
+        if (regressions > 0) {
+            printf("\n%d regression(s) detected\n", regressions);
+            return 1;
+        }
+        printf("\nNo regressions detected\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef ANALYTIC_H
+#define ANALYTIC_H
+
+#include "config.h"
+#include "metrics.h"
+
+// Estimate for one department type, over all sites
+typedef struct {
+    int servers;               // Per site
+    double arrival_rate;       // Offered patients per second, all sites
+    double service_mean;       // Seconds
+    double service_scv;        // Squared coefficient of variation of service
+    double arrival_scv;        // Of the arrival stream, busiest site
+    double utilization;        // Offered load per server, busiest site (>= 1 is overloaded)
+    double wait_probability;   // Erlang C, busiest site (1 when overloaded)
+    double avg_waiting_time;   // Seconds per visit, averaged over every visit
+    long visits;
+} StationEstimate;
+
+// Open queueing-network estimate of one configuration
+typedef struct {
+    StationEstimate stations[NUM_DEPARTMENTS];
+    GlobalMetrics metrics;     // Predicted averages; start 0, end the predicted duration
+    int num_sites;
+    double arrival_rate;       // Patients per second into the whole hospital
+    int overloaded;            // Department types at or above full utilization
+    DepartmentType bottleneck; // Highest utilization
+    double compute_seconds;
+} NetworkEstimate;
+
+// Function declarations
+int estimate_network(const SimConfig *config, NetworkEstimate *estimate);
+void print_network_estimate(const NetworkEstimate *estimate);
+void print_estimate_comparison(const NetworkEstimate *estimate, const GlobalMetrics *simulated);
+
+#endif // ANALYTIC_H
@@ -0,0 +1,59 @@
+#ifndef ATTRIBUTION_H
+#define ATTRIBUTION_H
+
+#include "patient.h"
+#include <stdint.h>
+
+#define TAIL_QUANTILE 0.99          // Critical-path breakdown covers patients at or above this
+#define MAX_ATTRIBUTION_ROUTES 10   // Routes listed by name, the rest are summed
+
+// One department visit. The department is the route's hop-th one, so only
+// the times are stored: treatment started at enqueue_time + waiting and
+// ended treatment seconds later.
+typedef struct {
+    double enqueue_time;     // Simulated seconds
+    float waiting;
+    float treatment;
+} JourneyHop;
+
+// Every patient's hops, back to back in route order, in one allocation.
+// A hop is written once, by whoever starts its treatment.
+typedef struct {
+    JourneyHop *hops;
+    int64_t *first_hop;      // Per patient, plus one entry past the last patient
+    uint8_t *route_type;     // Per patient
+    int num_patients;
+    int64_t num_hops;
+} HopArena;
+
+// Waiting of one route's patients, per department
+typedef struct {
+    int64_t patients;
+    double waiting[NUM_DEPARTMENTS];
+    double total_waiting;
+} RouteAttribution;
+
+// Where waiting accumulates, and where the slowest patients' time goes.
+// A journey is a chain of waits and treatments, so for one patient every
+// segment is on the critical path.
+typedef struct {
+    RouteAttribution routes[MAX_ROUTES];
+    RouteAttribution all_routes;
+
+    double tail_threshold;                  // Time in system at TAIL_QUANTILE
+    int64_t tail_patients;                  // At or above the threshold
+    double tail_time;                       // Their summed time in system
+    double tail_waiting[NUM_DEPARTMENTS];
+    double tail_treatment[NUM_DEPARTMENTS];
+    int64_t tail_longest_wait[NUM_DEPARTMENTS];  // Tail patients whose longest wait was here
+} BottleneckAnalysis;
+
+// Function declarations
+int init_hop_arena(HopArena *arena, int num_patients);
+int allocate_hops(HopArena *arena);
+void free_hop_arena(HopArena *arena);
+void record_hop(HopArena *arena, int patient, int hop, double enqueue_time, double start, double end);
+int analyze_hops(const HopArena *arena, BottleneckAnalysis *analysis);
+void print_bottleneck_analysis(const BottleneckAnalysis *analysis);
+
+#endif // ATTRIBUTION_H
@@ -0,0 +1,64 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "des.h"
+#include "attribution.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC "HSIMCKPT"
+#define CHECKPOINT_VERSION 6
+
+// Fixed-size header at offset 0; sections follow at 64-byte aligned offsets.
+// Record sizes are stored so a build with different layouts refuses the file.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t patient_record_size;
+    uint32_t unit_record_size;
+    uint32_t event_record_size;
+    uint32_t hop_record_size;
+    uint32_t pool_record_size;
+
+    uint64_t seed;               // Service times are counter-based, so this is all RNG state
+    double clock;                // Simulated time of the cut; every event before it is done
+    int64_t events_processed;
+    int64_t remaining_departures;
+    int32_t num_patients;
+    int32_t num_units;
+    int64_t num_events;          // Pending events plus messages in flight
+    int64_t num_hops;            // Journey hops of every patient, 0 unless recorded (--attribution)
+    int32_t num_pools;           // Resource pools per site; the section holds every site's
+    uint64_t resource_digest;    // Pools, needs and shift schedules the run was set up with
+    double shift_origin;         // Shift clock at simulated time 0
+
+    uint64_t patients_offset;
+    uint64_t units_offset;
+    uint64_t events_offset;
+    uint64_t hops_offset;
+    uint64_t pools_offset;
+    uint64_t file_size;
+    uint64_t checksum;           // FNV-1a over everything after the header
+} CheckpointHeader;
+
+// A mapped checkpoint; the arrays point into the mapping
+typedef struct {
+    CheckpointHeader *header;
+    DesPatient *patients;
+    DesUnit *units;
+    DesEvent *events;
+    JourneyHop *hops;
+    DesPool *pools;
+    void *mapping;
+    size_t mapping_size;
+} CheckpointImage;
+
+// Function declarations
+int create_checkpoint(const char *path, CheckpointImage *image, int num_patients,
+                      int num_units, int64_t num_events, int64_t num_hops, int num_pools);
+int commit_checkpoint(CheckpointImage *image);
+int open_checkpoint(const char *path, CheckpointImage *image);
+void close_checkpoint(CheckpointImage *image);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,44 @@
+#ifndef COMPARISON_H
+#define COMPARISON_H
+
+#include "config.h"
+#include <stdint.h>
+
+#define DEFAULT_REPLICATIONS 10
+#define MAX_REPLICATIONS 1000
+
+// Metrics compared between two configurations
+typedef enum {
+    COMPARE_WAITING_TIME,
+    COMPARE_TREATMENT_TIME,
+    COMPARE_TIME_IN_SYSTEM,
+    COMPARE_THROUGHPUT,
+    COMPARE_LEFT_WITHOUT_BEING_SEEN,   // Percent of patients
+    NUM_COMPARED_METRICS
+} ComparedMetric;
+
+// One metric over the paired replications
+typedef struct {
+    double baseline;             // Mean over the replications
+    double alternative;
+    double difference;           // Mean of alternative - baseline, pair by pair
+    double half_width;           // Of the difference's 95% confidence interval
+    double pairing_gain;         // Variance of an unpaired difference over the paired one;
+                                 // INFINITY if the pairs never differ, 0 if no run does
+} PairedDifference;
+
+// Alternative against baseline, replication r of both run with seed
+// first_seed + r. Every random draw is keyed on (seed, patient, hop), so
+// the two runs of a pair see the same patients and treatment demands and
+// their difference shows the configuration, not the noise.
+typedef struct {
+    int replications;
+    uint64_t first_seed;
+    PairedDifference metrics[NUM_COMPARED_METRICS];
+} PairedComparison;
+
+// Function declarations
+int run_paired_comparison(const SimConfig *baseline, const SimConfig *alternative, PairedComparison *comparison);
+void print_paired_comparison(const PairedComparison *comparison, const char *alternative_options);
+
+#endif // COMPARISON_H
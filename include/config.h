@@ -0,0 +1,72 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "hospital.h"
+#include "placement.h"
+#include "resource_pool.h"
+#include <stdint.h>
+
+// Execution backend for department workers
+typedef enum {
+    BACKEND_PROCESS,  // fork() per department, SysV message queue + shared memory
+    BACKEND_THREAD,   // pthread per department, in-process queues + heap state
+    BACKEND_EXECUTOR, // Fixed worker pool with work-stealing deques, many departments
+    BACKEND_COROUTINE, // Patient journeys as stackless coroutines on one event loop
+    BACKEND_DES,      // Sequential discrete-event simulation, not paced to real time
+    BACKEND_PDES      // Parallel discrete-event simulation, one thread per logical process
+} BackendType;
+
+#define UNLIMITED_WAITING_ROOM -1
+
+// Analytic queueing-network estimate
+typedef enum {
+    ESTIMATE_NONE,
+    ESTIMATE_WITH_RUN,  // Print it before the run and compare after
+    ESTIMATE_ONLY       // Print it instead of running
+} EstimateMode;
+
+// Simulation configuration from the command line
+typedef struct {
+    BackendType backend;
+    int num_patients;
+    int num_departments;   // Service units (executor/DES backends, multiple of NUM_DEPARTMENTS)
+    int num_workers;       // Executor worker threads or parallel DES logical processes, 0 = one per online CPU
+    double time_scale;     // Wall seconds per simulated second (executor/coroutine backends)
+    uint64_t seed;         // Random seed for treatment durations, 0 = derive from the clock
+    int deterministic;     // Process/thread: report times from the simulated clock
+    const char *record_path;  // Process/thread: write the treatment order here
+    const char *replay_path;  // Process/thread: enforce the treatment order from this log
+    CpuPlacement placement; // CPU pinning for the scheduler and department workers
+    int dispatch_credits;   // Process/thread: patients in flight per department
+    const char *checkpoint_path; // DES: write a checkpoint here at checkpoint_time and stop
+    double checkpoint_time;      // Simulated seconds
+    const char *restore_path;    // DES: resume from this checkpoint
+    const char *trace_path;      // DES: one patient per record of this arrival trace
+    const char *convert_path;    // Write the trace in binary form here and exit
+    const char *series_path;     // DES: columnar time series of department state
+    double series_interval;      // Simulated seconds between time-series samples
+    int attribution;             // DES: record every hop and attribute waiting to departments
+    int waiting_room[NUM_DEPARTMENTS];  // DES: waiting places per service unit, UNLIMITED_WAITING_ROOM if unbounded
+    double patience[NUM_DEPARTMENTS];   // DES: mean seconds a patient waits before leaving, 0 = forever
+    ResourcePlan resources;      // Pools the departments draw from (process, thread and DES backends)
+    const char *instance;        // Names this run's IPC objects and log, NULL = process ID
+    int clean_ipc;               // Remove leftover IPC objects and exit
+    const char *clean_instance;  // ...of this instance only, NULL = every exited instance
+    EstimateMode estimate;       // Analytic estimate of the configuration
+    const char *export_path;     // Stream every discharged patient here (CSV, or binary for *.bin)
+    int slowest_journeys;        // Slowest journeys listed after the run, 0 = none
+    int steady_state_batches;    // Batch means after MSER-5 warm-up truncation, 0 = none
+    const char *compare_options; // Options the alternative adds to these in a paired comparison, NULL = none
+    int replications;            // Paired runs of each configuration in a comparison
+    int keep_patients;           // Copy every patient into SimResults (the command line streams them instead)
+    int quiet;                   // Library runs: no console output, results only
+} SimConfig;
+
+// Function declarations
+void init_sim_config(SimConfig *config);
+int parse_command_line(int argc, char *argv[], SimConfig *config);
+int parse_alternative_config(int argc, char *argv[], const char *options, SimConfig *alternative);
+void print_usage(const char *program);
+const char* get_backend_name(BackendType backend);
+
+#endif // CONFIG_H
@@ -2,14 +2,15 @@
 #define DEPARTMENT_H
 
 #include "hospital.h"
-#include <semaphore.h>
+#include "shared_memory.h"
 
 // Department information structure
 typedef struct {
     DepartmentType type;
     char name[MAX_DEPT_NAME];
     int resource_count;
-    const char *sem_name;
+    double service_time_min;   // Treatment duration bounds (seconds)
+    double service_time_max;
 } DepartmentInfo;
 
 // Global department configurations
@@ -19,7 +20,8 @@ extern DepartmentInfo department_configs[NUM_DEPARTMENTS];
 void init_department_configs();
 const char* get_department_name(DepartmentType type);
 int get_department_resources(DepartmentType type);
-const char* get_department_semaphore_name(DepartmentType type);
-void department_process(DepartmentType dept_type);
+void department_process(DepartmentType dept_type, int msg_queue_id, int return_queue_id, int shm_id);
+void department_service_loop(DepartmentType dept_type, int msg_queue_id, int return_queue_id,
+                             HospitalState *hospital_state);
 
 #endif // DEPARTMENT_H
@@ -0,0 +1,72 @@
+#ifndef DES_H
+#define DES_H
+
+#include "config.h"
+#include "metrics.h"
+#include <stdint.h>
+
+// Event kinds, ordered so a departure sorts before an arrival at equal keys
+#define DES_DEPART 0   // Treatment at a unit ends, server is released
+#define DES_ARRIVE 1   // Patient joins a unit's queue
+#define DES_RENEGE 2   // Patient's patience runs out while waiting
+
+// Patient status
+#define DES_ACTIVE 0    // Being treated, between departments, or discharged
+#define DES_QUEUED 1    // In a unit's waiting line
+#define DES_BALKED 2    // Left on arrival: the waiting room was full
+#define DES_RENEGED 3   // Left the waiting line: patience ran out
+
+// Timestamped event. Events are totally ordered by (time, patient, hop, kind),
+// which does not depend on how units are partitioned, so every partitioning
+// processes each unit's events in the same order.
+typedef struct {
+    double time;         // Simulated seconds since start
+    int32_t patient;
+    uint16_t unit;
+    uint8_t hop;         // Index of the unit's department in the patient's route
+    uint8_t kind;
+} DesEvent;
+
+// Patient state; written only by the logical process currently holding it
+typedef struct {
+    double arrival_time;
+    double enqueue_time;
+    double total_waiting_time;
+    double total_treatment_time;
+    double discharge_time;
+    int32_t next_waiting;    // FIFO link in a unit's waiting line
+    uint8_t route_type;
+    uint8_t hop;
+    uint8_t triage;          // From an arrival trace, 0 if not recorded
+    uint8_t status;
+} DesPatient;
+
+// One department instance, owned by exactly one logical process
+typedef struct {
+    int32_t type;            // DepartmentType
+    int32_t lp;
+    int32_t capacity;
+    int32_t busy;
+    int32_t wait_head;
+    int32_t wait_tail;
+    int32_t queue_length;
+    int32_t max_queue_length;
+    int64_t served;
+    int64_t balked;
+    int64_t reneged;
+    DepartmentOccupancy occupancy;   // From simulated time 0, kept across checkpoints
+} DesUnit;
+
+// One resource pool at one site, drawn on by that site's units that need it
+typedef struct {
+    int32_t capacity;
+    int32_t in_use;
+    int64_t acquisitions;
+    int64_t queued;                  // Patients who joined a line while every unit was in use
+    DepartmentOccupancy occupancy;   // Busy level is units in use, from simulated time 0
+} DesPool;
+
+// Function declarations
+int run_des_simulation(const SimConfig *config, SimResults *results);
+
+#endif // DES_H
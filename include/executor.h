@@ -0,0 +1,10 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "config.h"
+#include "metrics.h"
+
+// Function declarations
+int run_executor_simulation(const SimConfig *config, SimResults *results);
+
+#endif // EXECUTOR_H
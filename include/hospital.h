@@ -23,17 +23,10 @@ typedef enum {
 
 // System constants
 #define MAX_PATIENTS 100
+#define DEFAULT_NUM_PATIENTS 12
+#define MAX_DEPARTMENT_UNITS 1000  // Service units for the executor backend
 #define MAX_DEPT_NAME 50
 #define LOG_FILE "hospital_simulation.log"
-#define SHM_KEY 0x1234
-#define MSG_QUEUE_BASE_KEY 0x2000
-
-// Semaphore names
-#define SEM_EMERGENCY "/sem_emergency"
-#define SEM_OPD "/sem_opd"
-#define SEM_RADIOLOGY "/sem_radiology"
-#define SEM_PHARMACY "/sem_pharmacy"
-#define SEM_BILLING "/sem_billing"
 
 // Resource counts per department
 #define EMERGENCY_DOCTORS 2
@@ -46,6 +39,15 @@ typedef enum {
 #define TREATMENT_TIME_MIN 1
 #define TREATMENT_TIME_MAX 3
 
+// Longest wait for every department to start serving (in milliseconds)
+#define DEPARTMENT_STARTUP_TIMEOUT 10000
+
+// Delay between initial patient dispatches (in microseconds)
+#define DISPATCH_INTERVAL 100000  // 100ms
+
+// Patients sent to one department and not yet returned (process/thread backends)
+#define DEFAULT_DISPATCH_CREDITS 32
+
 // Round Robin time quantum (in microseconds for message processing)
 #define TIME_QUANTUM 100000  // 100ms
 
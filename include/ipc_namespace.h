@@ -0,0 +1,21 @@
+#ifndef IPC_NAMESPACE_H
+#define IPC_NAMESPACE_H
+
+#include <sys/types.h>
+
+#define MAX_INSTANCE_NAME 32
+
+// SysV objects owned by one simulator instance
+typedef enum {
+    IPC_OBJECT_STATE = 1,   // Shared hospital state
+    IPC_OBJECT_QUEUE = 2,   // Department message queue
+    IPC_OBJECT_RETURN = 3   // Completion queue back to the scheduler
+} IpcObject;
+
+// Function declarations
+int set_ipc_instance(const char *name);
+const char* get_ipc_instance();
+key_t instance_ipc_key(IpcObject object);
+int clean_ipc_instances(const char *name);
+
+#endif // IPC_NAMESPACE_H
@@ -0,0 +1,45 @@
+#ifndef JOURNEY_H
+#define JOURNEY_H
+
+#include "config.h"
+#include "metrics.h"
+#include "hospital.h"
+#include <stdint.h>
+
+// Result of resuming a journey coroutine
+typedef enum {
+    JOURNEY_SUSPENDED,
+    JOURNEY_DONE
+} JourneyStatus;
+
+// Stackless coroutine frame for one patient's journey. Only these fields
+// survive a suspension, so a suspended journey costs sizeof(Journey) bytes.
+typedef struct Journey {
+    int patient_id;
+    int resume_point;          // Line of the last await, 0 before the first resume
+    uint8_t route_type;
+    uint8_t hop;               // Index of the current department in the route
+    double arrival_time;       // Simulated seconds since start
+    double enqueue_time;
+    double total_waiting_time;
+    double total_treatment_time;
+    double discharge_time;
+    struct Journey *next;      // Link in a department's waiting line
+} Journey;
+
+// Coroutine helpers (switch-based, in the style of protothreads).
+// Locals do not survive an await; keep state in the Journey frame.
+#define JOURNEY_BEGIN(j) switch ((j)->resume_point) { case 0:
+#define JOURNEY_AWAIT(j, operation) \
+    do { \
+        (j)->resume_point = __LINE__; \
+        operation; \
+        return JOURNEY_SUSPENDED; \
+        case __LINE__:; \
+    } while (0)
+#define JOURNEY_END(j) } (j)->resume_point = -1; return JOURNEY_DONE
+
+// Function declarations
+int run_coroutine_simulation(const SimConfig *config, SimResults *results);
+
+#endif // JOURNEY_H
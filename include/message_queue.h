@@ -4,6 +4,20 @@
 #include "patient.h"
 #include <sys/msg.h>
 
+// Message type used by departments to report completed treatments. They go
+// on a return queue of their own, so dispatches and completions never share
+// one queue's space; msg_type still names the department that sent them.
+#define COMPLETION_MSG_TYPE (NUM_DEPARTMENTS + 1)
+
+// Patient ID carried by the message that stops a department worker
+#define SHUTDOWN_PATIENT_ID -1
+
+// Message transport behind the queue API
+typedef enum {
+    TRANSPORT_SYSV,    // Kernel message queue, shared across processes
+    TRANSPORT_INPROC   // Mutex/condvar queue, shared across threads
+} TransportType;
+
 // Message structure for IPC
 typedef struct {
     long msg_type;  // Department type (1-5)
@@ -11,6 +25,10 @@ typedef struct {
     RouteType route_type;
     int current_dept_index;
     time_t sent_time;
+    double enqueue_time;    // hospital_clock() at dispatch: wall-clock waiting starts here
+    double sim_time;        // Simulated clock: ready at the department, or treatment end on completion
+    double waiting_time;    // Completion: waiting and treatment at this department
+    double treatment_time;
 } Message;
 
 // Message buffer with header
@@ -20,9 +38,14 @@ typedef struct {
 } MessageBuffer;
 
 // Function declarations
+void set_message_transport(TransportType transport);
 int create_message_queue(int key);
+int message_queue_capacity(int msg_queue_id);
 int send_message_to_department(int msg_queue_id, DepartmentType dept, Patient *patient);
 int receive_message_from_department(int msg_queue_id, DepartmentType dept, Message *msg, int blocking);
+int send_completion_message(int return_queue_id, const Message *msg, int blocking);
+int receive_completion_message(int return_queue_id, Message *msg, int blocking);
+int send_shutdown_to_department(int msg_queue_id, DepartmentType dept);
 void destroy_message_queue(int msg_queue_id);
 
 #endif // MESSAGE_QUEUE_H
@@ -2,6 +2,9 @@
 #define METRICS_H
 
 #include "patient.h"
+#include "resource_pool.h"
+#include "steady_state.h"
+#include "patient_export.h"
 #include <time.h>
 
 // Patient metrics structure
@@ -15,17 +18,78 @@ typedef struct {
     double time_in_system;
 } PatientMetrics;
 
+// Running totals of the discharged patients, for backends that free each
+// patient at discharge instead of keeping them all to the end of the run
+typedef struct {
+    int discharged;
+    double waiting_time;
+    double treatment_time;
+    double time_in_system;
+    double last_discharge;       // Seconds after the first arrival
+} DischargeTotals;
+
+// Time-weighted occupancy of one department or service unit. Its owner
+// advances it, in O(1), just before the busy servers or queue length change.
+typedef struct {
+    double start;            // Time accounting began
+    double last_change;
+    double busy_area;        // Busy servers integrated over time
+    double queue_area;       // Waiting patients integrated over time
+    double saturated_time;   // Time with every server busy
+    double capacity_area;    // Servers integrated over time, for staffing that changes
+} DepartmentOccupancy;
+
+// Utilization of one department type over a run
+typedef struct {
+    double utilization;          // Time-weighted busy servers over servers
+    double avg_queue_length;     // Time-weighted, per service unit
+    int max_queue_length;        // Longest at any service unit
+    double saturated_fraction;   // Share of time every server was busy, per service unit
+    long balked;                 // Arrivals turned away by a full waiting room
+    long reneged;                // Patients who gave up waiting
+    long deferred_dispatches;    // Process/thread: held by the scheduler until a credit returned
+    int max_dispatch_backlog;    // Most patients held for this department at once
+    double backpressure_fraction; // Share of the run with patients held for this department
+    long blocked_completions;    // Completions that found the return queue full
+} DepartmentUtilization;
+
+// Use of one resource pool over a run
+typedef struct {
+    char name[MAX_POOL_NAME];
+    int capacity;                // Units per site, the most any shift has
+    uint32_t departments;        // Bit per department drawing from it
+    double utilization;          // Time-weighted units in use over capacity, per site
+    double saturated_fraction;   // Share of time every unit was in use, per site
+    long acquisitions;
+    long queued;                 // Patients who had to wait while every unit was in use
+} PoolUtilization;
+
 // Global metrics structure
 typedef struct {
     int total_patients;
+    int balked;                  // Left at some department because its waiting room was full
+    int reneged;                 // Left some department's waiting line when their patience ran out
+    int left_without_being_seen; // Balked or reneged before any treatment
+    int dispatch_credits;        // Process/thread: patients in flight per department, 0 = no flow control
     double avg_waiting_time;
     double avg_treatment_time;
     double avg_time_in_system;
     double throughput;  // Patients per minute
     time_t simulation_start;
     time_t simulation_end;
+    DepartmentUtilization departments[NUM_DEPARTMENTS];
+    int num_pools;               // Resource pools, 0 while each department has just its own
+    PoolUtilization pools[MAX_RESOURCE_POOLS];
 } GlobalMetrics;
 
+// Results of one run, filled by every backend
+typedef struct {
+    GlobalMetrics metrics;
+    PatientMetrics *patients;    // One entry per patient, in patient ID order (SimConfig.keep_patients)
+    int num_patients;
+    SteadyStateEstimate steady_state;    // SimConfig.steady_state_batches > 0
+} SimResults;
+
 // Function declarations
 void record_patient_arrival(Patient *patient);
 void record_treatment_start(Patient *patient, DepartmentType dept);
@@ -33,7 +97,21 @@ void record_treatment_end(Patient *patient, DepartmentType dept, double treatmen
 void record_waiting_time(Patient *patient, double waiting_time);
 void record_patient_discharge(Patient *patient);
 void calculate_global_metrics(Patient **all_patients, int num_patients, GlobalMetrics *metrics);
-void print_patient_metrics(Patient *patient);
+void add_discharge_totals(DischargeTotals *totals, const PatientRecord *record);
+void calculate_discharge_metrics(const DischargeTotals *totals, int num_patients, time_t first_arrival,
+                                 GlobalMetrics *metrics);
 void print_global_metrics(GlobalMetrics *metrics);
+void init_occupancy(DepartmentOccupancy *occupancy, double now);
+void advance_occupancy(DepartmentOccupancy *occupancy, double now, int busy, int queue_length, int servers);
+void add_unit_utilization(DepartmentUtilization *department, const DepartmentOccupancy *occupancy,
+                          int servers, int max_queue_length, double end, int units_of_type);
+void init_pool_metrics(GlobalMetrics *metrics, const ResourcePlan *plan);
+void add_pool_utilization(PoolUtilization *pool, const DepartmentOccupancy *occupancy, int units,
+                          double end, int sites);
+int init_sim_results(SimResults *results, int num_patients);
+void record_patient_result(PatientMetrics *result, const Patient *patient);
+void collect_patient_results(Patient **all_patients, int num_patients, const GlobalMetrics *metrics,
+                             int with_patients, SimResults *results);
+void free_sim_results(SimResults *results);
 
 #endif // METRICS_H
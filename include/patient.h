@@ -2,8 +2,12 @@
 #define PATIENT_H
 
 #include "hospital.h"
+#include <stddef.h>
 #include <time.h>
 
+#define MAX_ROUTES 256       // Built-in routes plus paths registered from traces
+#define MAX_ROUTE_HOPS 8
+
 // Patient structure
 typedef struct Patient {
     int id;
@@ -13,6 +17,7 @@ typedef struct Patient {
     time_t discharge_time;
     double total_waiting_time;
     double total_treatment_time;
+    double ready_time;       // Simulated clock: when the patient can enter its next department
     int completed;
 } Patient;
 
@@ -29,6 +34,12 @@ void add_patient_to_list(PatientNode **head, Patient *patient);
 Patient* remove_patient_from_list(PatientNode **head, int patient_id);
 void free_patient_list(PatientNode *head);
 void print_patient_info(Patient *patient);
+RouteType get_default_route(int index);
+int get_default_mix_length();
+DepartmentType get_route_department(RouteType route_type, int index);
+int register_route(const DepartmentType *path, int length);
+int get_num_routes();
+void format_route_path(RouteType route_type, char *path, size_t size);
 DepartmentType get_next_department(Patient *patient);
 int is_patient_route_complete(Patient *patient);
 
@@ -0,0 +1,38 @@
+#ifndef PATIENT_EXPORT_H
+#define PATIENT_EXPORT_H
+
+#include <stdint.h>
+
+#define PATIENT_EXPORT_MAGIC "HSIMPATS"
+#define PATIENT_EXPORT_VERSION 1
+#define DEFAULT_SLOWEST_JOURNEYS 10
+#define MAX_SLOWEST_JOURNEYS 10000
+
+// One discharged patient. This is also the on-disk record of a binary export.
+typedef struct {
+    double arrival_time;         // Seconds since the run started
+    double discharge_time;
+    double waiting_time;
+    double treatment_time;
+    int32_t patient_id;
+    int32_t route_type;
+    uint8_t triage;              // From an arrival trace, 0 if not recorded
+    uint8_t reserved[7];
+} PatientRecord;
+
+// Binary export header, followed by num_records PatientRecord entries in
+// discharge order
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    int64_t num_records;
+} PatientExportHeader;
+
+// Function declarations
+int start_patient_export(const char *path, int slowest);
+void export_patient(const PatientRecord *record);
+void print_slowest_journeys();
+int finish_patient_export(int report);
+
+#endif // PATIENT_EXPORT_H
@@ -0,0 +1,34 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+
+#define MAX_PLACEMENT_CPUS 1024
+#define PLACEMENT_SCHEDULER_ROLE 0  // Department/worker i uses role i + 1
+
+// How the scheduler and department workers are pinned to CPUs
+typedef enum {
+    PLACEMENT_NONE,     // Leave placement to the kernel
+    PLACEMENT_COMPACT,  // Fill one NUMA node before the next
+    PLACEMENT_SPREAD,   // Alternate NUMA nodes
+    PLACEMENT_LIST      // Explicit CPU per role, wrapping
+} PlacementPolicy;
+
+// Placement requested on the command line
+typedef struct {
+    PlacementPolicy policy;
+    int num_cpus;                     // Explicit list (PLACEMENT_LIST)
+    int cpus[MAX_PLACEMENT_CPUS];
+} CpuPlacement;
+
+// Function declarations
+int parse_cpu_placement(const char *spec, CpuPlacement *placement);
+int init_cpu_placement(const CpuPlacement *placement);
+int placement_cpu_for_role(int role);
+int placement_node_for_role(int role);
+int pin_to_role(int role);
+void bind_memory_to_node(void *addr, size_t length, int node);
+void print_cpu_placement(const char *const role_names[], int num_roles, int memory_node);
+const char* get_placement_name(PlacementPolicy policy);
+
+#endif // PLACEMENT_H
@@ -0,0 +1,95 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "hospital.h"
+#include <stdint.h>
+
+// Hot-path sections timed by the profiler
+typedef enum {
+    PROF_MSG_SEND,
+    PROF_MSG_RECEIVE,
+    PROF_COMPLETION_SEND,
+    PROF_SEMAPHORE_WAIT,
+    PROF_SEMAPHORE_POST,
+    PROF_SHM_MUTEX,
+    PROF_LOG_MESSAGE,
+    PROF_SCHEDULER_LOOKUP,
+    NUM_PROF_SECTIONS
+} ProfileSection;
+
+// One slot for the scheduler plus one per department process
+#define PROF_MAX_PROCESSES (NUM_DEPARTMENTS + 1)
+#define PROF_SCHEDULER_SLOT 0
+
+// Accumulated timings for one section
+typedef struct {
+    uint64_t calls;
+    uint64_t total_ticks;
+    uint64_t max_ticks;
+} ProfileCounter;
+
+// Per-process counters, written only by the owning process
+typedef struct {
+    int pid;
+    char name[MAX_DEPT_NAME];
+    ProfileCounter counters[NUM_PROF_SECTIONS];
+} ProfileSlot;
+
+// Profile table kept in shared memory
+typedef struct {
+    double ticks_per_ns;
+    ProfileSlot slots[PROF_MAX_PROCESSES];
+} ProfileTable;
+
+#ifdef HOSPITAL_PROFILE
+
+// Scope guard released by the cleanup attribute
+typedef struct {
+    ProfileSection section;
+    uint64_t start;
+} ProfileScope;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t profiler_ticks() {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+static inline uint64_t profiler_ticks() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+// Function declarations
+void init_profiler(ProfileTable *table);
+void profiler_attach(ProfileTable *table, int slot, const char *name);
+void profiler_detach();
+void profiler_record(ProfileSection section, uint64_t start);
+void print_profiler_report(ProfileTable *table);
+
+static inline void profiler_scope_end(ProfileScope *scope) {
+    profiler_record(scope->section, scope->start);
+}
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+
+// Time the rest of the enclosing block
+#define PROFILE_SCOPE(section) \
+    ProfileScope PROF_CONCAT(prof_scope_, __LINE__) \
+        __attribute__((cleanup(profiler_scope_end))) = { (section), profiler_ticks() }
+
+#else
+
+#define init_profiler(table) ((void)0)
+#define profiler_attach(table, slot, name) ((void)0)
+#define profiler_detach() ((void)0)
+#define print_profiler_report(table) ((void)0)
+#define PROFILE_SCOPE(section) ((void)0)
+
+#endif // HOSPITAL_PROFILE
+
+#endif // PROFILER_H
@@ -0,0 +1,18 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+// Independent random streams, one per purpose
+typedef enum {
+    RANDOM_SERVICE = 1,  // Treatment durations, indexed by (patient, hop)
+    RANDOM_PATIENCE = 2  // How long a patient waits before reneging, indexed by (patient, hop)
+} RandomStream;
+
+// Function declarations
+uint64_t random_bits(uint64_t seed, RandomStream stream, uint64_t entity, uint64_t index);
+double random_uniform(uint64_t seed, RandomStream stream, uint64_t entity, uint64_t index);
+int random_int_range(uint64_t seed, RandomStream stream, uint64_t entity, uint64_t index, int min, int max);
+uint64_t default_random_seed();
+
+#endif // RANDOM_H
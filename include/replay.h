@@ -0,0 +1,38 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "hospital.h"
+#include "message_queue.h"
+#include <stdint.h>
+
+#define REPLAY_MAGIC "HSIMRPLY"
+#define REPLAY_VERSION 1
+
+// File header, followed by ReplayRecord entries in write order
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t seed;
+    int32_t num_patients;
+    int32_t reserved;
+} ReplayHeader;
+
+// One treatment start: which patient a department took next
+typedef struct {
+    uint64_t sequence;       // Global order across all departments
+    int32_t patient_id;
+    int16_t department;
+    int16_t hop;
+    double sim_time;         // Simulated treatment start
+} ReplayRecord;
+
+// Function declarations
+int start_replay_recording(const char *path, uint64_t seed, int num_patients);
+void record_treatment_order(uint64_t sequence, DepartmentType dept, const Message *msg, double start_time);
+int finish_replay_recording();
+int load_replay(const char *path, uint64_t *seed, int *num_patients);
+int is_replaying();
+int next_replayed_message(int msg_queue_id, DepartmentType dept, Message *msg);
+
+#endif // REPLAY_H
@@ -0,0 +1,49 @@
+#ifndef RESOURCE_POOL_H
+#define RESOURCE_POOL_H
+
+#include "hospital.h"
+#include <stdint.h>
+
+#define MAX_RESOURCE_POOLS 16
+#define MAX_POOL_NAME 32
+#define MAX_SHIFT_CHANGES 24
+#define DEFAULT_SHIFT_CYCLE 86400.0   // Shift schedules repeat daily
+
+// Staffing of a pool over a repeating cycle: from each change until the next
+// one, wrapping around at the end of the cycle, the pool has that many units
+typedef struct {
+    int num_changes;                      // 0: the pool keeps its capacity
+    double start[MAX_SHIFT_CHANGES];      // Seconds into the cycle, ascending
+    int capacity[MAX_SHIFT_CHANGES];
+} ShiftSchedule;
+
+// Resources departments draw from. Each department starts out with a pool
+// of its own, named after it and sized by its resource count; more pools can
+// be added and shared. A treatment holds one unit of every pool its
+// department needs, taken all at once, so no patient ever holds part of a
+// set while waiting for the rest. Capacities are per site.
+typedef struct {
+    int num_pools;
+    char names[MAX_RESOURCE_POOLS][MAX_POOL_NAME];
+    int capacity[MAX_RESOURCE_POOLS];   // Largest staffing of a scheduled pool
+    uint32_t needs[NUM_DEPARTMENTS];   // Bit p: one unit of pool p per treatment
+    ShiftSchedule shifts[MAX_RESOURCE_POOLS];
+    double shift_cycle;                // Seconds before the schedules repeat
+} ResourcePlan;
+
+// Function declarations
+void init_resource_plan(ResourcePlan *plan);
+int parse_pool_spec(ResourcePlan *plan, const char *spec);
+int parse_needs_spec(ResourcePlan *plan, const char *spec);
+int parse_shift_spec(ResourcePlan *plan, const char *spec);
+int has_shift_schedules(const ResourcePlan *plan);
+int unstaffed_department(const ResourcePlan *plan);
+int scheduled_capacity(const ResourcePlan *plan, int pool, double clock);
+uint64_t resource_plan_digest(const ResourcePlan *plan);
+int is_default_resource_plan(const ResourcePlan *plan);
+int pooled_capacity(const ResourcePlan *plan, DepartmentType dept);
+uint32_t pool_sharers(const ResourcePlan *plan, DepartmentType dept);
+void apply_resource_plan(const ResourcePlan *plan);
+const ResourcePlan* get_resource_plan();
+
+#endif // RESOURCE_POOL_H
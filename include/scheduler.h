@@ -3,6 +3,7 @@
 
 #include "patient.h"
 #include "message_queue.h"
+#include "shared_memory.h"
 
 // Scheduler queue node
 typedef struct SchedulerNode {
@@ -11,13 +12,35 @@ typedef struct SchedulerNode {
     struct SchedulerNode *next;
 } SchedulerNode;
 
+// Round Robin message scheduler of one run. all_patients[i] is patient
+// i + 1; each is exported, added to totals and, if kept is given, copied to
+// kept[i] at discharge, then freed and cleared.
+typedef struct {
+    int msg_queue_id;
+    int return_queue_id;       // May be the dispatch queue
+    Patient **all_patients;
+    int num_patients;          // Arrived so far
+    int discharged;
+    time_t start;              // First arrival; discharge records are timed from it
+    DischargeTotals *totals;   // NULL = not summed
+    PatientMetrics *kept;      // NULL = not kept
+} MessageScheduler;
+
 // Function declarations - FCFS Queue operations
 void enqueue_patient(SchedulerNode **queue, Patient *patient);
 Patient* dequeue_patient(SchedulerNode **queue);
 int is_queue_empty(SchedulerNode *queue);
 
 // Scheduler functions
+void use_simulated_clock(int enabled);
+void use_hospital_state(HospitalState *state);
+void init_dispatch_flow(int credits);
+void dispatch_patient(int msg_queue_id, DepartmentType dept, Patient *patient);
+void add_dispatch_metrics(GlobalMetrics *metrics);
 void fcfs_scheduler(SchedulerNode **ready_queue, int msg_queue_id);
-void round_robin_message_scheduler(int msg_queue_id, Patient **all_patients, int num_patients);
+void init_message_scheduler(MessageScheduler *scheduler, int msg_queue_id, int return_queue_id,
+                            Patient **all_patients, DischargeTotals *totals, PatientMetrics *kept);
+void poll_message_scheduler(MessageScheduler *scheduler);
+void round_robin_message_scheduler(MessageScheduler *scheduler);
 
 #endif // SCHEDULER_H
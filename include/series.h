@@ -0,0 +1,73 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include "hospital.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#define SERIES_MAGIC "HSIMSERS"
+#define SERIES_VERSION 1
+#define SERIES_CHUNK_ROWS 1024
+#define DEFAULT_SERIES_INTERVAL 60.0   // Simulated seconds between samples
+
+// Sampled metrics, each one column per department type
+typedef enum {
+    SERIES_QUEUE,       // Patients waiting, summed over the type's units
+    SERIES_BUSY,        // Servers treating a patient
+    SERIES_COMPLETED,   // Treatments finished since time 0
+    NUM_SERIES_METRICS
+} SeriesMetric;
+
+// File header, followed by chunks. Sample k describes the state just before
+// simulated time k * interval, after every earlier event.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t chunk_header_size;
+    uint32_t num_metrics;
+    uint32_t num_departments;
+    uint32_t chunk_rows;          // Rows per full chunk
+    double interval;
+    int64_t num_rows;             // Distinct samples, written on close
+    int64_t num_chunks;
+} SeriesFileHeader;
+
+// Chunk header, followed by num_metrics * num_departments columns of rows
+// int64_t values, metric-major. Each source (a DES logical process) writes
+// its own chunks for the same row ranges; a sample is the sum over sources.
+typedef struct {
+    int64_t first_row;
+    uint32_t rows;
+    uint32_t source;
+} SeriesChunkHeader;
+
+// Open series file, shared by every source
+typedef struct {
+    FILE *file;
+    pthread_mutex_t mutex;
+    SeriesFileHeader header;
+    int64_t first_row;
+    int64_t end_row;              // One past the last row written
+    int failed;
+} SeriesWriter;
+
+// One source's chunk being filled
+typedef struct {
+    int64_t first_row;
+    uint32_t rows;
+    int64_t *columns;
+} SeriesBuffer;
+
+// Function declarations
+int open_series(const char *path, double interval, SeriesWriter *writer);
+int close_series(SeriesWriter *writer);
+int init_series_buffer(SeriesBuffer *buffer);
+void free_series_buffer(SeriesBuffer *buffer);
+void append_series_row(SeriesWriter *writer, SeriesBuffer *buffer, int source, int64_t row,
+                       const int64_t values[NUM_SERIES_METRICS][NUM_DEPARTMENTS]);
+void flush_series_buffer(SeriesWriter *writer, SeriesBuffer *buffer, int source);
+int export_series_csv(const char *path, FILE *output);
+
+#endif // SERIES_H
@@ -2,15 +2,37 @@
 #define SHARED_MEMORY_H
 
 #include "hospital.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "synchronization.h"
 #include <pthread.h>
+#include <stdint.h>
 
 // Shared hospital state
 typedef struct {
     int total_patients;
     int active_patients[NUM_DEPARTMENTS];
+    int waiting_patients[NUM_DEPARTMENTS];      // Sent to a department, treatment not started
+    int max_waiting_patients[NUM_DEPARTMENTS];
+    DepartmentOccupancy occupancy[NUM_DEPARTMENTS];  // Monotonic wall seconds, on either clock
     int completed_patients;
     int patients_in_system;
     pthread_mutex_t mutex;
+    ResourceGate gates[MAX_RESOURCE_POOLS];  // One counting gate per resource pool
+    int num_pools;
+    uint32_t pool_needs[NUM_DEPARTMENTS];     // Pools each department's treatments hold
+    int pool_in_use[MAX_RESOURCE_POOLS];
+    DepartmentOccupancy pool_occupancy[MAX_RESOURCE_POOLS];  // Units in use, on the monotonic clock
+    ReadyLatch departments_ready;  // Departments attached and serving
+    uint64_t seed;                 // Treatment durations are drawn per (patient, hop)
+    int simulated_clock;           // Measure times on the simulated clock, not the wall clock
+    uint64_t treatment_sequence;   // Global order of treatment starts (replay log)
+    int replay_divergences;        // Treatments served outside the replayed order
+    long blocked_completions[NUM_DEPARTMENTS];  // Completions that found the return queue full
+    int run_generation;            // Bumped by each reset; departments restart their clocks
+#ifdef HOSPITAL_PROFILE
+    ProfileTable profile;
+#endif
 } HospitalState;
 
 // Function declarations
@@ -19,5 +41,9 @@ HospitalState* attach_shared_memory(int shm_id);
 void detach_shared_memory(HospitalState *state);
 void destroy_shared_memory(int shm_id);
 void init_hospital_state(HospitalState *state);
+void reset_hospital_state(HospitalState *state);
+double hospital_clock();
+void start_department_occupancy(HospitalState *state);
+void change_department_occupancy(HospitalState *state, DepartmentType dept, int busy_change, int waiting_change);
 
 #endif // SHARED_MEMORY_H
@@ -0,0 +1,34 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "config.h"
+#include "metrics.h"
+#include "shared_memory.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+// One configured simulation. Process and thread backends start their
+// department workers and IPC objects once, in create_simulation(), and keep
+// them across reset_simulation() until destroy_simulation(). The engines
+// keep file-static state, so one simulation exists per process at a time.
+typedef struct {
+    SimConfig config;
+    int ran;                              // Set by run_simulation, cleared by a reset
+    int shm_id;                           // Process backend
+    int msg_queue_id;                     // Process and thread backends: dispatches
+    int return_queue_id;                  // ...and completions
+    int dispatch_credits;                 // config.dispatch_credits, lowered to fit the queues
+    pid_t dept_pids[NUM_DEPARTMENTS];     // Process backend
+    HospitalState *hospital_state;        // Process and thread backends
+    int memory_node;
+    SimResults results;
+} Simulation;
+
+// Function declarations
+Simulation* create_simulation(const SimConfig *config);
+int run_simulation(Simulation *sim);
+const SimResults* get_simulation_results(const Simulation *sim);
+int reset_simulation(Simulation *sim, uint64_t seed);
+void destroy_simulation(Simulation *sim);
+
+#endif // SIMULATION_H
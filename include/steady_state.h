@@ -0,0 +1,44 @@
+#ifndef STEADY_STATE_H
+#define STEADY_STATE_H
+
+#include <stdint.h>
+
+#define DEFAULT_STEADY_STATE_BATCHES 20
+#define MAX_STEADY_STATE_BATCHES 1000
+#define MSER_BATCH_SIZE 5            // MSER-5: truncation is chosen over means of 5 patients
+#define MIN_STEADY_STATE_BATCH 10    // Patients per batch below which no estimate is made
+
+// Batch-means estimate of one steady-state quantity
+typedef struct {
+    double mean;
+    double half_width;           // Of the 95% confidence interval
+    double lag1_correlation;     // Between successive batch means; near 0 if batches are long enough
+} BatchEstimate;
+
+// Steady-state estimates of one run. Patients are taken in arrival order,
+// the start-up transient chosen by MSER-5 is dropped, and the rest is split
+// into equal batches whose means are treated as independent.
+typedef struct {
+    int valid;                   // 0 if too few patients were discharged
+    int batches;
+    int64_t observations;        // Discharged patients
+    int64_t truncated;           // Dropped as warm-up
+    int64_t batch_size;          // Patients per batch
+    double warmup_time;          // Arrival time of the first patient kept
+    int truncation_at_limit;     // MSER kept falling to the end of its search: no steady state seen
+    BatchEstimate waiting_time;
+    BatchEstimate time_in_system;
+    BatchEstimate throughput;    // Discharges per minute over equal spans of the kept arrivals
+    double batch_span;           // Seconds per throughput batch
+    double all_waiting_time;     // Mean over every discharged patient, for comparison
+    double all_time_in_system;
+} SteadyStateEstimate;
+
+// Function declarations
+int start_steady_state(int batches);
+void observe_discharge(double arrival_time, double discharge_time, double waiting_time, int32_t patient_id);
+int finish_steady_state(SteadyStateEstimate *estimate);
+void print_steady_state(const SteadyStateEstimate *estimate);
+double t_quantile_975(int df);
+
+#endif // STEADY_STATE_H
@@ -2,7 +2,29 @@
 #define SYNCHRONIZATION_H
 
 #include <pthread.h>
-#include <semaphore.h>
+#include <stdint.h>
+
+// Counting resource gate built on futexes, placed in shared memory.
+// The free-unit count and queued-waiter count share one word so the
+// uncontended path is a single compare-and-swap; waiters queue by ticket
+// and post() hands units to them in FIFO order.
+typedef struct {
+    uint32_t state;           // Low 16 bits: free units, high 16 bits: queued waiters
+    uint32_t next_ticket;     // Ticket dispenser for queued waiters
+    uint32_t granted;         // Units handed to waiters so far (futex word)
+    int capacity;
+    // Contention counters
+    uint64_t acquisitions;
+    uint64_t contended;       // Acquisitions that had to queue
+    uint64_t wait_ns;         // Total time spent queued
+    uint32_t max_waiters;
+} ResourceGate;
+
+// Count of workers that have finished starting, placed in shared memory.
+// The scheduler sleeps on it until every worker has arrived.
+typedef struct {
+    uint32_t arrived;         // Futex word
+} ReadyLatch;
 
 // Mutex operations
 int init_mutex(pthread_mutex_t *mutex);
@@ -11,10 +33,13 @@ int unlock_mutex(pthread_mutex_t *mutex);
 int destroy_mutex(pthread_mutex_t *mutex);
 
 // Semaphore operations
-sem_t* create_semaphore(const char *name, int initial_value);
-int wait_semaphore(sem_t *sem);
-int post_semaphore(sem_t *sem);
-int destroy_semaphore(const char *name);
-sem_t* open_semaphore(const char *name);
+int init_semaphore(ResourceGate *gate, int initial_value);
+int wait_semaphore(ResourceGate *gate);
+int post_semaphore(ResourceGate *gate);
+
+// Latch operations
+void init_latch(ReadyLatch *latch);
+void arrive_latch(ReadyLatch *latch);
+int wait_latch(ReadyLatch *latch, uint32_t count, int timeout_ms);
 
 #endif // SYNCHRONIZATION_H
@@ -0,0 +1,10 @@
+#ifndef THREAD_BACKEND_H
+#define THREAD_BACKEND_H
+
+#include "shared_memory.h"
+
+// Function declarations
+int start_department_threads(int msg_queue_id, int return_queue_id, HospitalState *hospital_state);
+void stop_department_threads(int msg_queue_id);
+
+#endif // THREAD_BACKEND_H
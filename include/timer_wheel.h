@@ -0,0 +1,44 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_NONE -1
+
+// One timer, identified by its index in the node array the wheel was given.
+// prev >= 0 is the previous timer in the slot, prev == TIMER_NONE means the
+// timer is not armed, and prev < TIMER_NONE marks the head of slot -prev - 2.
+typedef struct {
+    double expiry;
+    int32_t next;
+    int32_t prev;
+} TimerNode;
+
+// Hierarchical timing wheel: level L slots span 256^L ticks, so arming and
+// cancelling a timer are O(1) and each timer is moved down at most once per
+// level before it fires. Timers past the top level wait in an overflow list,
+// and timers armed for a tick that has already gone by in a due list.
+typedef struct {
+    TimerNode *nodes;
+    double tick;                 // Seconds per level-0 slot
+    uint64_t current;            // Every tick before this one has fired
+    int32_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    int32_t overflow;
+    int32_t due;
+    long level_count[TIMER_WHEEL_LEVELS];   // Non-empty slots per level
+    long count;
+} TimerWheel;
+
+// Called for each due timer; it is already disarmed
+typedef void (*TimerCallback)(void *context, int32_t id, double expiry);
+
+// Function declarations
+void init_timer_wheel(TimerWheel *wheel, TimerNode *nodes, double tick, double now);
+void arm_timer(TimerWheel *wheel, int32_t id, double expiry);
+void cancel_timer(TimerWheel *wheel, int32_t id);
+void expire_timers(TimerWheel *wheel, double now, TimerCallback fire, void *context);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,50 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "patient.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC "HSIMTRCE"
+#define TRACE_VERSION 1
+#define TRACE_NO_SERVICE_TIME -1.0f   // Hop without an observed time: draw from the model
+
+// One historical arrival. This is also the on-disk record of a binary trace.
+typedef struct {
+    double arrival_time;                    // Seconds (Unix time for CSV timestamps)
+    float service_time[MAX_ROUTE_HOPS];     // Observed treatment time per hop, seconds
+    uint8_t path[MAX_ROUTE_HOPS];           // DepartmentType per hop
+    uint8_t num_hops;
+    uint8_t triage;                         // 1 (most urgent) to 5, 0 = not recorded
+    uint8_t reserved[6];
+} TraceRecord;
+
+// Binary trace header, followed by num_records TraceRecord entries
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    int64_t num_records;
+} TraceFileHeader;
+
+// Streaming reader over a memory-mapped CSV or binary trace. Parsed pages are
+// released as the cursor passes them, so files larger than RAM stream through.
+typedef struct {
+    const char *path;
+    const char *mapping;
+    size_t mapping_size;
+    int binary;
+    size_t offset;          // Next byte to read
+    size_t released;        // Pages before this offset have been dropped
+    int64_t line;           // CSV line of the last record, for error messages
+    int header_checked;     // CSV: only the first non-comment line may be a header
+    int64_t records;        // Records returned so far
+} TraceReader;
+
+// Function declarations
+int open_trace(const char *path, TraceReader *reader);
+int next_trace_record(TraceReader *reader, TraceRecord *record);
+void close_trace(TraceReader *reader);
+int convert_trace(const char *path, const char *output_path);
+
+#endif // TRACE_H
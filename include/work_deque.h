@@ -0,0 +1,26 @@
+#ifndef WORK_DEQUE_H
+#define WORK_DEQUE_H
+
+#include <stdint.h>
+
+// Values returned by take/steal when no task was obtained
+#define DEQUE_EMPTY UINT64_MAX
+#define DEQUE_ABORT (UINT64_MAX - 1)
+
+// Chase-Lev work-stealing deque of packed 64-bit tasks.
+// The owner pushes and takes at the bottom; thieves steal from the top.
+typedef struct {
+    int64_t top;
+    int64_t bottom;
+    int64_t mask;        // Capacity - 1 (capacity is a power of two)
+    uint64_t *buffer;
+} WorkDeque;
+
+// Function declarations
+int init_work_deque(WorkDeque *deque, int capacity_log2);
+void destroy_work_deque(WorkDeque *deque);
+int push_work(WorkDeque *deque, uint64_t task);
+uint64_t take_work(WorkDeque *deque);
+uint64_t steal_work(WorkDeque *deque);
+
+#endif // WORK_DEQUE_H
@@ -0,0 +1,323 @@
+#include "analytic.h"
+#include "department.h"
+#include "patient.h"
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define NUM_DEFAULT_ROUTES (ROUTE_D + 1)
+#define MAX_SITES (MAX_DEPARTMENT_UNITS / NUM_DEPARTMENTS)
+#define EXTERNAL_SOURCE NUM_DEPARTMENTS
+
+// Service of one department type, the same at every site
+typedef struct {
+    int servers;
+    double mean;
+    double scv;
+    double capacity;           // Patients per second with every server busy
+} StationModel;
+
+// One site's stations; sites differ only in their share of the route mix
+typedef struct {
+    double offered[NUM_DEPARTMENTS];
+    double arrival_scv[NUM_DEPARTMENTS];
+    double wait_probability[NUM_DEPARTMENTS];
+    double waiting_time[NUM_DEPARTMENTS];   // Per visit
+    long visits[NUM_DEPARTMENTS];
+    double duration;
+} SiteEstimate;
+
+static long greatest_common_divisor(long a, long b) {
+    while (b != 0) {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Probability an arrival waits in an M/M/c queue with offered load a < c,
+// from the Erlang B recursion
+static double erlang_c(int servers, double load) {
+    double blocking = 1.0;
+    for (int k = 1; k <= servers; k++) {
+        blocking = load * blocking / (k + load * blocking);
+    }
+    double utilization = load / servers;
+    return blocking / (1.0 - utilization * (1.0 - blocking));
+}
+
+// Treatment durations: continuous uniform on the DES engines, whole seconds elsewhere
+static void init_station_models(const SimConfig *config, StationModel *stations) {
+    int continuous = config->backend == BACKEND_DES || config->backend == BACKEND_PDES;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        double low = department_configs[d].service_time_min;
+        double high = department_configs[d].service_time_max;
+        double width = continuous ? high - low : high - low + 1.0;
+        double variance = continuous ? width * width / 12.0 : (width * width - 1.0) / 12.0;
+
+        stations[d].servers = department_configs[d].resource_count;
+        stations[d].mean = (low + high) / 2.0;
+        stations[d].scv = variance / (stations[d].mean * stations[d].mean);
+        stations[d].capacity = stations[d].servers / stations[d].mean;
+    }
+}
+
+// Rates, variability and waits at one site. Overloaded stations pass on only
+// their capacity, so stations behind a bottleneck see its throttled output.
+static void estimate_site(const long *route_patients, long site_patients, double site_rate,
+                          const StationModel *stations, SiteEstimate *site) {
+    memset(site, 0, sizeof(SiteEstimate));
+    if (site_patients == 0) return;
+
+    double class_rate[NUM_DEFAULT_ROUTES];
+    for (int r = 0; r < NUM_DEFAULT_ROUTES; r++) {
+        class_rate[r] = site_rate * route_patients[r] / site_patients;
+        for (int hop = 0; get_route_department((RouteType)r, hop) != (DepartmentType)-1; hop++) {
+            site->visits[get_route_department((RouteType)r, hop)] += route_patients[r];
+        }
+    }
+
+    // Flow rates between stations (row EXTERNAL_SOURCE: new arrivals). A route
+    // has at most MAX_ROUTE_HOPS stations, so the throttles settle in as many passes.
+    double flow[NUM_DEPARTMENTS + 1][NUM_DEPARTMENTS];
+    double passed[NUM_DEPARTMENTS];
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) passed[d] = 1.0;
+
+    for (int pass = 0; pass <= MAX_ROUTE_HOPS; pass++) {
+        memset(flow, 0, sizeof(flow));
+        memset(site->offered, 0, sizeof(site->offered));
+        for (int r = 0; r < NUM_DEFAULT_ROUTES; r++) {
+            double rate = class_rate[r];
+            int source = EXTERNAL_SOURCE;
+            for (int hop = 0; get_route_department((RouteType)r, hop) != (DepartmentType)-1; hop++) {
+                int d = get_route_department((RouteType)r, hop);
+                site->offered[d] += rate;
+                flow[source][d] += rate;
+                rate *= passed[d];
+                source = d;
+            }
+        }
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            passed[d] = site->offered[d] > stations[d].capacity ? stations[d].capacity / site->offered[d] : 1.0;
+        }
+    }
+
+    // Arrival variability (Whitt's QNA): departures mix the arrival and service
+    // variability by utilization, splits thin them, merges average them by rate.
+    // The external stream is deterministic, one patient per dispatch interval.
+    double departure_scv[NUM_DEPARTMENTS + 1];
+    double departure_rate[NUM_DEPARTMENTS + 1];
+    departure_scv[EXTERNAL_SOURCE] = 0.0;
+    departure_rate[EXTERNAL_SOURCE] = site_rate;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        site->arrival_scv[d] = 1.0;
+        departure_rate[d] = site->offered[d] * passed[d];
+    }
+
+    for (int pass = 0; pass <= MAX_ROUTE_HOPS; pass++) {
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            double rho = fmin(site->offered[d] / stations[d].capacity, 1.0);
+            departure_scv[d] = 1.0 + (1.0 - rho * rho) * (site->arrival_scv[d] - 1.0) +
+                               rho * rho * (stations[d].scv - 1.0) / sqrt(stations[d].servers);
+        }
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            if (site->offered[d] <= 0.0) continue;
+            double scv = 0.0;
+            for (int source = 0; source <= EXTERNAL_SOURCE; source++) {
+                if (flow[source][d] <= 0.0) continue;
+                double split = flow[source][d] / departure_rate[source];
+                scv += flow[source][d] / site->offered[d] * (split * departure_scv[source] + 1.0 - split);
+            }
+            site->arrival_scv[d] = scv;
+        }
+    }
+
+    // Steady-state M/M/c wait with the Allen-Cunneen correction; an overloaded
+    // station's queue grows for the whole run, so use its fluid average instead
+    double busiest = 0.0;
+    double mean_path = 0.0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        if (site->visits[d] == 0) continue;
+        const StationModel *station = &stations[d];
+        double load = site->offered[d] * station->mean;
+
+        if (load < station->servers) {
+            double wait_probability = erlang_c(station->servers, load);
+            double mmc_wait = wait_probability * station->mean / (station->servers - load);
+            site->wait_probability[d] = wait_probability;
+            site->waiting_time[d] = mmc_wait * (site->arrival_scv[d] + station->scv) / 2.0;
+        } else {
+            site->wait_probability[d] = 1.0;
+            site->waiting_time[d] = (site->visits[d] - 1) / 2.0 *
+                                    (1.0 / station->capacity - 1.0 / site->offered[d]);
+        }
+
+        double busy = site->visits[d] / station->capacity;
+        if (busy > busiest) busiest = busy;
+        mean_path += (double)site->visits[d] / site_patients * (station->mean + site->waiting_time[d]);
+    }
+
+    // The run lasts until the last arrival has passed through, or until the
+    // busiest station has served everyone, whichever is later
+    double last_arrival = (site_patients - 1) / site_rate;
+    site->duration = fmax(last_arrival + mean_path, busiest);
+}
+
+// Estimate waits, utilization and throughput of the configuration as an open
+// queueing network, without simulating it. Covers the default route mix.
+int estimate_network(const SimConfig *config, NetworkEstimate *estimate) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memset(estimate, 0, sizeof(NetworkEstimate));
+
+    int multi_site = config->backend == BACKEND_EXECUTOR || config->backend == BACKEND_DES ||
+                     config->backend == BACKEND_PDES;
+    int num_sites = multi_site ? config->num_departments / NUM_DEPARTMENTS : 1;
+    long num_patients = config->num_patients;
+    double interval = DISPATCH_INTERVAL / 1e6;
+    double site_rate = 1.0 / (interval * num_sites);
+
+    // Process and thread departments hand patients on after one scheduler quantum
+    double transfer = multi_site || config->backend == BACKEND_COROUTINE ? 0.0 : TIME_QUANTUM / 1e6;
+
+    StationModel stations[NUM_DEPARTMENTS];
+    init_station_models(config, stations);
+
+    // Patient i goes to site i % sites with route i % mix length, so the split
+    // of routes over sites repeats every lcm(sites, mix length) patients
+    static long route_patients[MAX_SITES][NUM_DEFAULT_ROUTES];
+    long site_patients[MAX_SITES];
+    memset(route_patients, 0, sizeof(long) * num_sites * NUM_DEFAULT_ROUTES);
+    memset(site_patients, 0, sizeof(long) * num_sites);
+
+    long mix_length = get_default_mix_length();
+    long period = num_sites / greatest_common_divisor(num_sites, mix_length) * mix_length;
+    for (long i = 0; i < period && i < num_patients; i++) {
+        long repeats = (num_patients - 1 - i) / period + 1;
+        route_patients[i % num_sites][get_default_route((int)(i % mix_length))] += repeats;
+        site_patients[i % num_sites] += repeats;
+    }
+
+    double total_wait = 0.0, total_treatment = 0.0, total_transfer = 0.0, duration = 0.0;
+    for (int s = 0; s < num_sites; s++) {
+        SiteEstimate site;
+        estimate_site(route_patients[s], site_patients[s], site_rate, stations, &site);
+
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            StationEstimate *station = &estimate->stations[d];
+            double utilization = site.offered[d] / stations[d].capacity;
+            station->arrival_rate += site.offered[d];
+            station->visits += site.visits[d];
+            station->avg_waiting_time += site.visits[d] * site.waiting_time[d];
+            if (utilization > station->utilization) {
+                station->utilization = utilization;
+                station->arrival_scv = site.arrival_scv[d];
+                station->wait_probability = site.wait_probability[d];
+            }
+            total_wait += site.visits[d] * site.waiting_time[d];
+            total_treatment += site.visits[d] * stations[d].mean;
+            total_transfer += site.visits[d] * transfer;
+        }
+        total_transfer -= site_patients[s] * transfer;  // No hand-off before the first hop
+        if (site.duration > duration) duration = site.duration;
+    }
+
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        StationEstimate *station = &estimate->stations[d];
+        station->servers = stations[d].servers;
+        station->service_mean = stations[d].mean;
+        station->service_scv = stations[d].scv;
+        if (station->visits > 0) station->avg_waiting_time /= station->visits;
+        if (station->utilization >= 1.0) estimate->overloaded++;
+        if (station->utilization > estimate->stations[estimate->bottleneck].utilization) {
+            estimate->bottleneck = (DepartmentType)d;
+        }
+    }
+
+    GlobalMetrics *metrics = &estimate->metrics;
+    metrics->total_patients = config->num_patients;
+    metrics->avg_waiting_time = total_wait / num_patients;
+    metrics->avg_treatment_time = total_treatment / num_patients;
+    metrics->avg_time_in_system = (total_wait + total_treatment + total_transfer) / num_patients;
+    metrics->throughput = duration > 0.0 ? num_patients / (duration / 60.0) : 0.0;
+    metrics->simulation_start = 0;
+    metrics->simulation_end = (time_t)llround(duration);
+    estimate->num_sites = num_sites;
+    estimate->arrival_rate = site_rate * num_sites;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    estimate->compute_seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    log_message(LOG_INFO, "Analytic estimate: %d overloaded department(s), bottleneck %s at %.2f",
+                estimate->overloaded, get_department_name(estimate->bottleneck),
+                estimate->stations[estimate->bottleneck].utilization);
+    return 0;
+}
+
+// Per-department loads and waits, predicted averages and a staffing verdict
+void print_network_estimate(const NetworkEstimate *estimate) {
+    printf("\n╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║               ANALYTIC QUEUEING-NETWORK ESTIMATE               ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    printf("Model                       : open network, M/M/c waits with Allen-Cunneen correction\n");
+    printf("Arrivals                    : %.2f patients/s across %d site(s)\n\n",
+           estimate->arrival_rate, estimate->num_sites);
+
+    printf("%-12s %8s %12s %8s %9s %10s %14s\n",
+           "Department", "Servers", "Arrivals/s", "Util", "Arr SCV", "P(wait)", "Wait/visit (s)");
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        const StationEstimate *station = &estimate->stations[d];
+        printf("%-12s %8d %12.3f %7.1f%% %9.2f %10.2f %14.2f%s\n",
+               get_department_name((DepartmentType)d), station->servers, station->arrival_rate,
+               station->utilization * 100.0, station->arrival_scv, station->wait_probability,
+               station->avg_waiting_time, station->utilization >= 1.0 ? "  OVERLOADED" : "");
+    }
+
+    const GlobalMetrics *metrics = &estimate->metrics;
+    printf("\nPredicted Waiting Time      : %.2f seconds\n", metrics->avg_waiting_time);
+    printf("Predicted Treatment Time    : %.2f seconds\n", metrics->avg_treatment_time);
+    printf("Predicted Time in System    : %.2f seconds\n", metrics->avg_time_in_system);
+    printf("Predicted Throughput        : %.2f patients/minute\n", metrics->throughput);
+    printf("Predicted Duration          : %.2f seconds\n",
+           difftime(metrics->simulation_end, metrics->simulation_start));
+
+    const StationEstimate *bottleneck = &estimate->stations[estimate->bottleneck];
+    if (estimate->overloaded > 0) {
+        printf("Staffing                    : infeasible, %d department(s) overloaded (bottleneck %s at %.0f%%)\n",
+               estimate->overloaded, get_department_name(estimate->bottleneck), bottleneck->utilization * 100.0);
+    } else {
+        printf("Staffing                    : feasible (bottleneck %s at %.0f%%)\n",
+               get_department_name(estimate->bottleneck), bottleneck->utilization * 100.0);
+    }
+    printf("Computed in                 : %.1f us\n\n", estimate->compute_seconds * 1e6);
+}
+
+static void print_comparison_row(const char *name, double analytic, double simulated) {
+    if (simulated != 0.0) {
+        printf("%-28s %12.2f %12.2f %+9.1f%%\n", name, analytic, simulated,
+               (analytic - simulated) / simulated * 100.0);
+    } else {
+        printf("%-28s %12.2f %12.2f %10s\n", name, analytic, simulated, "-");
+    }
+}
+
+// Predicted next to simulated global metrics
+void print_estimate_comparison(const NetworkEstimate *estimate, const GlobalMetrics *simulated) {
+    const GlobalMetrics *predicted = &estimate->metrics;
+
+    printf("╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                ANALYTIC ESTIMATE VS SIMULATION                 ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    printf("%-28s %12s %12s %10s\n", "Metric", "Analytic", "Simulated", "Error");
+    print_comparison_row("Average Waiting Time (s)", predicted->avg_waiting_time, simulated->avg_waiting_time);
+    print_comparison_row("Average Treatment Time (s)", predicted->avg_treatment_time, simulated->avg_treatment_time);
+    print_comparison_row("Average Time in System (s)", predicted->avg_time_in_system, simulated->avg_time_in_system);
+    print_comparison_row("Throughput (patients/min)", predicted->throughput, simulated->throughput);
+    print_comparison_row("Duration (s)", difftime(predicted->simulation_end, predicted->simulation_start),
+                         difftime(simulated->simulation_end, simulated->simulation_start));
+    printf("\n");
+}
@@ -0,0 +1,238 @@
+#include "attribution.h"
+#include "department.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUTE_LABEL_LENGTH 32
+
+// Per-patient tables; the caller fills route_type before allocate_hops()
+int init_hop_arena(HopArena *arena, int num_patients) {
+    memset(arena, 0, sizeof(HopArena));
+    arena->num_patients = num_patients;
+    arena->first_hop = (int64_t*)calloc((size_t)num_patients + 1, sizeof(int64_t));
+    arena->route_type = (uint8_t*)calloc(num_patients, sizeof(uint8_t));
+    return arena->first_hop && arena->route_type ? 0 : -1;
+}
+
+// Lay the patients' routes out back to back and allocate their hops
+int allocate_hops(HopArena *arena) {
+    for (int i = 0; i < arena->num_patients; i++) {
+        int length = 0;
+        while (get_route_department((RouteType)arena->route_type[i], length) != (DepartmentType)-1) length++;
+        arena->first_hop[i + 1] = arena->first_hop[i] + length;
+    }
+    arena->num_hops = arena->first_hop[arena->num_patients];
+    arena->hops = (JourneyHop*)calloc(arena->num_hops > 0 ? arena->num_hops : 1, sizeof(JourneyHop));
+    return arena->hops ? 0 : -1;
+}
+
+void free_hop_arena(HopArena *arena) {
+    free(arena->hops);
+    free(arena->first_hop);
+    free(arena->route_type);
+    memset(arena, 0, sizeof(HopArena));
+}
+
+// Record a patient's visit to the hop-th department of its route
+void record_hop(HopArena *arena, int patient, int hop, double enqueue_time, double start, double end) {
+    JourneyHop *record = &arena->hops[arena->first_hop[patient] + hop];
+    record->enqueue_time = enqueue_time;
+    record->waiting = (float)(start - enqueue_time);
+    record->treatment = (float)(end - start);
+}
+
+// Time from joining the first queue to the end of the last treatment
+static double journey_time(const HopArena *arena, int patient) {
+    double time = 0.0;
+    for (int64_t h = arena->first_hop[patient]; h < arena->first_hop[patient + 1]; h++) {
+        time += arena->hops[h].waiting + arena->hops[h].treatment;
+    }
+    return time;
+}
+
+// k-th smallest value (0-based); reorders the values
+static double select_kth(double *values, int64_t n, int64_t k) {
+    int64_t low = 0, high = n - 1;
+    while (low < high) {
+        double pivot = values[low + (high - low) / 2];
+        int64_t i = low, j = high;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                double tmp = values[i];
+                values[i++] = values[j];
+                values[j--] = tmp;
+            }
+        }
+        if (k <= j) {
+            high = j;
+        } else if (k >= i) {
+            low = i;
+        } else {
+            break;
+        }
+    }
+    return values[k];
+}
+
+// Attribute every recorded journey's waiting to its departments and routes,
+// then break down the time of the patients at or above the tail quantile.
+// Two passes over the arena plus one selection; nothing is sorted.
+int analyze_hops(const HopArena *arena, BottleneckAnalysis *analysis) {
+    memset(analysis, 0, sizeof(BottleneckAnalysis));
+    if (arena->num_patients == 0) return 0;
+
+    double *times = (double*)malloc(sizeof(double) * arena->num_patients);
+    if (!times) return -1;
+
+    for (int i = 0; i < arena->num_patients; i++) {
+        RouteAttribution *route = &analysis->routes[arena->route_type[i]];
+        route->patients++;
+        for (int64_t h = arena->first_hop[i]; h < arena->first_hop[i + 1]; h++) {
+            DepartmentType dept = get_route_department((RouteType)arena->route_type[i], (int)(h - arena->first_hop[i]));
+            route->waiting[dept] += arena->hops[h].waiting;
+            route->total_waiting += arena->hops[h].waiting;
+        }
+        times[i] = journey_time(arena, i);
+    }
+    for (int r = 0; r < MAX_ROUTES; r++) {
+        RouteAttribution *route = &analysis->routes[r];
+        analysis->all_routes.patients += route->patients;
+        analysis->all_routes.total_waiting += route->total_waiting;
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            analysis->all_routes.waiting[d] += route->waiting[d];
+        }
+    }
+
+    int64_t k = (int64_t)(TAIL_QUANTILE * arena->num_patients);
+    if (k > arena->num_patients - 1) k = arena->num_patients - 1;
+    analysis->tail_threshold = select_kth(times, arena->num_patients, k);
+    free(times);
+
+    for (int i = 0; i < arena->num_patients; i++) {
+        double time = journey_time(arena, i);
+        if (time < analysis->tail_threshold) continue;
+
+        analysis->tail_patients++;
+        analysis->tail_time += time;
+        int longest = -1;
+        float longest_wait = 0.0f;
+        for (int64_t h = arena->first_hop[i]; h < arena->first_hop[i + 1]; h++) {
+            DepartmentType dept = get_route_department((RouteType)arena->route_type[i], (int)(h - arena->first_hop[i]));
+            analysis->tail_waiting[dept] += arena->hops[h].waiting;
+            analysis->tail_treatment[dept] += arena->hops[h].treatment;
+            if (arena->hops[h].waiting > longest_wait) {
+                longest_wait = arena->hops[h].waiting;
+                longest = dept;
+            }
+        }
+        if (longest >= 0) {
+            analysis->tail_longest_wait[longest]++;
+        }
+    }
+    return 0;
+}
+
+static void route_label(int route, char *label, size_t size) {
+    if (route <= ROUTE_D) {
+        snprintf(label, size, "Route %c", 'A' + route);
+    } else {
+        snprintf(label, size, "Trace route %d", route - ROUTE_D);
+    }
+}
+
+static double share(double part, double whole) {
+    return whole > 0.0 ? part / whole * 100.0 : 0.0;
+}
+
+// One row of the waiting table: each department's share of the row's waiting
+static void print_route_row(const char *label, const RouteAttribution *route) {
+    printf("%-16s %9lld %10.2f", label, (long long)route->patients,
+           route->patients > 0 ? route->total_waiting / route->patients : 0.0);
+    int worst = 0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        printf(" %9.1f%%", share(route->waiting[d], route->total_waiting));
+        if (route->waiting[d] > route->waiting[worst]) worst = d;
+    }
+    if (route->total_waiting > 0.0) {
+        printf("  %s (%.0f%%)", get_department_name((DepartmentType)worst),
+               share(route->waiting[worst], route->total_waiting));
+    }
+    printf("\n");
+}
+
+// Waiting shares for the routes with the most waiting, then the tail breakdown
+void print_bottleneck_analysis(const BottleneckAnalysis *analysis) {
+    int order[MAX_ROUTES];
+    int listed = 0;
+    for (int r = 0; r < MAX_ROUTES; r++) {
+        if (analysis->routes[r].patients == 0) continue;
+        int i = listed++;
+        while (i > 0 && analysis->routes[order[i - 1]].total_waiting < analysis->routes[r].total_waiting) {
+            order[i] = order[i - 1];
+            i--;
+        }
+        order[i] = r;
+    }
+
+    printf("╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                 BOTTLENECK ATTRIBUTION                         ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    printf("Share of each route's waiting by department:\n");
+    printf("%-16s %9s %10s", "Route", "Patients", "Avg Wait");
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        printf(" %10s", get_department_name((DepartmentType)d));
+    }
+    printf("  %s\n", "Bottleneck");
+
+    RouteAttribution others;
+    memset(&others, 0, sizeof(others));
+    char label[ROUTE_LABEL_LENGTH];
+    for (int i = 0; i < listed; i++) {
+        const RouteAttribution *route = &analysis->routes[order[i]];
+        if (i < MAX_ATTRIBUTION_ROUTES) {
+            route_label(order[i], label, sizeof(label));
+            print_route_row(label, route);
+            continue;
+        }
+        others.patients += route->patients;
+        others.total_waiting += route->total_waiting;
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            others.waiting[d] += route->waiting[d];
+        }
+    }
+    if (others.patients > 0) {
+        print_route_row("Other routes", &others);
+    }
+    print_route_row("All routes", &analysis->all_routes);
+
+    for (int i = 0; i < listed && i < MAX_ATTRIBUTION_ROUTES; i++) {
+        if (order[i] <= ROUTE_D) continue;
+        char path[128];
+        route_label(order[i], label, sizeof(label));
+        format_route_path((RouteType)order[i], path, sizeof(path));
+        printf("  %-16s = %s\n", label, path);
+    }
+    printf("\n");
+
+    if (analysis->tail_patients == 0) return;
+    printf("Slowest %.0f%% of patients: %lld with time in system >= %.2f s (avg %.2f s)\n",
+           (1.0 - TAIL_QUANTILE) * 100.0, (long long)analysis->tail_patients, analysis->tail_threshold,
+           analysis->tail_time / analysis->tail_patients);
+    printf("%-12s %12s %12s %14s\n", "Department", "Waiting", "Treatment", "Longest Wait");
+    double waiting = 0.0, treatment = 0.0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        waiting += analysis->tail_waiting[d];
+        treatment += analysis->tail_treatment[d];
+        printf("%-12s %11.1f%% %11.1f%% %13.1f%%\n", get_department_name((DepartmentType)d),
+               share(analysis->tail_waiting[d], analysis->tail_time),
+               share(analysis->tail_treatment[d], analysis->tail_time),
+               share(analysis->tail_longest_wait[d], analysis->tail_patients));
+    }
+    printf("%-12s %11.1f%% %11.1f%%\n", "Total", share(waiting, analysis->tail_time),
+           share(treatment, analysis->tail_time));
+    printf("\n");
+}
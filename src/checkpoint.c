@@ -0,0 +1,178 @@
+#include "checkpoint.h"
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SECTION_ALIGN 64
+
+static uint64_t align_section(uint64_t offset) {
+    return (offset + SECTION_ALIGN - 1) & ~(uint64_t)(SECTION_ALIGN - 1);
+}
+
+// FNV-1a over the sections
+static uint64_t checkpoint_checksum(const CheckpointImage *image) {
+    const unsigned char *bytes = (const unsigned char*)image->mapping;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = image->header->header_size; i < image->mapping_size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Point the section arrays into the mapping
+static void locate_sections(CheckpointImage *image) {
+    char *base = (char*)image->mapping;
+    image->header = (CheckpointHeader*)base;
+    image->patients = (DesPatient*)(base + image->header->patients_offset);
+    image->units = (DesUnit*)(base + image->header->units_offset);
+    image->events = (DesEvent*)(base + image->header->events_offset);
+    image->hops = (JourneyHop*)(base + image->header->hops_offset);
+    image->pools = (DesPool*)(base + image->header->pools_offset);
+}
+
+// Pool records: every site's pools
+static uint64_t pool_records(const CheckpointHeader *header) {
+    return (uint64_t)header->num_pools * (header->num_units / NUM_DEPARTMENTS);
+}
+
+// Size a new checkpoint file and map it for writing. The caller fills the
+// sections and header fields, then calls commit_checkpoint().
+int create_checkpoint(const char *path, CheckpointImage *image, int num_patients,
+                      int num_units, int64_t num_events, int64_t num_hops, int num_pools) {
+    memset(image, 0, sizeof(CheckpointImage));
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = sizeof(CheckpointHeader);
+    header.patient_record_size = sizeof(DesPatient);
+    header.unit_record_size = sizeof(DesUnit);
+    header.event_record_size = sizeof(DesEvent);
+    header.hop_record_size = sizeof(JourneyHop);
+    header.pool_record_size = sizeof(DesPool);
+    header.num_patients = num_patients;
+    header.num_units = num_units;
+    header.num_events = num_events;
+    header.num_hops = num_hops;
+    header.num_pools = num_pools;
+    header.patients_offset = align_section(sizeof(CheckpointHeader));
+    header.units_offset = align_section(header.patients_offset + (uint64_t)num_patients * sizeof(DesPatient));
+    header.events_offset = align_section(header.units_offset + (uint64_t)num_units * sizeof(DesUnit));
+    header.hops_offset = align_section(header.events_offset + (uint64_t)num_events * sizeof(DesEvent));
+    header.pools_offset = align_section(header.hops_offset + (uint64_t)num_hops * sizeof(JourneyHop));
+    header.file_size = header.pools_offset + pool_records(&header) * sizeof(DesPool);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("open checkpoint");
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)header.file_size) != 0) {
+        perror("ftruncate checkpoint");
+        close(fd);
+        return -1;
+    }
+
+    void *mapping = mmap(NULL, header.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("mmap checkpoint");
+        return -1;
+    }
+
+    image->mapping = mapping;
+    image->mapping_size = header.file_size;
+    memcpy(mapping, &header, sizeof(header));
+    locate_sections(image);
+    return 0;
+}
+
+// Seal a filled checkpoint with its checksum and flush it to disk
+int commit_checkpoint(CheckpointImage *image) {
+    image->header->checksum = checkpoint_checksum(image);
+    if (msync(image->mapping, image->mapping_size, MS_SYNC) != 0) {
+        perror("msync checkpoint");
+        return -1;
+    }
+    return 0;
+}
+
+// Map an existing checkpoint read-only after validating it
+int open_checkpoint(const char *path, CheckpointImage *image) {
+    memset(image, 0, sizeof(CheckpointImage));
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror("open checkpoint");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CheckpointHeader)) {
+        fprintf(stderr, "%s: not a checkpoint file\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("mmap checkpoint");
+        return -1;
+    }
+    image->mapping = mapping;
+    image->mapping_size = st.st_size;
+
+    const CheckpointHeader *header = (const CheckpointHeader*)mapping;
+    const char *problem = NULL;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a checkpoint file";
+    } else if (header->version != CHECKPOINT_VERSION) {
+        problem = "unsupported checkpoint version";
+    } else if (header->header_size != sizeof(CheckpointHeader) ||
+               header->patient_record_size != sizeof(DesPatient) ||
+               header->unit_record_size != sizeof(DesUnit) ||
+               header->event_record_size != sizeof(DesEvent) ||
+               header->hop_record_size != sizeof(JourneyHop) ||
+               header->pool_record_size != sizeof(DesPool)) {
+        problem = "record layout differs from this build";
+    } else if (header->file_size != (uint64_t)st.st_size) {
+        problem = "truncated checkpoint";
+    } else if (header->num_patients < 1 || header->num_units < 1 || header->num_events < 0 || header->num_hops < 0 ||
+               header->num_pools < 1 || header->num_pools > MAX_RESOURCE_POOLS ||
+               header->patients_offset + (uint64_t)header->num_patients * sizeof(DesPatient) > header->units_offset ||
+               header->units_offset + (uint64_t)header->num_units * sizeof(DesUnit) > header->events_offset ||
+               header->events_offset + (uint64_t)header->num_events * sizeof(DesEvent) > header->hops_offset ||
+               header->hops_offset + (uint64_t)header->num_hops * sizeof(JourneyHop) > header->pools_offset ||
+               header->pools_offset + pool_records(header) * sizeof(DesPool) != header->file_size) {
+        problem = "corrupt section table";
+    }
+
+    if (!problem) {
+        locate_sections(image);
+        if (checkpoint_checksum(image) != header->checksum) {
+            problem = "checksum mismatch";
+        }
+    }
+    if (problem) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        close_checkpoint(image);
+        return -1;
+    }
+
+    log_message(LOG_INFO, "Opened checkpoint %s (version %u, t=%.3f, %lld events)",
+                path, header->version, header->clock, (long long)header->num_events);
+    return 0;
+}
+
+void close_checkpoint(CheckpointImage *image) {
+    if (image->mapping) {
+        munmap(image->mapping, image->mapping_size);
+    }
+    memset(image, 0, sizeof(CheckpointImage));
+}
@@ -0,0 +1,155 @@
+#include "comparison.h"
+#include "simulation.h"
+#include "steady_state.h"
+#include "random.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char *metric_labels[NUM_COMPARED_METRICS] = {
+    "Average Waiting Time (s)",
+    "Average Treatment Time (s)",
+    "Average Time in System (s)",
+    "Throughput (patients/min)",
+    "Left Without Being Seen (%)"
+};
+
+static void record_metrics(const GlobalMetrics *metrics, double values[NUM_COMPARED_METRICS]) {
+    values[COMPARE_WAITING_TIME] = metrics->avg_waiting_time;
+    values[COMPARE_TREATMENT_TIME] = metrics->avg_treatment_time;
+    values[COMPARE_TIME_IN_SYSTEM] = metrics->avg_time_in_system;
+    values[COMPARE_THROUGHPUT] = metrics->throughput;
+    values[COMPARE_LEFT_WITHOUT_BEING_SEEN] = metrics->total_patients > 0 ?
+        100.0 * metrics->left_without_being_seen / metrics->total_patients : 0.0;
+}
+
+// Run one configuration once per seed, first_seed onwards, reusing its workers
+static int run_replications(const SimConfig *config, uint64_t first_seed, int replications,
+                            double (*values)[NUM_COMPARED_METRICS]) {
+    SimConfig quiet = *config;
+    quiet.seed = first_seed;
+    quiet.quiet = 1;
+    quiet.keep_patients = 0;
+    quiet.steady_state_batches = 0;
+
+    Simulation *sim = create_simulation(&quiet);
+    if (!sim) return -1;
+
+    int result = 0;
+    for (int r = 0; r < replications && result == 0; r++) {
+        if (r > 0 && reset_simulation(sim, first_seed + r) != 0) {
+            result = -1;
+        } else if (run_simulation(sim) != 0) {
+            fprintf(stderr, "Replication %d (seed %llu) failed\n", r + 1, (unsigned long long)(first_seed + r));
+            result = -1;
+        } else {
+            record_metrics(&get_simulation_results(sim)->metrics, values[r]);
+        }
+    }
+    destroy_simulation(sim);
+    return result;
+}
+
+// Means, paired 95% interval and the variance pairing saved for one metric
+static PairedDifference pair_metric(double (*baseline)[NUM_COMPARED_METRICS],
+                                    double (*alternative)[NUM_COMPARED_METRICS],
+                                    int replications, int metric) {
+    PairedDifference paired;
+    memset(&paired, 0, sizeof(paired));
+    for (int r = 0; r < replications; r++) {
+        paired.baseline += baseline[r][metric] / replications;
+        paired.alternative += alternative[r][metric] / replications;
+    }
+    paired.difference = paired.alternative - paired.baseline;
+
+    double baseline_squares = 0.0, alternative_squares = 0.0, difference_squares = 0.0;
+    for (int r = 0; r < replications; r++) {
+        double b = baseline[r][metric] - paired.baseline;
+        double a = alternative[r][metric] - paired.alternative;
+        baseline_squares += b * b;
+        alternative_squares += a * a;
+        difference_squares += (a - b) * (a - b);
+    }
+    paired.half_width = t_quantile_975(replications - 1) * sqrt(difference_squares / (replications - 1) / replications);
+    // Differences that vary only by rounding mean pairing removed all the noise
+    double unpaired_squares = baseline_squares + alternative_squares;
+    if (difference_squares > 1e-12 * unpaired_squares) {
+        paired.pairing_gain = unpaired_squares / difference_squares;
+    } else if (unpaired_squares > 0.0) {
+        paired.pairing_gain = INFINITY;
+    }
+    return paired;
+}
+
+// Run both configurations over the same seeds and compare them pair by pair.
+// The baseline's seed (or one from the clock) is the first.
+int run_paired_comparison(const SimConfig *baseline, const SimConfig *alternative, PairedComparison *comparison) {
+    memset(comparison, 0, sizeof(PairedComparison));
+    int replications = baseline->replications;
+    comparison->replications = replications;
+    comparison->first_seed = baseline->seed != 0 ? baseline->seed : default_random_seed();
+
+    double (*values)[NUM_COMPARED_METRICS] =
+        (double (*)[NUM_COMPARED_METRICS])malloc(sizeof(double) * NUM_COMPARED_METRICS * 2 * replications);
+    if (!values) {
+        fprintf(stderr, "Failed to allocate replication results\n");
+        return -1;
+    }
+
+    printf("Running %d paired replications (seeds %llu-%llu)...\n", replications,
+           (unsigned long long)comparison->first_seed,
+           (unsigned long long)(comparison->first_seed + replications - 1));
+    fflush(stdout);
+    log_message(LOG_INFO, "Paired comparison: %d replications from seed %llu",
+                replications, (unsigned long long)comparison->first_seed);
+
+    int result = run_replications(baseline, comparison->first_seed, replications, values);
+    if (result == 0) {
+        result = run_replications(alternative, comparison->first_seed, replications, values + replications);
+    }
+    if (result == 0) {
+        for (int m = 0; m < NUM_COMPARED_METRICS; m++) {
+            comparison->metrics[m] = pair_metric(values, values + replications, replications, m);
+        }
+    }
+    free(values);
+    return result;
+}
+
+void print_paired_comparison(const PairedComparison *comparison, const char *alternative_options) {
+    printf("\n╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                 PAIRED COMPARISON                              ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    printf("Alternative                 : baseline options then %s\n", alternative_options);
+    printf("Replications                : %d pairs, common random numbers from seeds %llu-%llu\n\n",
+           comparison->replications, (unsigned long long)comparison->first_seed,
+           (unsigned long long)(comparison->first_seed + comparison->replications - 1));
+
+    printf("%-28s %12s %12s %12s %12s %10s\n", "Metric", "Baseline", "Alternative", "Difference",
+           "95% CI +/-", "Pairing");
+    int significant = 0;
+    for (int m = 0; m < NUM_COMPARED_METRICS; m++) {
+        const PairedDifference *paired = &comparison->metrics[m];
+        int differs = fabs(paired->difference) > paired->half_width + 1e-9 * fabs(paired->baseline);
+        significant |= differs;
+        printf("%-28s %12.2f %12.2f %11.2f%c %12.2f", metric_labels[m], paired->baseline,
+               paired->alternative, paired->difference, differs ? '*' : ' ', paired->half_width);
+        if (isinf(paired->pairing_gain)) {
+            printf(" %10s\n", "exact");
+        } else if (paired->pairing_gain > 0.0) {
+            printf(" %9.1fx\n", paired->pairing_gain);
+        } else {
+            printf(" %10s\n", "-");
+        }
+    }
+
+    printf("\n");
+    if (significant) {
+        printf("* The 95%% confidence interval of the difference excludes zero.\n");
+    }
+    printf("Pairing: variance of the difference between independent runs over that of\n"
+           "the paired runs, i.e. how many times fewer replications pairing needs.\n\n");
+}
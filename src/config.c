@@ -0,0 +1,626 @@
+#include "config.h"
+#include "hospital.h"
+#include "ipc_namespace.h"
+#include "series.h"
+#include "patient_export.h"
+#include "steady_state.h"
+#include "comparison.h"
+#include "department.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+
+// Long options without a short form
+#define OPT_RECORD 1000
+#define OPT_REPLAY 1001
+#define OPT_CONVERT_TRACE 1002
+#define OPT_CLEAN_IPC 1003
+#define OPT_SERIES 1004
+#define OPT_SERIES_INTERVAL 1005
+#define OPT_EXPORT 1006
+#define OPT_SLOWEST 1007
+#define OPT_ATTRIBUTION 1008
+#define OPT_WAITING_ROOM 1009
+#define OPT_PATIENCE 1010
+#define OPT_DISPATCH_CREDITS 1011
+#define OPT_POOL 1012
+#define OPT_NEEDS 1013
+#define OPT_SHIFT 1014
+#define OPT_SHIFT_CYCLE 1015
+#define OPT_STEADY_STATE 1016
+#define OPT_COMPARE 1017
+#define OPT_REPLICATIONS 1018
+
+// --pool, --needs and --shift may each be given this many times
+#define MAX_POOL_OPTIONS 16
+
+// Room for the options --compare adds to the command line
+#define MAX_COMPARE_LENGTH 1024
+#define MAX_COMPARE_ARGS 64
+
+// Set defaults (matches the original fork-based simulator)
+void init_sim_config(SimConfig *config) {
+    if (!config) return;
+    config->backend = BACKEND_PROCESS;
+    config->num_patients = DEFAULT_NUM_PATIENTS;
+    config->num_departments = NUM_DEPARTMENTS;
+    config->num_workers = 0;
+    config->time_scale = 1.0;
+    config->seed = 0;
+    config->deterministic = 0;
+    config->record_path = NULL;
+    config->replay_path = NULL;
+    config->placement.policy = PLACEMENT_NONE;
+    config->dispatch_credits = DEFAULT_DISPATCH_CREDITS;
+    config->checkpoint_path = NULL;
+    config->checkpoint_time = 0.0;
+    config->restore_path = NULL;
+    config->trace_path = NULL;
+    config->convert_path = NULL;
+    config->series_path = NULL;
+    config->series_interval = DEFAULT_SERIES_INTERVAL;
+    config->attribution = 0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        config->waiting_room[d] = UNLIMITED_WAITING_ROOM;
+        config->patience[d] = 0.0;
+    }
+    init_resource_plan(&config->resources);
+    config->instance = NULL;
+    config->clean_ipc = 0;
+    config->clean_instance = NULL;
+    config->estimate = ESTIMATE_NONE;
+    config->export_path = NULL;
+    config->slowest_journeys = DEFAULT_SLOWEST_JOURNEYS;
+    config->steady_state_batches = 0;
+    config->compare_options = NULL;
+    config->replications = DEFAULT_REPLICATIONS;
+    config->keep_patients = 1;
+    config->quiet = 0;
+}
+
+// Get backend name
+const char* get_backend_name(BackendType backend) {
+    switch (backend) {
+        case BACKEND_PROCESS: return "process";
+        case BACKEND_THREAD:  return "thread";
+        case BACKEND_EXECUTOR: return "executor";
+        case BACKEND_COROUTINE: return "coroutine";
+        case BACKEND_DES:     return "des";
+        case BACKEND_PDES:    return "pdes";
+        default:              return "unknown";
+    }
+}
+
+// A value for every department ("20"), or for named ones ("Emergency=20,Radiology=5")
+static int parse_department_values(const char *spec, double values[NUM_DEPARTMENTS]) {
+    char text[256];
+    if (strlen(spec) >= sizeof(text)) return -1;
+    strcpy(text, spec);
+
+    char *end;
+    if (!strchr(text, '=')) {
+        double value = strtod(text, &end);
+        if (end == text || *end != '\0') return -1;
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            values[d] = value;
+        }
+        return 0;
+    }
+
+    init_department_configs();
+    char *save = NULL;
+    for (char *item = strtok_r(text, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char *equals = strchr(item, '=');
+        if (!equals) return -1;
+        *equals = '\0';
+        int dept = 0;
+        while (dept < NUM_DEPARTMENTS && strcasecmp(item, get_department_name((DepartmentType)dept)) != 0) {
+            dept++;
+        }
+        if (dept == NUM_DEPARTMENTS) return -1;
+        values[dept] = strtod(equals + 1, &end);
+        if (end == equals + 1 || *end != '\0') return -1;
+    }
+    return 0;
+}
+
+// Print command line help
+void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  -b, --backend=TYPE   Department backend: process (default), thread,\n");
+    printf("                       executor, coroutine, des or pdes\n");
+    printf("  -p, --patients=N     Number of patients (default %d)\n", DEFAULT_NUM_PATIENTS);
+    printf("  -d, --departments=N  Service units for the executor and DES backends, a multiple of %d\n", NUM_DEPARTMENTS);
+    printf("                       up to %d (default %d)\n", MAX_DEPARTMENT_UNITS, NUM_DEPARTMENTS);
+    printf("  -w, --workers=N      Executor worker threads or pdes logical processes\n");
+    printf("                       (default: one per CPU)\n");
+    printf("  -s, --time-scale=F   Wall seconds per simulated second for the executor\n");
+    printf("                       and coroutine backends (default 1.0)\n");
+    printf("  -S, --seed=N         Random seed for treatment durations (default: from clock)\n");
+    printf("  -D, --deterministic  Process/thread backends: measure times on the simulated\n");
+    printf("                       clock so a seed reproduces the same patient metrics\n");
+    printf("      --record=FILE    Deterministic run that logs every department's treatment order\n");
+    printf("      --replay=FILE    Rerun a recorded log: same seed, patients and treatment order\n");
+    printf("  -P, --pin=POLICY     Pin scheduler and department workers to CPUs: none\n");
+    printf("                       (default), compact, spread or a CPU list like 0,2-5\n");
+    printf("      --dispatch-credits=N\n");
+    printf("                       Process/thread backends: patients in flight per department;\n");
+    printf("                       the scheduler holds the rest (default %d, lowered to fit\n",
+           DEFAULT_DISPATCH_CREDITS);
+    printf("                       the kernel message queues)\n");
+    printf("  -C, --checkpoint=FILE\n");
+    printf("                       DES backends: write a checkpoint and stop at T\n");
+    printf("  -T, --checkpoint-at=T\n");
+    printf("                       Simulated seconds of the checkpoint\n");
+    printf("  -R, --restore=FILE   DES backends: resume from a checkpoint (a new --seed\n");
+    printf("                       gives a what-if continuation)\n");
+    printf("  -t, --trace=FILE     DES backends: replay historical arrivals from a CSV or\n");
+    printf("                       binary trace (one patient per record, --patients ignored)\n");
+    printf("      --convert-trace=FILE\n");
+    printf("                       Write --trace in the binary format and exit\n");
+    printf("      --series=FILE    DES backends: sample queue depth, busy servers and completions\n");
+    printf("                       per department into a columnar file (see bin/hospital_series)\n");
+    printf("      --series-interval=T\n");
+    printf("                       Simulated seconds between samples (default %.0f)\n", DEFAULT_SERIES_INTERVAL);
+    printf("      --attribution    DES backends: record every hop and report which departments\n");
+    printf("                       cause each route's waiting and the slowest 1%%'s time\n");
+    printf("      --waiting-room=N|DEPT=N,...\n");
+    printf("                       DES backends: waiting places per service unit; arrivals to a\n");
+    printf("                       full waiting room leave (balk) (default unlimited)\n");
+    printf("      --patience=T|DEPT=T,...\n");
+    printf("                       DES backends: mean seconds (exponential) a patient waits\n");
+    printf("                       before leaving the line (renege) (default 0 = forever)\n");
+    printf("      --pool=NAME=N,...\n");
+    printf("                       Resource pool of N units per site; a department name resizes\n");
+    printf("                       that department's own pool (process, thread and DES backends)\n");
+    printf("      --needs=DEPT=POOL[+POOL...],...\n");
+    printf("                       Pools a department's treatments draw one unit each from, all\n");
+    printf("                       at once, instead of its own pool\n");
+    printf("      --shift=POOL=TIME=N,...\n");
+    printf("                       DES backends: the pool has N units from each TIME (HH:MM[:SS]\n");
+    printf("                       or seconds) of a repeating cycle; treatments under way finish\n");
+    printf("                       when staffing drops\n");
+    printf("      --shift-cycle=T  Seconds before shift schedules repeat (default %.0f)\n", DEFAULT_SHIFT_CYCLE);
+    printf("  -E, --estimate[=only]\n");
+    printf("                       Print an analytic queueing-network estimate next to the\n");
+    printf("                       simulated metrics, or with =only instead of simulating\n");
+    printf("      --export=FILE    Stream every discharged patient to FILE: CSV, or binary\n");
+    printf("                       records if FILE ends in .bin\n");
+    printf("      --slowest=K      List the K slowest journeys after the run (default %d, 0 = none)\n",
+           DEFAULT_SLOWEST_JOURNEYS);
+    printf("      --steady-state[=BATCHES]\n");
+    printf("                       Drop the start-up transient (MSER-5) and estimate steady-state\n");
+    printf("                       waiting and throughput with 95%% confidence intervals from\n");
+    printf("                       BATCHES batch means (default %d)\n", DEFAULT_STEADY_STATE_BATCHES);
+    printf("      --compare=OPTIONS\n");
+    printf("                       Run these options and, paired seed by seed, the same options\n");
+    printf("                       followed by OPTIONS; report the metric differences with 95%%\n");
+    printf("                       confidence intervals\n");
+    printf("      --replications=N Paired runs of each configuration (default %d)\n", DEFAULT_REPLICATIONS);
+    printf("  -I, --instance=NAME  Name for this run's IPC objects and log file, so runs\n");
+    printf("                       can share a host (default: process ID)\n");
+    printf("      --clean-ipc[=NAME]\n");
+    printf("                       Remove IPC objects left by exited runs (or by NAME) and exit\n");
+    printf("  -h, --help           Display this help message\n");
+}
+
+// Parse command line options, returns 1 if help was shown, -1 on error
+int parse_command_line(int argc, char *argv[], SimConfig *config) {
+    static struct option long_options[] = {
+        {"backend", required_argument, NULL, 'b'},
+        {"patients", required_argument, NULL, 'p'},
+        {"departments", required_argument, NULL, 'd'},
+        {"workers", required_argument, NULL, 'w'},
+        {"time-scale", required_argument, NULL, 's'},
+        {"seed",    required_argument, NULL, 'S'},
+        {"pin",     required_argument, NULL, 'P'},
+        {"dispatch-credits", required_argument, NULL, OPT_DISPATCH_CREDITS},
+        {"deterministic", no_argument, NULL, 'D'},
+        {"record",  required_argument, NULL, OPT_RECORD},
+        {"replay",  required_argument, NULL, OPT_REPLAY},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-at", required_argument, NULL, 'T'},
+        {"restore", required_argument, NULL, 'R'},
+        {"trace",   required_argument, NULL, 't'},
+        {"convert-trace", required_argument, NULL, OPT_CONVERT_TRACE},
+        {"series",  required_argument, NULL, OPT_SERIES},
+        {"series-interval", required_argument, NULL, OPT_SERIES_INTERVAL},
+        {"attribution", no_argument, NULL, OPT_ATTRIBUTION},
+        {"waiting-room", required_argument, NULL, OPT_WAITING_ROOM},
+        {"patience", required_argument, NULL, OPT_PATIENCE},
+        {"pool",    required_argument, NULL, OPT_POOL},
+        {"needs",   required_argument, NULL, OPT_NEEDS},
+        {"shift",   required_argument, NULL, OPT_SHIFT},
+        {"shift-cycle", required_argument, NULL, OPT_SHIFT_CYCLE},
+        {"estimate", optional_argument, NULL, 'E'},
+        {"export",  required_argument, NULL, OPT_EXPORT},
+        {"slowest", required_argument, NULL, OPT_SLOWEST},
+        {"steady-state", optional_argument, NULL, OPT_STEADY_STATE},
+        {"compare", required_argument, NULL, OPT_COMPARE},
+        {"replications", required_argument, NULL, OPT_REPLICATIONS},
+        {"instance", required_argument, NULL, 'I'},
+        {"clean-ipc", optional_argument, NULL, OPT_CLEAN_IPC},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    
+    init_sim_config(config);
+    
+    double waiting_room[NUM_DEPARTMENTS];
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        waiting_room[d] = UNLIMITED_WAITING_ROOM;
+    }
+    int bounded = 0;
+    int credits_given = 0;
+    const char *pool_specs[MAX_POOL_OPTIONS];
+    const char *needs_specs[MAX_POOL_OPTIONS];
+    const char *shift_specs[MAX_POOL_OPTIONS];
+    int num_pool_specs = 0, num_needs_specs = 0, num_shift_specs = 0;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:p:d:w:s:S:P:C:T:R:t:E::I:Dh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'b':
+                if (strcmp(optarg, "process") == 0) {
+                    config->backend = BACKEND_PROCESS;
+                } else if (strcmp(optarg, "thread") == 0) {
+                    config->backend = BACKEND_THREAD;
+                } else if (strcmp(optarg, "executor") == 0) {
+                    config->backend = BACKEND_EXECUTOR;
+                } else if (strcmp(optarg, "coroutine") == 0) {
+                    config->backend = BACKEND_COROUTINE;
+                } else if (strcmp(optarg, "des") == 0) {
+                    config->backend = BACKEND_DES;
+                } else if (strcmp(optarg, "pdes") == 0) {
+                    config->backend = BACKEND_PDES;
+                } else {
+                    fprintf(stderr, "Unknown backend: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'p':
+                config->num_patients = atoi(optarg);
+                break;
+            case 'd':
+                config->num_departments = atoi(optarg);
+                break;
+            case 'w':
+                config->num_workers = atoi(optarg);
+                break;
+            case 's':
+                config->time_scale = atof(optarg);
+                break;
+            case 'S':
+                config->seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'P':
+                if (parse_cpu_placement(optarg, &config->placement) != 0) {
+                    fprintf(stderr, "Invalid CPU placement: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'C':
+                config->checkpoint_path = optarg;
+                break;
+            case 'T':
+                config->checkpoint_time = atof(optarg);
+                break;
+            case 'R':
+                config->restore_path = optarg;
+                break;
+            case 't':
+                config->trace_path = optarg;
+                break;
+            case OPT_CONVERT_TRACE:
+                config->convert_path = optarg;
+                break;
+            case OPT_SERIES:
+                config->series_path = optarg;
+                break;
+            case OPT_SERIES_INTERVAL:
+                config->series_interval = atof(optarg);
+                break;
+            case OPT_ATTRIBUTION:
+                config->attribution = 1;
+                break;
+            case OPT_WAITING_ROOM:
+                if (parse_department_values(optarg, waiting_room) != 0) {
+                    fprintf(stderr, "Invalid waiting rooms: %s\n", optarg);
+                    return -1;
+                }
+                bounded = 1;
+                break;
+            case OPT_PATIENCE:
+                if (parse_department_values(optarg, config->patience) != 0) {
+                    fprintf(stderr, "Invalid patience: %s\n", optarg);
+                    return -1;
+                }
+                bounded = 1;
+                break;
+            case 'E':
+                if (optarg && strcmp(optarg, "only") != 0) {
+                    fprintf(stderr, "Unknown estimate mode: %s (expected only)\n", optarg);
+                    return -1;
+                }
+                config->estimate = optarg ? ESTIMATE_ONLY : ESTIMATE_WITH_RUN;
+                break;
+            case OPT_POOL:
+            case OPT_NEEDS:
+                if ((opt == OPT_POOL ? num_pool_specs : num_needs_specs) == MAX_POOL_OPTIONS) {
+                    fprintf(stderr, "--pool and --needs may each be given at most %d times\n", MAX_POOL_OPTIONS);
+                    return -1;
+                }
+                if (opt == OPT_POOL) {
+                    pool_specs[num_pool_specs++] = optarg;
+                } else {
+                    needs_specs[num_needs_specs++] = optarg;
+                }
+                break;
+            case OPT_SHIFT:
+                if (num_shift_specs == MAX_POOL_OPTIONS) {
+                    fprintf(stderr, "--shift may be given at most %d times\n", MAX_POOL_OPTIONS);
+                    return -1;
+                }
+                shift_specs[num_shift_specs++] = optarg;
+                break;
+            case OPT_SHIFT_CYCLE:
+                config->resources.shift_cycle = atof(optarg);
+                break;
+            case OPT_DISPATCH_CREDITS:
+                config->dispatch_credits = atoi(optarg);
+                credits_given = 1;
+                break;
+            case OPT_EXPORT:
+                config->export_path = optarg;
+                break;
+            case OPT_SLOWEST:
+                config->slowest_journeys = atoi(optarg);
+                break;
+            case OPT_STEADY_STATE:
+                config->steady_state_batches = optarg ? atoi(optarg) : DEFAULT_STEADY_STATE_BATCHES;
+                if (config->steady_state_batches < 2 || config->steady_state_batches > MAX_STEADY_STATE_BATCHES) {
+                    fprintf(stderr, "--steady-state batches must be 2-%d\n", MAX_STEADY_STATE_BATCHES);
+                    return -1;
+                }
+                break;
+            case OPT_COMPARE:
+                config->compare_options = optarg;
+                break;
+            case OPT_REPLICATIONS:
+                config->replications = atoi(optarg);
+                break;
+            case 'I':
+                if (set_ipc_instance(optarg) != 0) {
+                    fprintf(stderr, "Instance names are 1-%d letters, digits, '.', '_' or '-'\n",
+                            MAX_INSTANCE_NAME);
+                    return -1;
+                }
+                config->instance = optarg;
+                break;
+            case OPT_CLEAN_IPC:
+                config->clean_ipc = 1;
+                config->clean_instance = optarg;
+                break;
+            case 'D':
+                config->deterministic = 1;
+                break;
+            case OPT_RECORD:
+                config->record_path = optarg;
+                config->deterministic = 1;
+                break;
+            case OPT_REPLAY:
+                config->replay_path = optarg;
+                config->deterministic = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 1;
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+    
+    if (config->num_patients < 1) {
+        fprintf(stderr, "Number of patients must be positive\n");
+        return -1;
+    }
+    if (config->num_departments < NUM_DEPARTMENTS || config->num_departments > MAX_DEPARTMENT_UNITS ||
+        config->num_departments % NUM_DEPARTMENTS != 0) {
+        fprintf(stderr, "Departments must be a multiple of %d between %d and %d\n",
+                NUM_DEPARTMENTS, NUM_DEPARTMENTS, MAX_DEPARTMENT_UNITS);
+        return -1;
+    }
+    if (config->num_departments != NUM_DEPARTMENTS && config->backend != BACKEND_EXECUTOR &&
+        config->backend != BACKEND_DES && config->backend != BACKEND_PDES) {
+        fprintf(stderr, "--departments requires --backend=executor, des or pdes\n");
+        return -1;
+    }
+    if ((config->checkpoint_path || config->restore_path) &&
+        config->backend != BACKEND_DES && config->backend != BACKEND_PDES) {
+        fprintf(stderr, "--checkpoint and --restore require --backend=des or pdes\n");
+        return -1;
+    }
+    if ((config->checkpoint_path != NULL) != (config->checkpoint_time > 0.0)) {
+        fprintf(stderr, "--checkpoint and --checkpoint-at must be given together\n");
+        return -1;
+    }
+    if (config->deterministic && config->backend != BACKEND_PROCESS && config->backend != BACKEND_THREAD) {
+        fprintf(stderr, "--deterministic, --record and --replay require --backend=process or thread\n");
+        return -1;
+    }
+    if (config->dispatch_credits < 1) {
+        fprintf(stderr, "--dispatch-credits must be >= 1\n");
+        return -1;
+    }
+    if (credits_given && config->backend != BACKEND_PROCESS && config->backend != BACKEND_THREAD) {
+        fprintf(stderr, "--dispatch-credits requires --backend=process or thread\n");
+        return -1;
+    }
+    if (config->record_path && config->replay_path) {
+        fprintf(stderr, "--record and --replay cannot be combined\n");
+        return -1;
+    }
+    if (config->convert_path && !config->trace_path) {
+        fprintf(stderr, "--convert-trace requires --trace\n");
+        return -1;
+    }
+    if (config->trace_path && !config->convert_path &&
+        config->backend != BACKEND_DES && config->backend != BACKEND_PDES) {
+        fprintf(stderr, "--trace requires --backend=des or pdes\n");
+        return -1;
+    }
+    if (config->trace_path && (config->checkpoint_path || config->restore_path)) {
+        fprintf(stderr, "--trace cannot be combined with --checkpoint or --restore\n");
+        return -1;
+    }
+    if (config->series_path && config->backend != BACKEND_DES && config->backend != BACKEND_PDES) {
+        fprintf(stderr, "--series requires --backend=des or pdes\n");
+        return -1;
+    }
+    if (config->attribution && config->backend != BACKEND_DES && config->backend != BACKEND_PDES) {
+        fprintf(stderr, "--attribution requires --backend=des or pdes\n");
+        return -1;
+    }
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        if (waiting_room[d] != UNLIMITED_WAITING_ROOM &&
+            (waiting_room[d] < 0 || waiting_room[d] != (int)waiting_room[d])) {
+            fprintf(stderr, "Waiting rooms must be whole numbers >= 0\n");
+            return -1;
+        }
+        if (config->patience[d] < 0.0) {
+            fprintf(stderr, "Patience must be >= 0\n");
+            return -1;
+        }
+        config->waiting_room[d] = (int)waiting_room[d];
+    }
+    if (bounded && config->backend != BACKEND_DES && config->backend != BACKEND_PDES) {
+        fprintf(stderr, "--waiting-room and --patience require --backend=des or pdes\n");
+        return -1;
+    }
+    // Pools first, so --needs can name a pool from any --pool
+    for (int i = 0; i < num_pool_specs; i++) {
+        if (parse_pool_spec(&config->resources, pool_specs[i]) != 0) {
+            fprintf(stderr, "Invalid --pool %s (NAME=N,... with 1-%d units, up to %d pools)\n",
+                    pool_specs[i], 0xFFFF, MAX_RESOURCE_POOLS);
+            return -1;
+        }
+    }
+    for (int i = 0; i < num_needs_specs; i++) {
+        if (parse_needs_spec(&config->resources, needs_specs[i]) != 0) {
+            fprintf(stderr, "Invalid --needs %s (DEPT=POOL[+POOL...],... naming defined pools)\n",
+                    needs_specs[i]);
+            return -1;
+        }
+    }
+    if (!(config->resources.shift_cycle > 0.0)) {
+        fprintf(stderr, "Shift cycle must be > 0\n");
+        return -1;
+    }
+    for (int i = 0; i < num_shift_specs; i++) {
+        if (parse_shift_spec(&config->resources, shift_specs[i]) != 0) {
+            fprintf(stderr, "Invalid --shift %s (POOL=TIME=N,... with ascending times within the %.0f s cycle,\n"
+                    "0-%d units and some staffing)\n", shift_specs[i], config->resources.shift_cycle, 0xFFFF);
+            return -1;
+        }
+    }
+    if (num_shift_specs > 0 && config->backend != BACKEND_DES && config->backend != BACKEND_PDES) {
+        fprintf(stderr, "--shift requires --backend=des or pdes\n");
+        return -1;
+    }
+    int unstaffed = unstaffed_department(&config->resources);
+    if (unstaffed >= 0) {
+        fprintf(stderr, "%s never has every pool it needs staffed at once\n",
+                get_department_name((DepartmentType)unstaffed));
+        return -1;
+    }
+    int pooled = !is_default_resource_plan(&config->resources);
+    if (pooled && (config->backend == BACKEND_EXECUTOR || config->backend == BACKEND_COROUTINE)) {
+        fprintf(stderr, "--pool and --needs require --backend=process, thread, des or pdes\n");
+        return -1;
+    }
+    if (pooled && config->estimate != ESTIMATE_NONE) {
+        fprintf(stderr, "--estimate assumes one resource pool per department\n");
+        return -1;
+    }
+    if (bounded && config->estimate != ESTIMATE_NONE) {
+        fprintf(stderr, "--estimate assumes unlimited waiting rooms and patience\n");
+        return -1;
+    }
+    if (config->series_interval <= 0.0) {
+        fprintf(stderr, "Series interval must be > 0\n");
+        return -1;
+    }
+    if (config->estimate != ESTIMATE_NONE &&
+        (config->trace_path || config->checkpoint_path || config->restore_path)) {
+        fprintf(stderr, "--estimate covers the default patient mix, not --trace, --checkpoint or --restore\n");
+        return -1;
+    }
+    if (config->slowest_journeys < 0 || config->slowest_journeys > MAX_SLOWEST_JOURNEYS) {
+        fprintf(stderr, "--slowest must be 0-%d\n", MAX_SLOWEST_JOURNEYS);
+        return -1;
+    }
+    if (config->num_workers < 0 || config->time_scale <= 0.0) {
+        fprintf(stderr, "Workers must be >= 0 and time scale > 0\n");
+        return -1;
+    }
+    if (config->replications < 2 || config->replications > MAX_REPLICATIONS) {
+        fprintf(stderr, "--replications must be 2-%d\n", MAX_REPLICATIONS);
+        return -1;
+    }
+    if (config->compare_options &&
+        (config->record_path || config->replay_path || config->checkpoint_path || config->restore_path ||
+         config->export_path || config->series_path || config->convert_path || config->estimate == ESTIMATE_ONLY)) {
+        fprintf(stderr, "--compare runs many times: it cannot be combined with --record, --replay,\n"
+                "--checkpoint, --restore, --export, --series, --convert-trace or --estimate=only\n");
+        return -1;
+    }
+    
+    return 0;
+}
+
+// The alternative of a paired comparison: the command line followed by the
+// --compare options, split at whitespace, so later options override earlier
+// ones. Its paths point into a buffer kept for the life of the program.
+int parse_alternative_config(int argc, char *argv[], const char *options, SimConfig *alternative) {
+    static char text[MAX_COMPARE_LENGTH];
+    static char *args[MAX_COMPARE_ARGS];
+    if (strlen(options) >= sizeof(text)) {
+        fprintf(stderr, "--compare options are limited to %d characters\n", MAX_COMPARE_LENGTH - 1);
+        return -1;
+    }
+    strcpy(text, options);
+
+    int count = 0;
+    char *save = NULL;
+    char *arg = strtok_r(text, " \t", &save);
+    for (int i = 0; i < argc || arg; i++) {
+        if (count == MAX_COMPARE_ARGS) {
+            fprintf(stderr, "Too many options for --compare (at most %d in all)\n", MAX_COMPARE_ARGS);
+            return -1;
+        }
+        if (i < argc) {
+            args[count++] = argv[i];
+        } else {
+            args[count++] = arg;
+            arg = strtok_r(NULL, " \t", &save);
+        }
+    }
+
+    optind = 0;   // getopt starts over, as for a new command line
+    int result = parse_command_line(count, args, alternative);
+    optind = 0;
+    if (result != 0) {
+        fprintf(stderr, "Invalid --compare options: %s\n", options);
+        return -1;
+    }
+    // The command line's own --compare is seen again; only another one differs
+    if (alternative->clean_ipc || alternative->compare_options != options) {
+        fprintf(stderr, "--compare options cannot include --compare or --clean-ipc\n");
+        return -1;
+    }
+    alternative->compare_options = NULL;
+    return 0;
+}
@@ -4,7 +4,12 @@
 #include "message_queue.h"
 #include "shared_memory.h"
 #include "metrics.h"
+#include "profiler.h"
+#include "random.h"
+#include "replay.h"
+#include "resource_pool.h"
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/ipc.h>
@@ -19,31 +24,32 @@ void init_department_configs() {
     department_configs[EMERGENCY].type = EMERGENCY;
     strcpy(department_configs[EMERGENCY].name, "Emergency");
     department_configs[EMERGENCY].resource_count = EMERGENCY_DOCTORS;
-    department_configs[EMERGENCY].sem_name = SEM_EMERGENCY;
     
     // OPD Department
     department_configs[OPD].type = OPD;
     strcpy(department_configs[OPD].name, "OPD");
     department_configs[OPD].resource_count = OPD_DOCTORS;
-    department_configs[OPD].sem_name = SEM_OPD;
     
     // Radiology Department
     department_configs[RADIOLOGY].type = RADIOLOGY;
     strcpy(department_configs[RADIOLOGY].name, "Radiology");
     department_configs[RADIOLOGY].resource_count = RADIOLOGY_MACHINES;
-    department_configs[RADIOLOGY].sem_name = SEM_RADIOLOGY;
     
     // Pharmacy Department
     department_configs[PHARMACY].type = PHARMACY;
     strcpy(department_configs[PHARMACY].name, "Pharmacy");
     department_configs[PHARMACY].resource_count = PHARMACY_PHARMACISTS;
-    department_configs[PHARMACY].sem_name = SEM_PHARMACY;
     
     // Billing Department
     department_configs[BILLING].type = BILLING;
     strcpy(department_configs[BILLING].name, "Billing");
     department_configs[BILLING].resource_count = BILLING_CASHIERS;
-    department_configs[BILLING].sem_name = SEM_BILLING;
+    
+    // Every department shares the same treatment duration range
+    for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+        department_configs[i].service_time_min = TREATMENT_TIME_MIN;
+        department_configs[i].service_time_max = TREATMENT_TIME_MAX;
+    }
 }
 
 // Get department name
@@ -54,45 +60,21 @@ const char* get_department_name(DepartmentType type) {
     return "Unknown";
 }
 
-// Get department resource count
+// Patients a department can treat at once under the active resource plan
 int get_department_resources(DepartmentType type) {
     if (type >= 0 && type < NUM_DEPARTMENTS) {
-        return department_configs[type].resource_count;
+        return pooled_capacity(get_resource_plan(), type);
     }
     return 0;
 }
 
-// Get department semaphore name
-const char* get_department_semaphore_name(DepartmentType type) {
-    if (type >= 0 && type < NUM_DEPARTMENTS) {
-        return department_configs[type].sem_name;
-    }
-    return NULL;
-}
-
-// Department process - handles patients (runs as separate process after fork)
-void department_process(DepartmentType dept_type) {
+// Department process - handles patients (runs as separate process after fork).
+// The queue and segment IDs are the parent's, so instances never share them.
+void department_process(DepartmentType dept_type, int msg_queue_id, int return_queue_id, int shm_id) {
     log_message(LOG_INFO, "Department %s process started (PID: %d)", 
                 get_department_name(dept_type), getpid());
     
-    // Get message queue
-    int msg_queue_id = msgget(MSG_QUEUE_BASE_KEY, 0666);
-    if (msg_queue_id == -1) {
-        log_message(LOG_ERROR, "Department %s: Failed to access message queue", 
-                    get_department_name(dept_type));
-        exit(1);
-    }
-    
-    // Open semaphore for this department
-    sem_t *sem = open_semaphore(get_department_semaphore_name(dept_type));
-    if (!sem) {
-        log_message(LOG_ERROR, "Department %s: Failed to open semaphore", 
-                    get_department_name(dept_type));
-        exit(1);
-    }
-    
     // Attach to shared memory
-    int shm_id = shmget(SHM_KEY, sizeof(HospitalState), 0666);
     HospitalState *hospital_state = attach_shared_memory(shm_id);
     if (!hospital_state) {
         log_message(LOG_ERROR, "Department %s: Failed to attach shared memory", 
@@ -100,62 +82,140 @@ void department_process(DepartmentType dept_type) {
         exit(1);
     }
     
+    department_service_loop(dept_type, msg_queue_id, return_queue_id, hospital_state);
+    
+    detach_shared_memory(hospital_state);
+}
+
+// Take one unit of every pool the department needs, lowest pool first.
+// Every department takes its pools in that one order, so no cycle of
+// departments can each hold a pool the next one is waiting for.
+static void acquire_pools(HospitalState *hospital_state, uint32_t needs) {
+    for (int p = 0; p < hospital_state->num_pools; p++) {
+        if ((needs >> p) & 1) {
+            wait_semaphore(&hospital_state->gates[p]);
+        }
+    }
+}
+
+static void release_pools(HospitalState *hospital_state, uint32_t needs) {
+    for (int p = hospital_state->num_pools - 1; p >= 0; p--) {
+        if ((needs >> p) & 1) {
+            post_semaphore(&hospital_state->gates[p]);
+        }
+    }
+}
+
+// Serve patients until a shutdown message arrives (shared by both backends)
+void department_service_loop(DepartmentType dept_type, int msg_queue_id, int return_queue_id,
+                             HospitalState *hospital_state) {
+    profiler_attach(&hospital_state->profile, dept_type + 1, get_department_name(dept_type));
+    
+    // Resource gates of this department's pools live in shared memory
+    uint32_t needs = hospital_state->pool_needs[dept_type];
+    
+    // State, gate and queue are all in reach: the scheduler may start dispatching
+    arrive_latch(&hospital_state->departments_ready);
+    
+    // Simulated time this department finishes its current patient, per run
+    double department_clock = 0.0;
+    int run_generation = __atomic_load_n(&hospital_state->run_generation, __ATOMIC_ACQUIRE);
+    
     // Process patients continuously
     while (1) {
         Message msg;
+        int received;
+        
+        // Receive message for this department (blocking), in recorded order when replaying
+        if (is_replaying()) {
+            received = next_replayed_message(msg_queue_id, dept_type, &msg);
+            if (received == 1) {
+                __atomic_add_fetch(&hospital_state->replay_divergences, 1, __ATOMIC_RELAXED);
+                received = 0;
+            }
+        } else {
+            received = receive_message_from_department(msg_queue_id, dept_type, &msg, 1);
+        }
+        
+        // Queue removed under us (instance cleaned up): nothing left to serve
+        if (received == -1 && (errno == EIDRM || errno == EINVAL)) {
+            log_message(LOG_WARNING, "Department %s: Message queue removed", get_department_name(dept_type));
+            break;
+        }
         
-        // Receive message for this department (blocking)
-        if (receive_message_from_department(msg_queue_id, dept_type, &msg, 1) == 0) {
-            time_t wait_start = time(NULL);
+        if (received == 0) {
+            if (msg.patient_id == SHUTDOWN_PATIENT_ID) {
+                log_message(LOG_INFO, "Department %s: Shutting down", get_department_name(dept_type));
+                break;
+            }
+            
+            int generation = __atomic_load_n(&hospital_state->run_generation, __ATOMIC_ACQUIRE);
+            if (generation != run_generation) {
+                run_generation = generation;
+                department_clock = 0.0;
+            }
             
             log_message(LOG_INFO, "Department %s: Patient %d arrived", 
                         get_department_name(dept_type), msg.patient_id);
             
-            // Wait for resource availability (FCFS enforced by semaphore)
-            wait_semaphore(sem);
+            // Wait for resource availability (FCFS enforced by each pool's gate)
+            acquire_pools(hospital_state, needs);
+            
+            // On the wall clock waiting runs from dispatch, so time queued
+            // behind other patients counts, not just time at the gates
+            double treatment_start = hospital_clock();
+            double waiting_time = treatment_start - msg.enqueue_time;
             
-            time_t treatment_start = time(NULL);
-            double waiting_time = difftime(treatment_start, wait_start);
+            // On the simulated clock treatment starts once both patient and department are ready
+            double sim_start = department_clock > msg.sim_time ? department_clock : msg.sim_time;
+            uint64_t sequence = __atomic_fetch_add(&hospital_state->treatment_sequence, 1, __ATOMIC_RELAXED);
+            record_treatment_order(sequence, dept_type, &msg, sim_start);
             
             // Update shared memory - patient being treated
-            lock_mutex(&hospital_state->mutex);
-            hospital_state->active_patients[dept_type]++;
-            unlock_mutex(&hospital_state->mutex);
+            change_department_occupancy(hospital_state, dept_type, 1, -1);
             
             log_message(LOG_INFO, "Department %s: Treating Patient %d (waited %.2fs)", 
                         get_department_name(dept_type), msg.patient_id, waiting_time);
             
-            // Simulate treatment (random time between min and max)
-            int treatment_duration = TREATMENT_TIME_MIN + 
-                                    (rand() % (TREATMENT_TIME_MAX - TREATMENT_TIME_MIN + 1));
+            // Simulate treatment (this patient's and hop's draw between min and max)
+            int treatment_duration = random_int_range(hospital_state->seed, RANDOM_SERVICE,
+                                                      msg.patient_id - 1, msg.current_dept_index,
+                                                      TREATMENT_TIME_MIN, TREATMENT_TIME_MAX);
             sleep(treatment_duration);
             
-            time_t treatment_end = time(NULL);
-            double treatment_time = difftime(treatment_end, treatment_start);
+            double treatment_time = hospital_clock() - treatment_start;
+            
+            if (hospital_state->simulated_clock) {
+                msg.waiting_time = sim_start - msg.sim_time;
+                msg.treatment_time = treatment_duration;
+                msg.sim_time = sim_start + treatment_duration;
+                department_clock = msg.sim_time;
+            } else {
+                msg.waiting_time = waiting_time;
+                msg.treatment_time = treatment_time;
+            }
             
             log_message(LOG_INFO, "Department %s: Patient %d treatment complete (%.2fs)", 
                         get_department_name(dept_type), msg.patient_id, treatment_time);
             
-            // Release resource
-            post_semaphore(sem);
+            // Release resources
+            release_pools(hospital_state, needs);
             
             // Update shared memory - treatment complete
-            lock_mutex(&hospital_state->mutex);
-            hospital_state->active_patients[dept_type]--;
-            unlock_mutex(&hospital_state->mutex);
-            
-            // Send completion message back to scheduler (message type = NUM_DEPARTMENTS + 1)
-            MessageBuffer response;
-            response.mtype = NUM_DEPARTMENTS + 1;
-            response.data = msg;
-            response.data.sent_time = time(NULL);
+            change_department_occupancy(hospital_state, dept_type, -1, 0);
             
-            if (msgsnd(msg_queue_id, &response, sizeof(Message), 0) == -1) {
+            // Send completion message back to scheduler. Dispatch credits keep
+            // the return queue from filling; count it if it ever does.
+            PROFILE_SCOPE(PROF_COMPLETION_SEND);
+            int sent = send_completion_message(return_queue_id, &msg, 0);
+            if (sent == -1 && errno == EAGAIN) {
+                __atomic_add_fetch(&hospital_state->blocked_completions[dept_type], 1, __ATOMIC_RELAXED);
+                sent = send_completion_message(return_queue_id, &msg, 1);
+            }
+            if (sent == -1) {
                 log_message(LOG_ERROR, "Department %s: Failed to send completion message for Patient %d",
                             get_department_name(dept_type), msg.patient_id);
             }
         }
     }
-    
-    detach_shared_memory(hospital_state);
 }
@@ -0,0 +1,1515 @@
+#include "des.h"
+#include "checkpoint.h"
+#include "department.h"
+#include "patient.h"
+#include "metrics.h"
+#include "logger.h"
+#include "random.h"
+#include "placement.h"
+#include "trace.h"
+#include "series.h"
+#include "patient_export.h"
+#include "attribution.h"
+#include "timer_wheel.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#define NO_PATIENT -1
+#define PATIENCE_TICK 1.0   // Seconds per slot of the patience timer wheels
+
+// Next staffing change of one scheduled pool at one site
+typedef struct {
+    int pool;                    // site * num_pools + pool
+    int64_t cycle;               // Shift cycle the change falls in
+    int change;                  // Index in the pool's schedule
+    double due;                  // Simulated time it takes effect
+} DesShift;
+
+// Growable event buffer, used both as a min-heap and as a plain list
+typedef struct {
+    DesEvent *events;
+    int count;
+    int capacity;
+} DesEventList;
+
+// Logical process: a partition of units simulated by one thread
+typedef struct {
+    int id;
+    pthread_t thread;
+    DesEventList pending;        // Local future events (min-heap)
+    DesEventList *outbox;        // Per destination LP, flushed once per round
+    double lookahead;            // Minimum service time over owned units
+    double promise;              // Last lower bound sent to the other LPs
+
+    // Inbox, written by the other LPs
+    pthread_mutex_t inbox_mutex;
+    pthread_cond_t inbox_cond;
+    DesEventList inbox;
+    double *channel_clock;       // Per source LP: no later message is earlier
+    char *linked;                // Per source LP: some route leads from it to us
+    int inbox_dirty;
+
+    int *units;                  // Owned units, summed into time-series samples
+    int num_units;
+    int64_t next_sample;         // Row of the next time-series sample
+    SeriesBuffer series;
+
+    TimerWheel timers;           // Patience of patients waiting at owned units
+
+    DesShift *shifts;            // Scheduled pools drawn on by owned units
+    int num_shifts;
+    double next_shift;           // Earliest due change, INFINITY if none
+
+    long events;
+    long messages_sent;
+    long null_messages;
+    long blocked;
+} DesProcess;
+
+// Engine state shared by all logical processes
+typedef struct {
+    DesUnit *units;
+    int num_units;
+    int num_sites;
+
+    DesPatient *patients;
+    int num_patients;
+    long remaining_departures;   // Treatments not yet finished, run ends at zero
+
+    DesProcess *lps;
+    int num_lps;
+    int done;
+
+    // Arrival trace: observed service times per patient hop, if any were recorded
+    const char *trace_path;
+    float *observed_service;
+    int64_t *observed_start;     // Per patient: index of hop 0, -1 if nothing observed
+    int64_t num_observed;
+    double observed_min[NUM_DEPARTMENTS];
+    double trace_span;           // Seconds from first to last arrival
+
+    uint64_t seed;
+    double start_time;           // 0, or the clock of the restored checkpoint
+    double stop_time;            // Checkpoint cut, INFINITY to run to completion
+    long restored_events;        // Events processed before the checkpoint
+
+    const char *series_path;
+    double sample_interval;      // Time-series spacing, 0 once the series is closed
+    SeriesWriter series;
+
+    HopArena hops;               // Per-hop journeys (--attribution), hops == NULL if not recorded
+
+    // Finite waiting rooms and patience, per department type
+    int waiting_room[NUM_DEPARTMENTS];
+    double patience[NUM_DEPARTMENTS];
+    TimerNode *timer_nodes;      // Per patient, NULL if nobody runs out of patience
+
+    // Resource pools, num_pools per site; a treatment holds one unit of each
+    // pool its department needs
+    DesPool *pools;
+    int num_pools;
+    uint32_t pool_needs[NUM_DEPARTMENTS];
+    uint32_t pool_sharers[NUM_DEPARTMENTS];   // Departments that may start when one of these ends
+    uint32_t pool_users[MAX_RESOURCE_POOLS];  // Departments drawing on each pool
+    ResourcePlan plan;
+    double shift_origin;         // Shift clock at simulated time 0
+} DesEngine;
+
+static DesEngine engine;
+
+// Strict total order on events
+static inline int event_before(const DesEvent *a, const DesEvent *b) {
+    if (a->time != b->time) return a->time < b->time;
+    if (a->patient != b->patient) return a->patient < b->patient;
+    if (a->hop != b->hop) return a->hop < b->hop;
+    return a->kind < b->kind;
+}
+
+static int event_list_reserve(DesEventList *list, int extra) {
+    if (list->count + extra <= list->capacity) return 0;
+
+    int new_capacity = list->capacity ? list->capacity : 256;
+    while (new_capacity < list->count + extra) new_capacity *= 2;
+    DesEvent *events = (DesEvent*)realloc(list->events, sizeof(DesEvent) * new_capacity);
+    if (!events) {
+        log_message(LOG_ERROR, "DES: failed to grow event list");
+        exit(1);
+    }
+    list->events = events;
+    list->capacity = new_capacity;
+    return 0;
+}
+
+static void event_list_append(DesEventList *list, const DesEvent *event) {
+    event_list_reserve(list, 1);
+    list->events[list->count++] = *event;
+}
+
+static void heap_push(DesEventList *heap, const DesEvent *event) {
+    event_list_reserve(heap, 1);
+
+    int i = heap->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!event_before(event, &heap->events[parent])) break;
+        heap->events[i] = heap->events[parent];
+        i = parent;
+    }
+    heap->events[i] = *event;
+}
+
+static DesEvent heap_pop(DesEventList *heap) {
+    DesEvent top = heap->events[0];
+    DesEvent last = heap->events[--heap->count];
+
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count &&
+            event_before(&heap->events[child + 1], &heap->events[child])) {
+            child++;
+        }
+        if (!event_before(&heap->events[child], &last)) break;
+        heap->events[i] = heap->events[child];
+        i = child;
+    }
+    if (heap->count > 0) {
+        heap->events[i] = last;
+    }
+    return top;
+}
+
+// Unit serving a department type at the patient's site
+static int unit_for_patient(int patient, DepartmentType dept) {
+    int site = patient % engine.num_sites;
+    return site * NUM_DEPARTMENTS + dept;
+}
+
+// Deliver an event to the LP owning its unit
+static void schedule_event(DesProcess *lp, const DesEvent *event) {
+    int owner = engine.units[event->unit].lp;
+    if (owner == lp->id) {
+        heap_push(&lp->pending, event);
+    } else {
+        event_list_append(&lp->outbox[owner], event);
+    }
+}
+
+// Observed treatment time of a trace patient's hop, negative if none
+static inline double observed_service_time(int patient, int hop) {
+    if (!engine.observed_start || engine.observed_start[patient] < 0) return -1.0;
+    return engine.observed_service[engine.observed_start[patient] + hop];
+}
+
+// Exponential patience of a patient at one hop
+static inline double patience_time(int patient, int hop, int dept) {
+    return -engine.patience[dept] * log(1.0 - random_uniform(engine.seed, RANDOM_PATIENCE, patient, hop));
+}
+
+// End the run and wake every LP blocked on its inbox
+static void stop_logical_processes() {
+    __atomic_store_n(&engine.done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < engine.num_lps; i++) {
+        pthread_mutex_lock(&engine.lps[i].inbox_mutex);
+        pthread_cond_broadcast(&engine.lps[i].inbox_cond);
+        pthread_mutex_unlock(&engine.lps[i].inbox_mutex);
+    }
+}
+
+// Count treatments done or skipped; the run ends when none are left
+static void finish_treatments(long count) {
+    if (__atomic_sub_fetch(&engine.remaining_departures, count, __ATOMIC_ACQ_REL) == 0) {
+        stop_logical_processes();
+    }
+}
+
+// Patient leaves untreated from its current hop (balked or reneged); the
+// rest of its route is never visited
+static void leave_hospital(int patient, double now, uint8_t status) {
+    DesPatient *p = &engine.patients[patient];
+    p->status = status;
+    p->discharge_time = now;
+    p->total_waiting_time += now - p->enqueue_time;
+    if (engine.hops.hops) {
+        record_hop(&engine.hops, patient, p->hop, p->enqueue_time, now, now);
+    }
+
+    long skipped = 0;
+    while (get_route_department((RouteType)p->route_type, p->hop + skipped) != (DepartmentType)-1) skipped++;
+    finish_treatments(skipped);
+}
+
+static inline DesPool* site_pools(int unit) {
+    return &engine.pools[(unit / NUM_DEPARTMENTS) * engine.num_pools];
+}
+
+// Every pool the unit's department needs has a unit free
+static int pools_free(int unit) {
+    DesPool *pools = site_pools(unit);
+    uint32_t needs = engine.pool_needs[engine.units[unit].type];
+    for (int p = 0; p < engine.num_pools; p++) {
+        if (((needs >> p) & 1) && pools[p].in_use >= pools[p].capacity) return 0;
+    }
+    return 1;
+}
+
+// Take (+1) or give back (-1) one unit of each of the unit's pools
+static void change_pools(int unit, int change, double now) {
+    DesPool *pools = site_pools(unit);
+    uint32_t needs = engine.pool_needs[engine.units[unit].type];
+    for (int p = 0; p < engine.num_pools; p++) {
+        if (!((needs >> p) & 1)) continue;
+        advance_occupancy(&pools[p].occupancy, now, pools[p].in_use, 0, pools[p].capacity);
+        pools[p].in_use += change;
+        if (change > 0) pools[p].acquisitions++;
+    }
+}
+
+// Occupy a server. The next hop's arrival is known as soon as treatment
+// starts, which is what gives each LP its lookahead.
+static void start_service(DesProcess *lp, int patient, int unit, double now) {
+    DesPatient *p = &engine.patients[patient];
+    DepartmentInfo *info = &department_configs[engine.units[unit].type];
+    double duration = observed_service_time(patient, p->hop);
+    if (duration < 0.0) {
+        duration = info->service_time_min +
+                   random_uniform(engine.seed, RANDOM_SERVICE, patient, p->hop) * (info->service_time_max - info->service_time_min);
+    }
+    double end = now + duration;
+
+    if (p->status == DES_QUEUED) {
+        p->status = DES_ACTIVE;
+        if (engine.timer_nodes) {
+            cancel_timer(&lp->timers, patient);
+        }
+    }
+    p->total_waiting_time += now - p->enqueue_time;
+    p->total_treatment_time += duration;
+    if (engine.hops.hops) {
+        record_hop(&engine.hops, patient, p->hop, p->enqueue_time, now, end);
+    }
+
+    DesEvent depart = { end, patient, (uint16_t)unit, p->hop, DES_DEPART };
+    heap_push(&lp->pending, &depart);
+
+    DepartmentType next_dept = get_route_department((RouteType)p->route_type, p->hop + 1);
+    if (next_dept == (DepartmentType)-1) {
+        p->discharge_time = end;
+        PatientRecord record = { p->arrival_time, end, p->total_waiting_time, p->total_treatment_time,
+                                 patient + 1, p->route_type, p->triage, {0} };
+        export_patient(&record);
+        return;
+    }
+
+    DesEvent arrive = { end, patient, (uint16_t)unit_for_patient(patient, next_dept),
+                        (uint8_t)(p->hop + 1), DES_ARRIVE };
+    schedule_event(lp, &arrive);
+}
+
+// Patient reaches a unit: treat now or join its FIFO queue
+static void handle_arrive(DesProcess *lp, const DesEvent *event) {
+    DesPatient *p = &engine.patients[event->patient];
+    DesUnit *u = &engine.units[event->unit];
+
+    p->hop = event->hop;
+    p->enqueue_time = event->time;
+    if (event->hop == 0) {
+        p->arrival_time = event->time;
+    }
+
+    advance_occupancy(&u->occupancy, event->time, u->busy, u->queue_length, u->capacity);
+    if (u->queue_length == 0 && pools_free(event->unit)) {
+        u->busy++;
+        change_pools(event->unit, 1, event->time);
+        start_service(lp, event->patient, event->unit, event->time);
+        return;
+    }
+
+    int room = engine.waiting_room[u->type];
+    if (room != UNLIMITED_WAITING_ROOM && u->queue_length >= room) {
+        u->balked++;
+        leave_hospital(event->patient, event->time, DES_BALKED);
+        return;
+    }
+
+    p->status = DES_QUEUED;
+    p->next_waiting = NO_PATIENT;
+    if (u->wait_tail == NO_PATIENT) {
+        u->wait_head = event->patient;
+    } else {
+        engine.patients[u->wait_tail].next_waiting = event->patient;
+    }
+    u->wait_tail = event->patient;
+    if (++u->queue_length > u->max_queue_length) {
+        u->max_queue_length = u->queue_length;
+    }
+    DesPool *pools = site_pools(event->unit);
+    for (int p = 0; p < engine.num_pools; p++) {
+        if (((engine.pool_needs[u->type] >> p) & 1) && pools[p].in_use >= pools[p].capacity) {
+            pools[p].queued++;
+        }
+    }
+    if (engine.patience[u->type] > 0.0) {
+        arm_timer(&lp->timers, event->patient, event->time + patience_time(event->patient, event->hop, u->type));
+    }
+}
+
+// First patient still waiting in a unit's line; patients who reneged stay
+// linked until they reach the front
+static int waiting_head(DesUnit *u) {
+    while (u->wait_head != NO_PATIENT && engine.patients[u->wait_head].status != DES_QUEUED) {
+        u->wait_head = engine.patients[u->wait_head].next_waiting;
+    }
+    if (u->wait_head == NO_PATIENT) {
+        u->wait_tail = NO_PATIENT;
+    }
+    return u->wait_head;
+}
+
+// Start waiting patients of the given departments at a site while all their
+// pools have a unit free, longest waiting first. Pools are taken all at once,
+// so no patient ever holds some while waiting for the rest.
+static void start_waiting(DesProcess *lp, int site, uint32_t departments, double now) {
+    for (;;) {
+        int best = -1;
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            if (!((departments >> d) & 1)) continue;
+            int unit = site * NUM_DEPARTMENTS + d;
+            int head = waiting_head(&engine.units[unit]);
+            if (head == NO_PATIENT || !pools_free(unit)) continue;
+            if (best >= 0) {
+                const DesPatient *p = &engine.patients[head];
+                const DesPatient *q = &engine.patients[engine.units[best].wait_head];
+                if (p->enqueue_time > q->enqueue_time ||
+                    (p->enqueue_time == q->enqueue_time && head > engine.units[best].wait_head)) continue;
+            }
+            best = unit;
+        }
+        if (best < 0) return;
+
+        DesUnit *u = &engine.units[best];
+        int next_patient = u->wait_head;
+        advance_occupancy(&u->occupancy, now, u->busy, u->queue_length, u->capacity);
+        u->wait_head = engine.patients[next_patient].next_waiting;
+        if (u->wait_head == NO_PATIENT) {
+            u->wait_tail = NO_PATIENT;
+        }
+        u->queue_length--;
+        u->busy++;
+        change_pools(best, 1, now);
+        start_service(lp, next_patient, best, now);
+    }
+}
+
+// Treatment ends: its pools go to the patients waiting for them
+static void handle_depart(DesProcess *lp, const DesEvent *event) {
+    DesUnit *u = &engine.units[event->unit];
+    u->served++;
+    advance_occupancy(&u->occupancy, event->time, u->busy, u->queue_length, u->capacity);
+    u->busy--;
+    change_pools(event->unit, -1, event->time);
+    start_waiting(lp, event->unit / NUM_DEPARTMENTS, engine.pool_sharers[u->type], event->time);
+    finish_treatments(1);
+}
+
+// Servers of a unit: the fewest units of any pool its department needs
+static int unit_capacity(int unit) {
+    DesPool *pools = site_pools(unit);
+    uint32_t needs = engine.pool_needs[engine.units[unit].type];
+    int capacity = INT32_MAX;
+    for (int p = 0; p < engine.num_pools; p++) {
+        if (((needs >> p) & 1) && pools[p].capacity < capacity) {
+            capacity = pools[p].capacity;
+        }
+    }
+    return capacity;
+}
+
+// Point a shift at a pool's first change due at or after a simulated time
+static void find_shift_change(DesShift *shift, double time) {
+    const ShiftSchedule *schedule = &engine.plan.shifts[shift->pool % engine.num_pools];
+    double cycle = engine.plan.shift_cycle;
+    shift->cycle = (int64_t)floor((engine.shift_origin + time) / cycle) - 1;
+    shift->change = 0;
+    for (;;) {
+        shift->due = shift->cycle * cycle + schedule->start[shift->change] - engine.shift_origin;
+        if (shift->due >= time) return;
+        if (++shift->change == schedule->num_changes) {
+            shift->change = 0;
+            shift->cycle++;
+        }
+    }
+}
+
+static void update_next_shift(DesProcess *lp) {
+    lp->next_shift = INFINITY;
+    for (int i = 0; i < lp->num_shifts; i++) {
+        if (lp->shifts[i].due < lp->next_shift) lp->next_shift = lp->shifts[i].due;
+    }
+}
+
+// Staffing changes that are due. Treatments under way keep their units when
+// a pool shrinks, and nobody new starts until fewer units are in use than it
+// has; when it grows, its waiting patients start at once.
+static void change_shifts(DesProcess *lp, double now) {
+    for (int i = 0; i < lp->num_shifts; i++) {
+        DesShift *shift = &lp->shifts[i];
+        if (shift->due > now) continue;
+
+        int site = shift->pool / engine.num_pools, p = shift->pool % engine.num_pools;
+        const ShiftSchedule *schedule = &engine.plan.shifts[p];
+        DesPool *pool = &engine.pools[shift->pool];
+        int capacity = schedule->capacity[shift->change];
+        if (++shift->change == schedule->num_changes) {
+            shift->change = 0;
+            shift->cycle++;
+        }
+        shift->due = shift->cycle * engine.plan.shift_cycle + schedule->start[shift->change] - engine.shift_origin;
+        if (capacity == pool->capacity) continue;
+
+        advance_occupancy(&pool->occupancy, now, pool->in_use, 0, pool->capacity);
+        int grew = capacity > pool->capacity;
+        pool->capacity = capacity;
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            if (!((engine.pool_users[p] >> d) & 1)) continue;
+            int unit = site * NUM_DEPARTMENTS + d;
+            DesUnit *u = &engine.units[unit];
+            advance_occupancy(&u->occupancy, now, u->busy, u->queue_length, u->capacity);
+            u->capacity = unit_capacity(unit);
+        }
+        if (grew) {
+            start_waiting(lp, site, engine.pool_users[p], now);
+        }
+    }
+    update_next_shift(lp);
+}
+
+// Patience ran out; a stale timer of a patient already in treatment is ignored
+static void handle_renege(DesProcess *lp, const DesEvent *event) {
+    DesPatient *p = &engine.patients[event->patient];
+    if (p->status != DES_QUEUED || p->hop != event->hop) return;
+
+    DesUnit *u = &engine.units[event->unit];
+    lp->events++;
+    advance_occupancy(&u->occupancy, event->time, u->busy, u->queue_length, u->capacity);
+    u->queue_length--;
+    u->reneged++;
+    leave_hospital(event->patient, event->time, DES_RENEGED);
+}
+
+// Renege of a patient no longer waiting there; processing it changes nothing
+static inline int stale_renege(const DesEvent *event) {
+    const DesPatient *p = &engine.patients[event->patient];
+    return event->kind == DES_RENEGE && (p->status != DES_QUEUED || p->hop != event->hop);
+}
+
+static int has_waiting_patients(const DesProcess *lp) {
+    for (int i = 0; i < engine.num_units; i++) {
+        if (engine.units[i].lp == lp->id && engine.units[i].queue_length > 0) return 1;
+    }
+    return 0;
+}
+
+// A staffing change takes effect before the LP's events at or after it. With
+// no such event it waits, unless patients are waiting for it: the run may be
+// over, and changes past its end must not count in any partitioning.
+static int shift_due(DesProcess *lp, double limit) {
+    if (lp->next_shift >= limit) return 0;
+    while (lp->pending.count > 0 && stale_renege(&lp->pending.events[0])) {
+        heap_pop(&lp->pending);
+    }
+    if (lp->pending.count > 0) return lp->next_shift <= lp->pending.events[0].time;
+    return has_waiting_patients(lp);
+}
+
+// Apply every change up to a time that no event of the run was left to
+// trigger: the cut of a checkpoint, or the end of the run
+static void catch_up_shifts(double until, int inclusive) {
+    for (int i = 0; i < engine.num_lps; i++) {
+        DesProcess *lp = &engine.lps[i];
+        while (lp->next_shift < until || (inclusive && lp->next_shift == until)) {
+            change_shifts(lp, lp->next_shift);
+        }
+    }
+}
+
+static void process_event(DesProcess *lp, const DesEvent *event) {
+    if (event->kind == DES_RENEGE) {
+        handle_renege(lp, event);
+        return;
+    }
+    lp->events++;
+    if (event->kind == DES_ARRIVE) {
+        handle_arrive(lp, event);
+    } else {
+        handle_depart(lp, event);
+    }
+}
+
+// A patient timer is due: renege at exactly its expiry, in event order
+static void schedule_renege(void *context, int32_t patient, double expiry) {
+    DesProcess *lp = (DesProcess*)context;
+    DesPatient *p = &engine.patients[patient];
+    DepartmentType dept = get_route_department((RouteType)p->route_type, p->hop);
+    DesEvent renege = { expiry, patient, (uint16_t)unit_for_patient(patient, dept), p->hop, DES_RENEGE };
+    heap_push(&lp->pending, &renege);
+}
+
+// Time-series sample of an LP's units just before simulated time row * interval
+static void sample_units(DesProcess *lp, int64_t row) {
+    int64_t values[NUM_SERIES_METRICS][NUM_DEPARTMENTS];
+    memset(values, 0, sizeof(values));
+    for (int i = 0; i < lp->num_units; i++) {
+        DesUnit *u = &engine.units[lp->units[i]];
+        values[SERIES_QUEUE][u->type] += u->queue_length;
+        values[SERIES_BUSY][u->type] += u->busy;
+        values[SERIES_COMPLETED][u->type] += u->served;
+    }
+    append_series_row(&engine.series, &lp->series, lp->id, row, values);
+}
+
+// Take every sample due at or before an event about to be processed. Every
+// earlier event of the LP's units is done, so samples do not depend on the
+// partitioning.
+static void sample_until(DesProcess *lp, double time) {
+    while (lp->next_sample * engine.sample_interval <= time) {
+        sample_units(lp, lp->next_sample++);
+    }
+}
+
+// Move received messages into the local heap; returns the safe time bound
+static double drain_inbox(DesProcess *lp) {
+    pthread_mutex_lock(&lp->inbox_mutex);
+    for (int i = 0; i < lp->inbox.count; i++) {
+        heap_push(&lp->pending, &lp->inbox.events[i]);
+    }
+    lp->inbox.count = 0;
+    lp->inbox_dirty = 0;
+
+    double bound = INFINITY;
+    for (int i = 0; i < engine.num_lps; i++) {
+        if (lp->linked[i] && lp->channel_clock[i] < bound) {
+            bound = lp->channel_clock[i];
+        }
+    }
+    pthread_mutex_unlock(&lp->inbox_mutex);
+    return bound;
+}
+
+// Send buffered events and the new promise (a null message if nothing else)
+static int flush_outboxes(DesProcess *lp, double promise) {
+    int promise_advanced = promise > lp->promise;
+    int sent = 0;
+
+    for (int i = 0; i < engine.num_lps; i++) {
+        DesEventList *out = &lp->outbox[i];
+        DesProcess *dest = &engine.lps[i];
+        if (!dest->linked[lp->id] || (out->count == 0 && !promise_advanced)) continue;
+
+        pthread_mutex_lock(&dest->inbox_mutex);
+        event_list_reserve(&dest->inbox, out->count);
+        memcpy(dest->inbox.events + dest->inbox.count, out->events, sizeof(DesEvent) * out->count);
+        dest->inbox.count += out->count;
+        dest->channel_clock[lp->id] = promise;
+        dest->inbox_dirty = 1;
+        pthread_cond_signal(&dest->inbox_cond);
+        pthread_mutex_unlock(&dest->inbox_mutex);
+
+        if (out->count == 0) {
+            lp->null_messages++;
+        }
+        lp->messages_sent += out->count;
+        sent += out->count;
+        out->count = 0;
+    }
+
+    lp->promise = promise;
+    return promise_advanced || sent > 0;
+}
+
+// Conservative (Chandy-Misra-Bryant) LP loop: only events earlier than every
+// input channel's clock are safe; afterwards promise the other LPs nothing
+// earlier than min(next local event, safe bound) + lookahead.
+// With a stop time the LP also leaves once nothing before the cut can still
+// reach it, so all LPs stop at the same consistent cut.
+static void* logical_process(void *arg) {
+    DesProcess *lp = (DesProcess*)arg;
+
+    while (!__atomic_load_n(&engine.done, __ATOMIC_ACQUIRE)) {
+        double bound = drain_inbox(lp);
+        double limit = bound < engine.stop_time ? bound : engine.stop_time;
+
+        int processed = 0;
+        for (;;) {
+            // Patience timers due before the next event become renege events first
+            if (lp->timers.count > 0) {
+                double due = lp->pending.count > 0 && lp->pending.events[0].time < limit ?
+                             lp->pending.events[0].time : limit;
+                expire_timers(&lp->timers, due, schedule_renege, lp);
+            }
+            if (lp->num_shifts > 0 && shift_due(lp, limit)) {
+                if (engine.sample_interval > 0.0) {
+                    sample_until(lp, lp->next_shift);
+                }
+                change_shifts(lp, lp->next_shift);
+                processed++;
+                continue;
+            }
+            if (lp->pending.count == 0 || lp->pending.events[0].time >= limit) break;
+
+            DesEvent event = heap_pop(&lp->pending);
+            if (engine.sample_interval > 0.0) {
+                sample_until(lp, event.time);
+            }
+            process_event(lp, &event);
+            processed++;
+        }
+
+        double next = lp->pending.count > 0 ? lp->pending.events[0].time : INFINITY;
+        double promise = (next < bound ? next : bound) + lp->lookahead;
+        int progressed = flush_outboxes(lp, promise) || processed > 0;
+
+        if (next >= engine.stop_time && bound >= engine.stop_time) {
+            break;
+        }
+        if (!progressed) {
+            pthread_mutex_lock(&lp->inbox_mutex);
+            while (!lp->inbox_dirty && !__atomic_load_n(&engine.done, __ATOMIC_ACQUIRE)) {
+                lp->blocked++;
+                pthread_cond_wait(&lp->inbox_cond, &lp->inbox_mutex);
+            }
+            pthread_mutex_unlock(&lp->inbox_mutex);
+        }
+    }
+
+    return NULL;
+}
+
+// Thread entry for one LP of the parallel engine
+static void* parallel_logical_process(void *arg) {
+    DesProcess *lp = (DesProcess*)arg;
+    pin_to_role(lp->id + 1);
+    return logical_process(lp);
+}
+
+// Assign units to LPs: whole sites when there are enough of them (routes
+// never leave a site), otherwise groups of departments round-robin. The
+// departments of a group share pools, directly or through each other, so
+// they stay on one LP.
+static void partition_units(int num_lps) {
+    int group[NUM_DEPARTMENTS];
+    int num_groups = 0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        group[d] = -1;
+    }
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        if (group[d] >= 0) continue;
+        group[d] = num_groups;
+        for (int changed = 1; changed; ) {
+            changed = 0;
+            for (int e = 0; e < NUM_DEPARTMENTS; e++) {
+                if (group[e] == num_groups && (engine.pool_sharers[e] & ~(1u << e))) {
+                    for (int f = 0; f < NUM_DEPARTMENTS; f++) {
+                        if (group[f] < 0 && ((engine.pool_sharers[e] >> f) & 1)) {
+                            group[f] = num_groups;
+                            changed = 1;
+                        }
+                    }
+                }
+            }
+        }
+        num_groups++;
+    }
+
+    for (int i = 0; i < engine.num_units; i++) {
+        int site = i / NUM_DEPARTMENTS;
+        engine.units[i].lp = engine.num_sites >= num_lps ?
+                             (int)((long)site * num_lps / engine.num_sites) :
+                             (site * num_groups + group[i % NUM_DEPARTMENTS]) % num_lps;
+    }
+}
+
+// Only LP pairs joined by a route hop need a channel; the rest never wait on each other
+static void link_logical_processes() {
+    for (int site = 0; site < engine.num_sites; site++) {
+        for (int route = 0; route < get_num_routes(); route++) {
+            for (int hop = 1; get_route_department((RouteType)route, hop) != (DepartmentType)-1; hop++) {
+                int from = engine.units[site * NUM_DEPARTMENTS + get_route_department((RouteType)route, hop - 1)].lp;
+                int to = engine.units[site * NUM_DEPARTMENTS + get_route_department((RouteType)route, hop)].lp;
+                if (from != to) {
+                    engine.lps[to].linked[from] = 1;
+                }
+            }
+        }
+    }
+}
+
+// Grow the per-patient arrays while a trace streams in
+static int reserve_trace_patients(int *capacity) {
+    if (engine.num_patients < *capacity) return 0;
+    if (*capacity >= INT32_MAX / 2) {
+        fprintf(stderr, "%s: too many arrivals\n", engine.trace_path);
+        return -1;
+    }
+
+    int new_capacity = *capacity ? *capacity * 2 : 4096;
+    DesPatient *patients = (DesPatient*)realloc(engine.patients, sizeof(DesPatient) * new_capacity);
+    if (patients) engine.patients = patients;
+    int64_t *starts = (int64_t*)realloc(engine.observed_start, sizeof(int64_t) * new_capacity);
+    if (starts) engine.observed_start = starts;
+    if (!patients || !starts) return -1;
+
+    memset(engine.patients + *capacity, 0, sizeof(DesPatient) * (new_capacity - *capacity));
+    *capacity = new_capacity;
+    return 0;
+}
+
+// One patient per trace record, arriving relative to the earliest record.
+// The file is streamed once; only routes, arrival times and observed
+// service times are kept.
+static int load_trace_arrivals(const char *path) {
+    TraceReader reader;
+    if (open_trace(path, &reader) != 0) return -1;
+
+    int capacity = 0;
+    int64_t observed_capacity = 0;
+    double first_arrival = INFINITY, last_arrival = -INFINITY;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        engine.observed_min[d] = INFINITY;
+    }
+
+    TraceRecord record;
+    int status;
+    while ((status = next_trace_record(&reader, &record)) == 1) {
+        if (reserve_trace_patients(&capacity) != 0) {
+            status = -1;
+            break;
+        }
+
+        DepartmentType route_path[MAX_ROUTE_HOPS];
+        int observed = 0;
+        for (int hop = 0; hop < record.num_hops; hop++) {
+            route_path[hop] = (DepartmentType)record.path[hop];
+            observed |= record.service_time[hop] >= 0.0f;
+        }
+        int route = register_route(route_path, record.num_hops);
+        if (route < 0) {
+            fprintf(stderr, "%s: more than %d distinct routes\n", path, MAX_ROUTES);
+            status = -1;
+            break;
+        }
+
+        DesPatient *p = &engine.patients[engine.num_patients];
+        p->route_type = (uint8_t)route;
+        p->triage = record.triage;
+        p->arrival_time = record.arrival_time;
+        if (record.arrival_time < first_arrival) first_arrival = record.arrival_time;
+        if (record.arrival_time > last_arrival) last_arrival = record.arrival_time;
+
+        engine.observed_start[engine.num_patients] = -1;
+        if (observed) {
+            if (engine.num_observed + MAX_ROUTE_HOPS > observed_capacity) {
+                observed_capacity = observed_capacity ? observed_capacity * 2 : 16384;
+                float *service = (float*)realloc(engine.observed_service, sizeof(float) * observed_capacity);
+                if (!service) {
+                    status = -1;
+                    break;
+                }
+                engine.observed_service = service;
+            }
+            engine.observed_start[engine.num_patients] = engine.num_observed;
+            for (int hop = 0; hop < record.num_hops; hop++) {
+                float seconds = record.service_time[hop];
+                engine.observed_service[engine.num_observed++] = seconds;
+                if (seconds >= 0.0f && seconds < engine.observed_min[record.path[hop]]) {
+                    engine.observed_min[record.path[hop]] = seconds;
+                }
+            }
+        }
+        engine.num_patients++;
+    }
+    close_trace(&reader);
+
+    if (status == 0 && engine.num_patients == 0) {
+        fprintf(stderr, "%s: no arrivals\n", path);
+        status = -1;
+    }
+    if (status != 0) return -1;
+
+    for (int i = 0; i < engine.num_patients; i++) {
+        engine.patients[i].arrival_time -= first_arrival;
+    }
+    engine.trace_span = last_arrival - first_arrival;
+    engine.shift_origin = fmod(first_arrival, engine.plan.shift_cycle);
+    return 0;
+}
+
+// Fresh run: every patient's first arrival goes into the owning LP's heap.
+// Without a trace, patients follow the default mix at the dispatch interval.
+static void seed_arrivals() {
+    double arrival_interval = DISPATCH_INTERVAL / 1e6;
+    for (int i = 0; i < engine.num_patients; i++) {
+        DesPatient *p = &engine.patients[i];
+        if (!engine.trace_path) {
+            p->route_type = (uint8_t)get_default_route(i);
+            p->arrival_time = i * arrival_interval;
+        }
+        p->next_waiting = NO_PATIENT;
+
+        for (int hop = 0; get_route_department((RouteType)p->route_type, hop) != (DepartmentType)-1; hop++) {
+            engine.remaining_departures++;
+        }
+
+        DepartmentType first_dept = get_route_department((RouteType)p->route_type, 0);
+        DesEvent arrive = { p->arrival_time, i, (uint16_t)unit_for_patient(i, first_dept), 0, DES_ARRIVE };
+        heap_push(&engine.lps[engine.units[arrive.unit].lp].pending, &arrive);
+    }
+}
+
+// Restored run: pending events and in-flight messages go to whichever LP
+// owns their unit under the current partitioning
+static void restore_events(const CheckpointImage *image) {
+    memcpy(engine.patients, image->patients, sizeof(DesPatient) * engine.num_patients);
+    engine.remaining_departures = image->header->remaining_departures;
+    engine.restored_events = image->header->events_processed;
+
+    for (int64_t i = 0; i < image->header->num_events; i++) {
+        const DesEvent *event = &image->events[i];
+        heap_push(&engine.lps[engine.units[event->unit].lp].pending, event);
+    }
+}
+
+// One patience timer per patient, armed in the wheel of the LP owning the
+// unit it waits at. A restored run re-arms the patients waiting at the cut.
+static int init_patience_timers() {
+    engine.timer_nodes = (TimerNode*)malloc(sizeof(TimerNode) * engine.num_patients);
+    if (!engine.timer_nodes) return -1;
+    for (int i = 0; i < engine.num_patients; i++) {
+        engine.timer_nodes[i].prev = TIMER_NONE;
+    }
+    for (int i = 0; i < engine.num_lps; i++) {
+        init_timer_wheel(&engine.lps[i].timers, engine.timer_nodes, PATIENCE_TICK, engine.start_time);
+    }
+
+    for (int i = 0; i < engine.num_patients; i++) {
+        DesPatient *p = &engine.patients[i];
+        if (p->status != DES_QUEUED) continue;
+        DepartmentType dept = get_route_department((RouteType)p->route_type, p->hop);
+        if (engine.patience[dept] <= 0.0) continue;
+
+        double expiry = p->enqueue_time + patience_time(i, p->hop, dept);
+        int unit = unit_for_patient(i, dept);
+        arm_timer(&engine.lps[engine.units[unit].lp].timers, i,
+                  expiry > engine.start_time ? expiry : engine.start_time);
+    }
+    return 0;
+}
+
+// A checkpoint can only continue under the pools it was written with
+static int same_pools(const CheckpointImage *image) {
+    const CheckpointHeader *header = image->header;
+    return header->num_pools == engine.num_pools && header->resource_digest == resource_plan_digest(&engine.plan);
+}
+
+// Give every scheduled pool in use to the LP owning its departments, pointed
+// at its first change from the start on
+static int init_shifts() {
+    for (int site = 0; site < engine.num_sites; site++) {
+        for (int p = 0; p < engine.num_pools; p++) {
+            if (engine.plan.shifts[p].num_changes == 0 || engine.pool_users[p] == 0) continue;
+            int dept = __builtin_ctz(engine.pool_users[p]);
+            DesProcess *lp = &engine.lps[engine.units[site * NUM_DEPARTMENTS + dept].lp];
+            DesShift *shifts = (DesShift*)realloc(lp->shifts, sizeof(DesShift) * (lp->num_shifts + 1));
+            if (!shifts) return -1;
+            lp->shifts = shifts;
+            DesShift *shift = &lp->shifts[lp->num_shifts++];
+            shift->pool = site * engine.num_pools + p;
+            find_shift_change(shift, engine.start_time);
+        }
+    }
+    for (int i = 0; i < engine.num_lps; i++) {
+        update_next_shift(&engine.lps[i]);
+    }
+    return 0;
+}
+
+// Build units and LPs from the configuration, or from a checkpoint if given
+static int init_des_engine(const SimConfig *config, const CheckpointImage *image) {
+    engine.plan = config->resources;
+    if (image) {
+        engine.seed = config->seed ? config->seed : image->header->seed;
+        engine.num_units = image->header->num_units;
+        engine.num_patients = image->header->num_patients;
+        engine.start_time = image->header->clock;
+        engine.shift_origin = image->header->shift_origin;
+    } else {
+        engine.seed = config->seed ? config->seed : default_random_seed();
+        engine.num_units = config->num_departments;
+        if (config->trace_path) {
+            engine.trace_path = config->trace_path;
+            if (load_trace_arrivals(config->trace_path) != 0) return -1;
+        } else {
+            engine.num_patients = config->num_patients;
+        }
+    }
+    engine.num_sites = engine.num_units / NUM_DEPARTMENTS;
+    engine.num_pools = config->resources.num_pools;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        engine.pool_needs[d] = config->resources.needs[d];
+        engine.pool_sharers[d] = pool_sharers(&config->resources, (DepartmentType)d);
+        for (int p = 0; p < engine.num_pools; p++) {
+            if ((engine.pool_needs[d] >> p) & 1) engine.pool_users[p] |= 1u << d;
+        }
+    }
+    if (image && !same_pools(image)) {
+        fprintf(stderr, "Checkpoint was written with different resource pools\n");
+        return -1;
+    }
+    int impatient = 0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        engine.waiting_room[d] = config->waiting_room[d];
+        engine.patience[d] = config->patience[d];
+        impatient |= config->patience[d] > 0.0;
+    }
+    engine.stop_time = config->checkpoint_path ? config->checkpoint_time : INFINITY;
+    if (engine.stop_time <= engine.start_time) {
+        fprintf(stderr, "Checkpoint time must be later than %.3f\n", engine.start_time);
+        return -1;
+    }
+
+    int num_lps = 1;
+    if (config->backend == BACKEND_PDES) {
+        num_lps = config->num_workers > 0 ? config->num_workers : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (num_lps > engine.num_units) num_lps = engine.num_units;
+        if (num_lps < 1) num_lps = 1;
+    }
+    engine.num_lps = num_lps;
+
+    engine.units = (DesUnit*)calloc(engine.num_units, sizeof(DesUnit));
+    if (!engine.trace_path) {
+        engine.patients = (DesPatient*)calloc(engine.num_patients, sizeof(DesPatient));
+    }
+    engine.lps = (DesProcess*)calloc(num_lps, sizeof(DesProcess));
+    engine.pools = (DesPool*)calloc((size_t)engine.num_sites * engine.num_pools, sizeof(DesPool));
+    if (!engine.units || !engine.patients || !engine.lps || !engine.pools) return -1;
+
+    if (image) {
+        memcpy(engine.units, image->units, sizeof(DesUnit) * engine.num_units);
+        memcpy(engine.pools, image->pools, sizeof(DesPool) * engine.num_sites * engine.num_pools);
+    } else {
+        for (int i = 0; i < engine.num_sites * engine.num_pools; i++) {
+            engine.pools[i].capacity = scheduled_capacity(&engine.plan, i % engine.num_pools, engine.shift_origin);
+            init_occupancy(&engine.pools[i].occupancy, 0.0);
+        }
+        for (int i = 0; i < engine.num_units; i++) {
+            DesUnit *u = &engine.units[i];
+            u->type = (DepartmentType)(i % NUM_DEPARTMENTS);
+            u->capacity = unit_capacity(i);
+            u->wait_head = NO_PATIENT;
+            u->wait_tail = NO_PATIENT;
+            init_occupancy(&u->occupancy, 0.0);
+        }
+    }
+    partition_units(num_lps);
+
+    for (int i = 0; i < num_lps; i++) {
+        DesProcess *lp = &engine.lps[i];
+        lp->id = i;
+        lp->lookahead = INFINITY;
+        lp->promise = engine.start_time;
+        lp->outbox = (DesEventList*)calloc(num_lps, sizeof(DesEventList));
+        lp->channel_clock = (double*)calloc(num_lps, sizeof(double));
+        lp->linked = (char*)calloc(num_lps, sizeof(char));
+        if (!lp->outbox || !lp->channel_clock || !lp->linked) return -1;
+        for (int j = 0; j < num_lps; j++) {
+            lp->channel_clock[j] = engine.start_time;  // Nothing happens before the start
+        }
+        pthread_mutex_init(&lp->inbox_mutex, NULL);
+        pthread_cond_init(&lp->inbox_cond, NULL);
+    }
+    link_logical_processes();
+    if (init_shifts() != 0) return -1;
+    for (int i = 0; i < engine.num_units; i++) {
+        DesProcess *lp = &engine.lps[engine.units[i].lp];
+        double service_min = department_configs[engine.units[i].type].service_time_min;
+        if (engine.trace_path && engine.observed_min[engine.units[i].type] < service_min) {
+            service_min = engine.observed_min[engine.units[i].type];
+        }
+        if (service_min < lp->lookahead) lp->lookahead = service_min;
+    }
+    for (int i = 0; num_lps > 1 && i < num_lps; i++) {
+        if (engine.lps[i].lookahead <= 0.0) {
+            fprintf(stderr, engine.trace_path ?
+                    "Parallel DES needs a positive minimum service time; run traces with zero-length treatments on --backend=des\n" :
+                    "Parallel DES needs a positive minimum service time\n");
+            return -1;
+        }
+    }
+
+    if (image) {
+        restore_events(image);
+    } else {
+        seed_arrivals();
+    }
+    return impatient ? init_patience_timers() : 0;
+}
+
+// Open the time-series file and give every LP its unit list and chunk buffer.
+// The first sample is the first one at or after the start.
+static int init_series(const char *path, double interval) {
+    if (open_series(path, interval, &engine.series) != 0) return -1;
+    engine.series_path = path;
+    engine.sample_interval = interval;
+
+    for (int i = 0; i < engine.num_lps; i++) {
+        DesProcess *lp = &engine.lps[i];
+        lp->units = (int*)malloc(sizeof(int) * engine.num_units);
+        if (!lp->units || init_series_buffer(&lp->series) != 0) return -1;
+        lp->next_sample = (int64_t)ceil(engine.start_time / interval);
+    }
+    for (int i = 0; i < engine.num_units; i++) {
+        DesProcess *lp = &engine.lps[engine.units[i].lp];
+        lp->units[lp->num_units++] = i;
+    }
+    return 0;
+}
+
+// Arena for every patient's hops. A restored run continues the hops
+// recorded before the cut, so its checkpoint must have them.
+static int init_journey_hops(const CheckpointImage *image) {
+    if (image && image->header->num_hops == 0) {
+        fprintf(stderr, "--attribution needs a checkpoint written with --attribution\n");
+        return -1;
+    }
+    if (init_hop_arena(&engine.hops, engine.num_patients) != 0) return -1;
+    for (int i = 0; i < engine.num_patients; i++) {
+        engine.hops.route_type[i] = engine.patients[i].route_type;
+    }
+    if (allocate_hops(&engine.hops) != 0) return -1;
+
+    if (image) {
+        if (image->header->num_hops != engine.hops.num_hops) {
+            fprintf(stderr, "Checkpoint hops do not match its patients' routes\n");
+            return -1;
+        }
+        memcpy(engine.hops.hops, image->hops, sizeof(JourneyHop) * engine.hops.num_hops);
+    }
+    return 0;
+}
+
+// Once every LP has stopped its units no longer change, so the remaining
+// samples up to the end (the last discharge, or before the cut) are the
+// final state
+static int finish_series(int64_t last_row) {
+    for (int i = 0; i < engine.num_lps; i++) {
+        DesProcess *lp = &engine.lps[i];
+        while (lp->next_sample <= last_row) {
+            sample_units(lp, lp->next_sample++);
+        }
+        flush_series_buffer(&engine.series, &lp->series, lp->id);
+    }
+    engine.sample_interval = 0.0;
+    return close_series(&engine.series);
+}
+
+// Write the state at the stop time: patients (with their waiting-line links),
+// units, and every pending event and in-flight message of every LP
+static int save_checkpoint(const char *path) {
+    catch_up_shifts(engine.stop_time, 0);
+    int64_t num_events = 0;
+    for (int i = 0; i < engine.num_lps; i++) {
+        DesProcess *lp = &engine.lps[i];
+        num_events += lp->pending.count + lp->inbox.count;
+        for (int j = 0; j < engine.num_lps; j++) {
+            num_events += lp->outbox[j].count;
+        }
+    }
+
+    CheckpointImage image;
+    if (create_checkpoint(path, &image, engine.num_patients, engine.num_units, num_events,
+                          engine.hops.hops ? engine.hops.num_hops : 0, engine.num_pools) != 0) {
+        return -1;
+    }
+
+    CheckpointHeader *header = image.header;
+    header->seed = engine.seed;
+    header->clock = engine.stop_time;
+    header->remaining_departures = engine.remaining_departures;
+    header->events_processed = engine.restored_events;
+    memcpy(image.patients, engine.patients, sizeof(DesPatient) * engine.num_patients);
+    memcpy(image.units, engine.units, sizeof(DesUnit) * engine.num_units);
+    memcpy(image.pools, engine.pools, sizeof(DesPool) * engine.num_sites * engine.num_pools);
+    header->resource_digest = resource_plan_digest(&engine.plan);
+    header->shift_origin = engine.shift_origin;
+    if (engine.hops.hops) {
+        memcpy(image.hops, engine.hops.hops, sizeof(JourneyHop) * engine.hops.num_hops);
+    }
+
+    DesEvent *out = image.events;
+    for (int i = 0; i < engine.num_lps; i++) {
+        DesProcess *lp = &engine.lps[i];
+        header->events_processed += lp->events;
+        memcpy(out, lp->pending.events, sizeof(DesEvent) * lp->pending.count);
+        out += lp->pending.count;
+        memcpy(out, lp->inbox.events, sizeof(DesEvent) * lp->inbox.count);
+        out += lp->inbox.count;
+        for (int j = 0; j < engine.num_lps; j++) {
+            memcpy(out, lp->outbox[j].events, sizeof(DesEvent) * lp->outbox[j].count);
+            out += lp->outbox[j].count;
+        }
+    }
+
+    int result = commit_checkpoint(&image);
+    printf("Checkpoint written          : %s (t=%.3f, %lld pending events, %.1f MB)\n\n",
+           path, engine.stop_time, (long long)num_events, image.mapping_size / (1024.0 * 1024.0));
+    log_message(LOG_INFO, "Checkpoint %s written at t=%.3f", path, engine.stop_time);
+    close_checkpoint(&image);
+    return result;
+}
+
+static void destroy_des_engine() {
+    for (int i = 0; engine.lps && i < engine.num_lps; i++) {
+        DesProcess *lp = &engine.lps[i];
+        for (int j = 0; lp->outbox && j < engine.num_lps; j++) {
+            free(lp->outbox[j].events);
+        }
+        free(lp->outbox);
+        free(lp->channel_clock);
+        free(lp->linked);
+        free(lp->pending.events);
+        free(lp->inbox.events);
+        free(lp->units);
+        free(lp->shifts);
+        free_series_buffer(&lp->series);
+        pthread_mutex_destroy(&lp->inbox_mutex);
+        pthread_cond_destroy(&lp->inbox_cond);
+    }
+    free(engine.lps);
+    free(engine.units);
+    free(engine.pools);
+    free(engine.patients);
+    free(engine.observed_service);
+    free(engine.observed_start);
+    free_hop_arena(&engine.hops);
+    free(engine.timer_nodes);
+    if (engine.sample_interval > 0.0) {
+        close_series(&engine.series);
+    }
+    memset(&engine, 0, sizeof(engine));
+}
+
+// FNV-1a over every patient's results; equal digests mean identical runs
+static uint64_t result_digest() {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < engine.num_patients; i++) {
+        DesPatient *p = &engine.patients[i];
+        double fields[3] = { p->total_waiting_time, p->total_treatment_time, p->discharge_time };
+        const unsigned char *bytes = (const unsigned char*)fields;
+        for (size_t b = 0; b < sizeof(fields); b++) {
+            hash = (hash ^ bytes[b]) * 0x100000001B3ULL;
+        }
+    }
+    return hash;
+}
+
+// Simulated time the run ended
+static double last_discharge_time() {
+    double last_discharge = 0.0;
+    for (int i = 0; i < engine.num_patients; i++) {
+        if (engine.patients[i].discharge_time > last_discharge) {
+            last_discharge = engine.patients[i].discharge_time;
+        }
+    }
+    return last_discharge;
+}
+
+// Time-weighted utilization of every unit from time 0 to the last discharge
+static void summarize_units(GlobalMetrics *metrics, double end) {
+    catch_up_shifts(end, 1);
+    for (int i = 0; i < engine.num_units; i++) {
+        DesUnit *u = &engine.units[i];
+        add_unit_utilization(&metrics->departments[u->type], &u->occupancy, u->capacity,
+                             u->max_queue_length, end, engine.num_sites);
+        metrics->departments[u->type].balked += u->balked;
+        metrics->departments[u->type].reneged += u->reneged;
+    }
+
+    init_pool_metrics(metrics, &engine.plan);
+    for (int p = 0; p < metrics->num_pools; p++) {
+        PoolUtilization *summary = &metrics->pools[p];
+        for (int site = 0; site < engine.num_sites; site++) {
+            DesPool *pool = &engine.pools[site * engine.num_pools + p];
+            add_pool_utilization(summary, &pool->occupancy, pool->capacity, end, engine.num_sites);
+            summary->acquisitions += pool->acquisitions;
+            summary->queued += pool->queued;
+        }
+    }
+}
+
+// Aggregate patient results into the standard global metrics. Averages and
+// throughput cover the patients who completed their route.
+static void summarize_patients(GlobalMetrics *metrics, time_t epoch) {
+    memset(metrics, 0, sizeof(GlobalMetrics));
+    metrics->total_patients = engine.num_patients;
+
+    int discharged = 0;
+    for (int i = 0; i < engine.num_patients; i++) {
+        DesPatient *p = &engine.patients[i];
+        if (p->status != DES_ACTIVE) {
+            metrics->balked += p->status == DES_BALKED;
+            metrics->reneged += p->status == DES_RENEGED;
+            metrics->left_without_being_seen += p->hop == 0;
+            continue;
+        }
+        discharged++;
+        metrics->avg_waiting_time += p->total_waiting_time;
+        metrics->avg_treatment_time += p->total_treatment_time;
+        metrics->avg_time_in_system += p->discharge_time - p->arrival_time;
+    }
+
+    double last_discharge = last_discharge_time();
+
+    if (discharged > 0) {
+        metrics->avg_waiting_time /= discharged;
+        metrics->avg_treatment_time /= discharged;
+        metrics->avg_time_in_system /= discharged;
+    }
+    metrics->simulation_start = epoch;
+    metrics->simulation_end = epoch + (time_t)last_discharge;
+    metrics->throughput = last_discharge > 0 ? discharged / (last_discharge / 60.0) : 0.0;
+    summarize_units(metrics, last_discharge);
+}
+
+// Copy the run's global metrics and, if wanted, every patient's times into its results
+static void collect_des_results(SimResults *results, time_t epoch, const GlobalMetrics *metrics, int with_patients) {
+    if (!results) return;
+    results->metrics = *metrics;
+    if (!with_patients || init_sim_results(results, engine.num_patients) != 0) return;
+
+    for (int i = 0; i < engine.num_patients; i++) {
+        DesPatient *p = &engine.patients[i];
+        PatientMetrics *result = &results->patients[i];
+        result->patient_id = i + 1;
+        result->route_type = (RouteType)p->route_type;
+        result->arrival_time = epoch + (time_t)p->arrival_time;
+        result->discharge_time = epoch + (time_t)p->discharge_time;
+        result->total_waiting_time = p->total_waiting_time;
+        result->total_treatment_time = p->total_treatment_time;
+        result->time_in_system = p->discharge_time - p->arrival_time;
+    }
+}
+
+// Waiting and time in system per triage level of a trace
+static void print_triage_summary() {
+    long count[6] = {0};
+    double waiting[6] = {0}, in_system[6] = {0};
+    for (int i = 0; i < engine.num_patients; i++) {
+        DesPatient *p = &engine.patients[i];
+        count[p->triage]++;
+        waiting[p->triage] += p->total_waiting_time;
+        in_system[p->triage] += p->discharge_time - p->arrival_time;
+    }
+    if (count[0] == engine.num_patients) return;
+
+    printf("%-12s %12s %16s %16s\n", "Triage", "Patients", "Avg Wait (s)", "Avg Total (s)");
+    for (int level = 1; level <= 5; level++) {
+        if (count[level] == 0) continue;
+        printf("%-12d %12ld %16.2f %16.2f\n", level, count[level],
+               waiting[level] / count[level], in_system[level] / count[level]);
+    }
+    if (count[0] > 0) {
+        printf("%-12s %12ld %16.2f %16.2f\n", "unknown", count[0],
+               waiting[0] / count[0], in_system[0] / count[0]);
+    }
+    printf("\n");
+}
+
+static void print_des_report(double wall_seconds) {
+    printf("╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                 DISCRETE-EVENT SIMULATION REPORT               ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    long events = engine.restored_events;
+    for (int i = 0; i < engine.num_lps; i++) {
+        events += engine.lps[i].events;
+    }
+
+    printf("Engine                      : %s\n", engine.num_lps > 1 ? "parallel (null-message)" : "sequential");
+    printf("Service Units (departments) : %d across %d site(s)\n", engine.num_units, engine.num_sites);
+    printf("Logical Processes           : %d\n", engine.num_lps);
+    printf("Seed                        : %llu\n", (unsigned long long)engine.seed);
+    printf("Events Processed            : %ld\n", events);
+    printf("Wall Clock Duration         : %.3f seconds (%.2f M events/s)\n",
+           wall_seconds, wall_seconds > 0 ? events / wall_seconds / 1e6 : 0.0);
+    printf("Result Digest               : %016llx\n", (unsigned long long)result_digest());
+    if (engine.series_path) {
+        printf("Time Series                 : %s (%lld samples every %.0f s)\n", engine.series_path,
+               (long long)engine.series.header.num_rows, engine.series.header.interval);
+    }
+    if (engine.trace_path) {
+        long observed = 0;
+        for (int64_t i = 0; i < engine.num_observed; i++) {
+            if (engine.observed_service[i] >= 0.0f) observed++;
+        }
+        printf("Arrival Trace               : %s (%d arrivals over %.1f h, %d routes, %ld observed treatments)\n",
+               engine.trace_path, engine.num_patients, engine.trace_span / 3600.0,
+               get_num_routes(), observed);
+    }
+    if (engine.num_lps > 1) {
+        print_cpu_placement(NULL, engine.num_lps, -1);
+    }
+    printf("\n");
+
+    if (engine.num_lps > 1) {
+        printf("%-6s %8s %12s %12s %12s %10s %10s\n",
+               "LP", "Units", "Events", "Messages", "Null Msgs", "Blocked", "Lookahead");
+        for (int i = 0; i < engine.num_lps; i++) {
+            DesProcess *lp = &engine.lps[i];
+            int owned = 0;
+            for (int u = 0; u < engine.num_units; u++) {
+                if (engine.units[u].lp == i) owned++;
+            }
+            printf("%-6d %8d %12ld %12ld %12ld %10ld %9.2fs\n", i, owned, lp->events,
+                   lp->messages_sent, lp->null_messages, lp->blocked, lp->lookahead);
+        }
+        printf("\n");
+    }
+
+    printf("%-12s %12s %16s\n", "Department", "Served", "Max Queue (unit)");
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        long served = 0;
+        int worst_unit = d;
+        for (int i = d; i < engine.num_units; i += NUM_DEPARTMENTS) {
+            served += engine.units[i].served;
+            if (engine.units[i].max_queue_length > engine.units[worst_unit].max_queue_length) {
+                worst_unit = i;
+            }
+        }
+        printf("%-12s %12ld %9d (%d)\n", get_department_name((DepartmentType)d), served,
+               engine.units[worst_unit].max_queue_length, worst_unit);
+    }
+    printf("\n");
+
+    if (engine.trace_path) {
+        print_triage_summary();
+    }
+}
+
+// Bottleneck attribution over the recorded hops
+static void print_attribution() {
+    if (!engine.hops.hops) return;
+
+    BottleneckAnalysis *analysis = (BottleneckAnalysis*)malloc(sizeof(BottleneckAnalysis));
+    if (!analysis || analyze_hops(&engine.hops, analysis) != 0) {
+        fprintf(stderr, "Not enough memory for the bottleneck attribution\n");
+    } else {
+        print_bottleneck_analysis(analysis);
+    }
+    free(analysis);
+}
+
+// Run the model as fast as possible on the sequential or parallel DES engine.
+// Both produce bit-identical patient results for the same seed. Results are
+// copied out when requested; the report is printed unless quiet.
+int run_des_simulation(const SimConfig *config, SimResults *results) {
+    memset(&engine, 0, sizeof(engine));
+
+    CheckpointImage image;
+    if (config->restore_path && open_checkpoint(config->restore_path, &image) != 0) {
+        return -1;
+    }
+
+    int result = init_des_engine(config, config->restore_path ? &image : NULL);
+    if (result == 0 && config->attribution) {
+        result = init_journey_hops(config->restore_path ? &image : NULL);
+    }
+    if (config->restore_path) {
+        close_checkpoint(&image);
+    }
+    if (result != 0) {
+        fprintf(stderr, "Failed to set up DES state\n");
+        destroy_des_engine();
+        return -1;
+    }
+
+    if (config->series_path && init_series(config->series_path, config->series_interval) != 0) {
+        fprintf(stderr, "Failed to set up the time series\n");
+        destroy_des_engine();
+        return -1;
+    }
+
+    if (!config->quiet) {
+        if (config->restore_path) {
+            printf("Restored checkpoint %s at t=%.3f\n", config->restore_path, engine.start_time);
+        }
+        printf("Simulating %d patients through %d departments on %d logical process(es)...\n",
+               engine.num_patients, engine.num_units, engine.num_lps);
+    }
+    log_message(LOG_INFO, "DES started: %d units, %d LPs, %d patients, seed %llu",
+                engine.num_units, engine.num_lps, engine.num_patients,
+                (unsigned long long)engine.seed);
+
+    time_t epoch = time(NULL);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (engine.num_lps == 1) {
+        logical_process(&engine.lps[0]);
+    } else {
+        for (int i = 0; i < engine.num_lps; i++) {
+            if (pthread_create(&engine.lps[i].thread, NULL, parallel_logical_process, &engine.lps[i]) != 0) {
+                // The started LPs would wait forever for this one's null messages
+                log_message(LOG_ERROR, "Failed to create logical process %d", i);
+                stop_logical_processes();
+                for (int j = 0; j < i; j++) {
+                    pthread_join(engine.lps[j].thread, NULL);
+                }
+                destroy_des_engine();
+                return -1;
+            }
+        }
+        for (int i = 0; i < engine.num_lps; i++) {
+            pthread_join(engine.lps[i].thread, NULL);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    log_message(LOG_INFO, "DES finished in %.3f seconds", wall_seconds);
+
+    // Stopped at the cut with patients still in the hospital
+    if (engine.remaining_departures > 0) {
+        result = save_checkpoint(config->checkpoint_path);
+        if (engine.sample_interval > 0.0 &&
+            finish_series((int64_t)ceil(engine.stop_time / engine.sample_interval) - 1) != 0) {
+            result = -1;
+        }
+        if (!config->quiet) print_des_report(wall_seconds);
+        destroy_des_engine();
+        return result;
+    }
+
+    if (engine.sample_interval > 0.0 &&
+        finish_series((int64_t)floor(last_discharge_time() / engine.sample_interval)) != 0) {
+        destroy_des_engine();
+        return -1;
+    }
+
+    GlobalMetrics metrics;
+    summarize_patients(&metrics, epoch);
+    collect_des_results(results, epoch, &metrics, config->keep_patients);
+    if (!config->quiet) {
+        print_global_metrics(&metrics);
+        print_des_report(wall_seconds);
+        print_attribution();
+    }
+
+    destroy_des_engine();
+    return 0;
+}
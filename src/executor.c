@@ -0,0 +1,541 @@
+#include "executor.h"
+#include "work_deque.h"
+#include "department.h"
+#include "patient.h"
+#include "metrics.h"
+#include "logger.h"
+#include "placement.h"
+#include "random.h"
+#include "patient_export.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+// Task encoding: [type:16][unit:16][patient:32]
+#define TASK_ARRIVE 0    // Patient reaches a service unit
+#define TASK_COMPLETE 1  // Patient's treatment at a service unit ends
+#define DEQUE_CAPACITY_LOG2 16
+#define NO_PATIENT -1
+
+// One department instance (a site has one unit of every department type)
+typedef struct {
+    DepartmentType type;
+    int site;
+    int capacity;
+    int busy;
+    int wait_head;       // FIFO of waiting patients, linked through next_waiting[]
+    int wait_tail;
+    int queue_length;
+    int max_queue_length;
+    long served;
+    DepartmentOccupancy occupancy;
+    pthread_spinlock_t lock;
+} ServiceUnit;
+
+// Pending treatment completion or arrival
+typedef struct {
+    double deadline;     // Simulated seconds since start
+    uint64_t task;
+} TimerEntry;
+
+// Worker thread with its own deque
+typedef struct {
+    int id;
+    pthread_t thread;
+    WorkDeque deque;
+    unsigned int rng_state;
+    long executed;
+    long stolen;
+    long timers_fired;
+} ExecutorWorker;
+
+// Executor state shared by all workers
+typedef struct {
+    ServiceUnit *units;
+    int num_units;
+    int num_sites;
+
+    Patient **patients;
+    int num_patients;
+    double *enqueue_time;    // Simulated time each waiting patient joined its queue
+    int *next_waiting;
+    int completed;
+    int stopping;            // Set if the run is abandoned
+
+    ExecutorWorker *workers;
+    int num_workers;
+
+    TimerEntry *timers;      // Binary min-heap on deadline
+    int timer_count;
+    int timer_capacity;
+    int idle_workers;
+    pthread_mutex_t timer_mutex;
+    pthread_cond_t timer_cond;
+
+    double time_scale;       // Wall seconds per simulated second
+    struct timespec start;
+    time_t epoch;
+    uint64_t seed;           // Treatment durations
+} Executor;
+
+static Executor executor;
+
+static inline uint64_t pack_task(int type, int unit, int patient) {
+    return ((uint64_t)type << 48) | ((uint64_t)unit << 32) | (uint32_t)patient;
+}
+
+static inline int task_type(uint64_t task) { return (int)(task >> 48); }
+static inline int task_unit(uint64_t task) { return (int)((task >> 32) & 0xFFFF); }
+static inline int task_patient(uint64_t task) { return (int)(task & 0xFFFFFFFF); }
+
+// Simulated seconds elapsed since the executor started
+static double sim_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double wall = (now.tv_sec - executor.start.tv_sec) +
+                  (now.tv_nsec - executor.start.tv_nsec) / 1e9;
+    return wall / executor.time_scale;
+}
+
+// Unit serving a department type at the patient's site
+static int unit_for_patient(int patient, DepartmentType dept) {
+    int site = patient % executor.num_sites;
+    return site * NUM_DEPARTMENTS + dept;
+}
+
+// Add timer (caller holds timer_mutex)
+static int timer_push_locked(double deadline, uint64_t task) {
+    if (executor.timer_count == executor.timer_capacity) {
+        int new_capacity = executor.timer_capacity ? executor.timer_capacity * 2 : 1024;
+        TimerEntry *timers = (TimerEntry*)realloc(executor.timers, sizeof(TimerEntry) * new_capacity);
+        if (!timers) return -1;
+        executor.timers = timers;
+        executor.timer_capacity = new_capacity;
+    }
+
+    int i = executor.timer_count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (executor.timers[parent].deadline <= deadline) break;
+        executor.timers[i] = executor.timers[parent];
+        i = parent;
+    }
+    executor.timers[i].deadline = deadline;
+    executor.timers[i].task = task;
+    return 0;
+}
+
+// Remove earliest timer (caller holds timer_mutex)
+static TimerEntry timer_pop_locked() {
+    TimerEntry top = executor.timers[0];
+    TimerEntry last = executor.timers[--executor.timer_count];
+
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= executor.timer_count) break;
+        if (child + 1 < executor.timer_count &&
+            executor.timers[child + 1].deadline < executor.timers[child].deadline) {
+            child++;
+        }
+        if (last.deadline <= executor.timers[child].deadline) break;
+        executor.timers[i] = executor.timers[child];
+        i = child;
+    }
+    if (executor.timer_count > 0) {
+        executor.timers[i] = last;
+    }
+    return top;
+}
+
+// Schedule a task at a simulated time and wake a sleeping worker
+static void schedule_timer(double deadline, uint64_t task) {
+    pthread_mutex_lock(&executor.timer_mutex);
+    if (timer_push_locked(deadline, task) != 0) {
+        log_message(LOG_ERROR, "Executor: failed to grow timer heap");
+    }
+    pthread_cond_signal(&executor.timer_cond);
+    pthread_mutex_unlock(&executor.timer_mutex);
+}
+
+static int all_patients_done() {
+    return __atomic_load_n(&executor.completed, __ATOMIC_ACQUIRE) >= executor.num_patients ||
+           __atomic_load_n(&executor.stopping, __ATOMIC_ACQUIRE);
+}
+
+static void execute_task(ExecutorWorker *worker, uint64_t task);
+
+// Queue task on this worker's deque, running it inline if the deque is full
+static void submit_task(ExecutorWorker *worker, uint64_t task) {
+    if (push_work(&worker->deque, task) != 0) {
+        execute_task(worker, task);
+        return;
+    }
+
+    // Let an idle worker come and steal it
+    if (__atomic_load_n(&executor.idle_workers, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&executor.timer_mutex);
+        pthread_cond_signal(&executor.timer_cond);
+        pthread_mutex_unlock(&executor.timer_mutex);
+    }
+}
+
+// Occupy a server: draw the treatment time and schedule its completion
+static void start_treatment(int patient, int unit, double now) {
+    Patient *p = executor.patients[patient];
+    int duration = random_int_range(executor.seed, RANDOM_SERVICE, patient, p->current_dept_index,
+                                    TREATMENT_TIME_MIN, TREATMENT_TIME_MAX);
+    p->total_treatment_time += duration;
+    schedule_timer(now + duration, pack_task(TASK_COMPLETE, unit, patient));
+}
+
+// Patient reaches a unit: treat now or join its FIFO queue
+static void handle_arrival(int patient, int unit) {
+    ServiceUnit *su = &executor.units[unit];
+    double now = sim_now();
+
+    pthread_spin_lock(&su->lock);
+    advance_occupancy(&su->occupancy, now, su->busy, su->queue_length, su->capacity);
+    if (su->busy < su->capacity) {
+        su->busy++;
+        pthread_spin_unlock(&su->lock);
+        start_treatment(patient, unit, now);
+        return;
+    }
+
+    executor.enqueue_time[patient] = now;
+    executor.next_waiting[patient] = NO_PATIENT;
+    if (su->wait_tail == NO_PATIENT) {
+        su->wait_head = patient;
+    } else {
+        executor.next_waiting[su->wait_tail] = patient;
+    }
+    su->wait_tail = patient;
+    if (++su->queue_length > su->max_queue_length) {
+        su->max_queue_length = su->queue_length;
+    }
+    pthread_spin_unlock(&su->lock);
+}
+
+// Treatment ends: hand the server to the next waiting patient, move this one on
+static void handle_completion(ExecutorWorker *worker, int patient, int unit) {
+    ServiceUnit *su = &executor.units[unit];
+    double now = sim_now();
+    int next_patient = NO_PATIENT;
+
+    pthread_spin_lock(&su->lock);
+    advance_occupancy(&su->occupancy, now, su->busy, su->queue_length, su->capacity);
+    su->served++;
+    if (su->wait_head != NO_PATIENT) {
+        next_patient = su->wait_head;
+        su->wait_head = executor.next_waiting[next_patient];
+        if (su->wait_head == NO_PATIENT) {
+            su->wait_tail = NO_PATIENT;
+        }
+        su->queue_length--;
+    } else {
+        su->busy--;
+    }
+    pthread_spin_unlock(&su->lock);
+
+    if (next_patient != NO_PATIENT) {
+        executor.patients[next_patient]->total_waiting_time += now - executor.enqueue_time[next_patient];
+        start_treatment(next_patient, unit, now);
+    }
+
+    Patient *p = executor.patients[patient];
+    p->current_dept_index++;
+    DepartmentType next_dept = get_next_department(p);
+
+    if (next_dept == (DepartmentType)-1) {
+        p->discharge_time = executor.epoch + (time_t)now;
+        p->completed = 1;
+        PatientRecord record = { patient * (DISPATCH_INTERVAL / 1e6), now, p->total_waiting_time,
+                                 p->total_treatment_time, p->id, p->route_type, 0, {0} };
+        export_patient(&record);
+        if (__atomic_add_fetch(&executor.completed, 1, __ATOMIC_ACQ_REL) == executor.num_patients) {
+            pthread_mutex_lock(&executor.timer_mutex);
+            pthread_cond_broadcast(&executor.timer_cond);
+            pthread_mutex_unlock(&executor.timer_mutex);
+        }
+        return;
+    }
+
+    submit_task(worker, pack_task(TASK_ARRIVE, unit_for_patient(patient, next_dept), patient));
+}
+
+// Run one service event
+static void execute_task(ExecutorWorker *worker, uint64_t task) {
+    worker->executed++;
+
+    if (task_type(task) == TASK_ARRIVE) {
+        handle_arrival(task_patient(task), task_unit(task));
+    } else {
+        handle_completion(worker, task_patient(task), task_unit(task));
+    }
+}
+
+// Try every other worker's deque once, starting at a random victim
+static uint64_t steal_task(ExecutorWorker *worker) {
+    if (executor.num_workers < 2) return DEQUE_EMPTY;
+
+    int start = rand_r(&worker->rng_state) % executor.num_workers;
+    for (int i = 0; i < executor.num_workers; i++) {
+        int victim = (start + i) % executor.num_workers;
+        if (victim == worker->id) continue;
+
+        uint64_t task;
+        do {
+            task = steal_work(&executor.workers[victim].deque);
+        } while (task == DEQUE_ABORT);
+
+        if (task != DEQUE_EMPTY) {
+            worker->stolen++;
+            return task;
+        }
+    }
+    return DEQUE_EMPTY;
+}
+
+// Move due timers onto this worker's deque, or sleep until the next one
+static void poll_timers(ExecutorWorker *worker) {
+    pthread_mutex_lock(&executor.timer_mutex);
+
+    double now = sim_now();
+    int fired = 0;
+    while (executor.timer_count > 0 && executor.timers[0].deadline <= now) {
+        TimerEntry entry = timer_pop_locked();
+        if (push_work(&worker->deque, entry.task) != 0) {
+            timer_push_locked(entry.deadline, entry.task);  // Deque full, retry later
+            break;
+        }
+        fired++;
+    }
+
+    if (fired > 0) {
+        worker->timers_fired += fired;
+        if (fired > 1) {
+            pthread_cond_signal(&executor.timer_cond);  // Share the batch with a thief
+        }
+    } else if (!all_patients_done()) {
+        struct timespec wake;
+        clock_gettime(CLOCK_MONOTONIC, &wake);
+        double wait = executor.timer_count > 0 ?
+                      (executor.timers[0].deadline - now) * executor.time_scale : 0.1;
+        long ns = wake.tv_nsec + (long)(wait * 1e9);
+        wake.tv_sec += ns / 1000000000L;
+        wake.tv_nsec = ns % 1000000000L;
+
+        executor.idle_workers++;
+        pthread_cond_timedwait(&executor.timer_cond, &executor.timer_mutex, &wake);
+        executor.idle_workers--;
+    }
+
+    pthread_mutex_unlock(&executor.timer_mutex);
+}
+
+// Worker loop: local deque, then stealing, then timers
+static void* executor_worker(void *arg) {
+    ExecutorWorker *worker = (ExecutorWorker*)arg;
+    pin_to_role(worker->id + 1);
+
+    while (!all_patients_done()) {
+        uint64_t task = take_work(&worker->deque);
+        if (task == DEQUE_EMPTY) {
+            task = steal_task(worker);
+        }
+        if (task == DEQUE_EMPTY) {
+            poll_timers(worker);
+            continue;
+        }
+        execute_task(worker, task);
+    }
+
+    return NULL;
+}
+
+// Build units for every site from the department configurations
+static int init_service_units(int num_departments) {
+    executor.num_units = num_departments;
+    executor.num_sites = num_departments / NUM_DEPARTMENTS;
+    executor.units = (ServiceUnit*)calloc(num_departments, sizeof(ServiceUnit));
+    if (!executor.units) return -1;
+
+    for (int i = 0; i < num_departments; i++) {
+        ServiceUnit *su = &executor.units[i];
+        su->type = (DepartmentType)(i % NUM_DEPARTMENTS);
+        su->site = i / NUM_DEPARTMENTS;
+        su->capacity = get_department_resources(su->type);
+        su->wait_head = NO_PATIENT;
+        su->wait_tail = NO_PATIENT;
+        init_occupancy(&su->occupancy, 0.0);
+        pthread_spin_init(&su->lock, PTHREAD_PROCESS_PRIVATE);
+    }
+    return 0;
+}
+
+// Create patients with the default route mix and schedule their arrivals
+static int init_executor_patients(int num_patients) {
+    executor.num_patients = num_patients;
+    executor.patients = (Patient**)calloc(num_patients, sizeof(Patient*));
+    executor.enqueue_time = (double*)calloc(num_patients, sizeof(double));
+    executor.next_waiting = (int*)malloc(sizeof(int) * num_patients);
+    if (!executor.patients || !executor.enqueue_time || !executor.next_waiting) return -1;
+
+    for (int i = 0; i < num_patients; i++) {
+        executor.patients[i] = create_patient(i + 1, get_default_route(i));
+        if (!executor.patients[i]) return -1;
+
+        double arrival = i * (DISPATCH_INTERVAL / 1e6);
+        executor.patients[i]->arrival_time = executor.epoch + (time_t)arrival;
+
+        DepartmentType first_dept = get_next_department(executor.patients[i]);
+        timer_push_locked(arrival, pack_task(TASK_ARRIVE, unit_for_patient(i, first_dept), i));
+    }
+    return 0;
+}
+
+// Release everything allocated for a run
+static void destroy_executor() {
+    for (int i = 0; i < executor.num_units; i++) {
+        pthread_spin_destroy(&executor.units[i].lock);
+    }
+    for (int i = 0; i < executor.num_workers; i++) {
+        destroy_work_deque(&executor.workers[i].deque);
+    }
+    if (executor.patients) {
+        for (int i = 0; i < executor.num_patients; i++) {
+            free(executor.patients[i]);
+        }
+    }
+
+    free(executor.units);
+    free(executor.patients);
+    free(executor.enqueue_time);
+    free(executor.next_waiting);
+    free(executor.workers);
+    free(executor.timers);
+    pthread_mutex_destroy(&executor.timer_mutex);
+    pthread_cond_destroy(&executor.timer_cond);
+    memset(&executor, 0, sizeof(executor));
+}
+
+// Print executor, worker and busiest-unit statistics
+static void print_executor_report(double wall_seconds) {
+    printf("\n╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                 WORK-STEALING EXECUTOR REPORT                  ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    printf("Service Units (departments) : %d across %d site(s)\n", executor.num_units, executor.num_sites);
+    printf("Worker Threads              : %d\n", executor.num_workers);
+    printf("Wall Clock Duration         : %.2f seconds\n", wall_seconds);
+    print_cpu_placement(NULL, executor.num_workers, -1);
+    printf("\n");
+
+    printf("%-8s %12s %12s %12s\n", "Worker", "Executed", "Stolen", "Timers");
+    for (int i = 0; i < executor.num_workers; i++) {
+        ExecutorWorker *w = &executor.workers[i];
+        printf("%-8d %12ld %12ld %12ld\n", w->id, w->executed, w->stolen, w->timers_fired);
+    }
+
+    // Longest queue per department type across all sites
+    printf("\n%-12s %12s %16s\n", "Department", "Served", "Max Queue (unit)");
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        long served = 0;
+        int worst_unit = d;
+        for (int i = d; i < executor.num_units; i += NUM_DEPARTMENTS) {
+            served += executor.units[i].served;
+            if (executor.units[i].max_queue_length > executor.units[worst_unit].max_queue_length) {
+                worst_unit = i;
+            }
+        }
+        printf("%-12s %12ld %9d (%d)\n", get_department_name((DepartmentType)d), served,
+               executor.units[worst_unit].max_queue_length, worst_unit);
+    }
+    printf("\n");
+}
+
+// Run the whole simulation on a fixed pool of work-stealing workers.
+// Results are copied out when requested; the report is printed unless quiet.
+int run_executor_simulation(const SimConfig *config, SimResults *results) {
+    memset(&executor, 0, sizeof(executor));
+    executor.time_scale = config->time_scale;
+    executor.seed = config->seed;
+    executor.epoch = time(NULL);
+    executor.num_workers = config->num_workers > 0 ?
+                           config->num_workers : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (executor.num_workers < 1) executor.num_workers = 1;
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&executor.timer_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    pthread_mutex_init(&executor.timer_mutex, NULL);
+
+    executor.workers = (ExecutorWorker*)calloc(executor.num_workers, sizeof(ExecutorWorker));
+    if (!executor.workers ||
+        init_service_units(config->num_departments) != 0 ||
+        init_executor_patients(config->num_patients) != 0) {
+        fprintf(stderr, "Failed to allocate executor state\n");
+        destroy_executor();
+        return -1;
+    }
+
+    for (int i = 0; i < executor.num_workers; i++) {
+        executor.workers[i].id = i;
+        executor.workers[i].rng_state = (unsigned int)(executor.epoch + i);
+        if (init_work_deque(&executor.workers[i].deque, DEQUE_CAPACITY_LOG2) != 0) {
+            destroy_executor();
+            return -1;
+        }
+    }
+
+    if (!config->quiet) {
+        printf("Running %d patients through %d departments on %d worker thread(s)...\n",
+               executor.num_patients, executor.num_units, executor.num_workers);
+    }
+    log_message(LOG_INFO, "Executor started: %d units, %d sites, %d workers, %d patients",
+                executor.num_units, executor.num_sites, executor.num_workers, executor.num_patients);
+
+    clock_gettime(CLOCK_MONOTONIC, &executor.start);
+    for (int i = 0; i < executor.num_workers; i++) {
+        if (pthread_create(&executor.workers[i].thread, NULL, executor_worker, &executor.workers[i]) != 0) {
+            log_message(LOG_ERROR, "Failed to create executor worker %d", i);
+            __atomic_store_n(&executor.stopping, 1, __ATOMIC_RELEASE);
+            pthread_mutex_lock(&executor.timer_mutex);
+            pthread_cond_broadcast(&executor.timer_cond);
+            pthread_mutex_unlock(&executor.timer_mutex);
+            for (int j = 0; j < i; j++) {
+                pthread_join(executor.workers[j].thread, NULL);
+            }
+            destroy_executor();
+            return -1;
+        }
+    }
+    for (int i = 0; i < executor.num_workers; i++) {
+        pthread_join(executor.workers[i].thread, NULL);
+    }
+    double wall_seconds = sim_now() * executor.time_scale;
+
+    log_message(LOG_INFO, "Executor finished in %.2f seconds", wall_seconds);
+
+    GlobalMetrics metrics;
+    calculate_global_metrics(executor.patients, executor.num_patients, &metrics);
+    for (int i = 0; i < executor.num_units; i++) {
+        ServiceUnit *su = &executor.units[i];
+        add_unit_utilization(&metrics.departments[su->type], &su->occupancy, su->capacity,
+                             su->max_queue_length, wall_seconds / executor.time_scale, executor.num_sites);
+    }
+    collect_patient_results(executor.patients, executor.num_patients, &metrics, config->keep_patients, results);
+    if (!config->quiet) {
+        print_global_metrics(&metrics);
+        print_executor_report(wall_seconds);
+    }
+
+    destroy_executor();
+    return 0;
+}
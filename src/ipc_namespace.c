@@ -0,0 +1,136 @@
+#include "ipc_namespace.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/msg.h>
+
+// Keys look like 0x48HHHHHK: a tag byte, 20 bits of the instance name's hash
+// and the object kind. Clean-up recognizes simulator objects by the tag and
+// never touches anything else on the host.
+#define IPC_KEY_TAG 0x48000000
+#define IPC_KEY_TAG_MASK 0xFF000000
+#define IPC_KEY_HASH_MASK 0xFFFFF
+
+static char instance_name[MAX_INSTANCE_NAME + 1] = "";
+
+// FNV-1a, folded to the key's hash bits
+static uint32_t instance_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const char *c = name; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    return (hash ^ (hash >> 20)) & IPC_KEY_HASH_MASK;
+}
+
+static key_t ipc_key_for(const char *name, IpcObject object) {
+    return (key_t)(IPC_KEY_TAG | (instance_hash(name) << 4) | object);
+}
+
+// Name this instance's IPC objects: letters, digits, '.', '_' and '-'
+int set_ipc_instance(const char *name) {
+    size_t length = strlen(name);
+    if (length == 0 || length > MAX_INSTANCE_NAME) return -1;
+    for (size_t i = 0; i < length; i++) {
+        if (!isalnum((unsigned char)name[i]) && !strchr("._-", name[i])) return -1;
+    }
+    memcpy(instance_name, name, length + 1);
+    return 0;
+}
+
+// Instance name, the process ID unless one was set
+const char* get_ipc_instance() {
+    if (instance_name[0] == '\0') {
+        snprintf(instance_name, sizeof(instance_name), "%d", (int)getpid());
+    }
+    return instance_name;
+}
+
+key_t instance_ipc_key(IpcObject object) {
+    return ipc_key_for(get_ipc_instance(), object);
+}
+
+static int is_instance_key(int key, IpcObject object) {
+    return ((unsigned int)key & IPC_KEY_TAG_MASK) == IPC_KEY_TAG && (key & 0xF) == (int)object;
+}
+
+// Remove the state segments of exited instances, then every queue (dispatch
+// or return) whose instance no longer has a state segment
+static int clean_stale_instances() {
+    FILE *segments = fopen("/proc/sysvipc/shm", "r");
+    FILE *queues = fopen("/proc/sysvipc/msg", "r");
+    if (!segments || !queues) {
+        fprintf(stderr, "Cannot list SysV IPC objects: /proc/sysvipc is not available\n");
+        if (segments) fclose(segments);
+        if (queues) fclose(queues);
+        return -1;
+    }
+
+    int removed = 0;
+    uid_t uid = getuid();
+    char line[512];
+
+    // key shmid perms size cpid lpid nattch uid ... (the header line does not parse)
+    while (fgets(line, sizeof(line), segments)) {
+        int key, id, creator;
+        unsigned int owner;
+        if (sscanf(line, "%d %d %*o %*u %d %*d %*u %u", &key, &id, &creator, &owner) != 4) continue;
+        if (!is_instance_key(key, IPC_OBJECT_STATE) || (uid != 0 && owner != uid)) continue;
+        if (kill(creator, 0) == 0 || errno != ESRCH) continue;
+
+        if (shmctl(id, IPC_RMID, NULL) == 0) {
+            printf("Removed shared memory 0x%08x (creator %d exited)\n", key, creator);
+            removed++;
+        }
+    }
+
+    // key msqid perms cbytes qnum lspid lrpid uid ...
+    while (fgets(line, sizeof(line), queues)) {
+        int key, id;
+        unsigned int owner;
+        if (sscanf(line, "%d %d %*o %*u %*u %*d %*d %u", &key, &id, &owner) != 3) continue;
+        if (!is_instance_key(key, IPC_OBJECT_QUEUE) && !is_instance_key(key, IPC_OBJECT_RETURN)) continue;
+        if (uid != 0 && owner != uid) continue;
+
+        key_t state_key = (key_t)((key & ~0xF) | IPC_OBJECT_STATE);
+        if (shmget(state_key, 0, 0) != -1) continue;
+
+        if (msgctl(id, IPC_RMID, NULL) == 0) {
+            printf("Removed message queue 0x%08x (no running instance)\n", key);
+            removed++;
+        }
+    }
+
+    fclose(segments);
+    fclose(queues);
+    return removed;
+}
+
+// Remove one named instance's objects, or with NULL those of every instance
+// whose simulator has exited. Returns the number removed, -1 on error.
+int clean_ipc_instances(const char *name) {
+    if (!name) return clean_stale_instances();
+
+    int removed = 0;
+    int shm_id = shmget(ipc_key_for(name, IPC_OBJECT_STATE), 0, 0);
+    if (shm_id != -1 && shmctl(shm_id, IPC_RMID, NULL) == 0) {
+        printf("Removed shared memory of instance %s\n", name);
+        removed++;
+    }
+    int msg_queue_id = msgget(ipc_key_for(name, IPC_OBJECT_QUEUE), 0);
+    if (msg_queue_id != -1 && msgctl(msg_queue_id, IPC_RMID, NULL) == 0) {
+        printf("Removed message queue of instance %s\n", name);
+        removed++;
+    }
+    int return_queue_id = msgget(ipc_key_for(name, IPC_OBJECT_RETURN), 0);
+    if (return_queue_id != -1 && msgctl(return_queue_id, IPC_RMID, NULL) == 0) {
+        printf("Removed return queue of instance %s\n", name);
+        removed++;
+    }
+    return removed;
+}
@@ -0,0 +1,346 @@
+#include "journey.h"
+#include "department.h"
+#include "patient.h"
+#include "metrics.h"
+#include "logger.h"
+#include "random.h"
+#include "patient_export.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Waits shorter than this (wall seconds) are skipped to avoid sleep overhead
+#define MIN_SLEEP_SECONDS 0.0001
+
+// Pending treatment completion
+typedef struct {
+    double deadline;     // Simulated seconds since start
+    Journey *journey;
+} JourneyTimer;
+
+// Department servers and waiting line
+typedef struct {
+    int capacity;
+    int busy;
+    Journey *wait_head;
+    Journey *wait_tail;
+    long queue_length;
+    long max_queue_length;
+    long served;
+    DepartmentOccupancy occupancy;
+} JourneyDepartment;
+
+// Scheduler hosting every journey on one thread
+typedef struct {
+    Journey *journeys;
+    int num_journeys;
+    int next_arrival;
+    int completed;
+    long suspended;
+    long max_suspended;
+    long resumes;
+
+    JourneyDepartment departments[NUM_DEPARTMENTS];
+
+    JourneyTimer *timers;    // Binary min-heap on deadline
+    int timer_count;
+    int timer_capacity;
+
+    uint64_t seed;           // Treatment durations
+    double current_time;     // Simulated time of the event being handled
+    double time_scale;
+    struct timespec start;
+} JourneyScheduler;
+
+static JourneyScheduler scheduler;
+
+// Simulated seconds elapsed since the scheduler started
+static double sim_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double wall = (now.tv_sec - scheduler.start.tv_sec) +
+                  (now.tv_nsec - scheduler.start.tv_nsec) / 1e9;
+    return wall / scheduler.time_scale;
+}
+
+// Pace the loop: sleep in real time until a simulated deadline, then make
+// it the current time so late wake-ups do not drift the schedule
+static void sleep_until(double deadline) {
+    scheduler.current_time = deadline;
+    
+    double wait = (deadline - sim_now()) * scheduler.time_scale;
+    if (wait < MIN_SLEEP_SECONDS) return;
+
+    struct timespec ts;
+    ts.tv_sec = (time_t)wait;
+    ts.tv_nsec = (long)((wait - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+static void timer_push(double deadline, Journey *journey) {
+    if (scheduler.timer_count == scheduler.timer_capacity) {
+        int new_capacity = scheduler.timer_capacity ? scheduler.timer_capacity * 2 : 64;
+        JourneyTimer *timers = (JourneyTimer*)realloc(scheduler.timers, sizeof(JourneyTimer) * new_capacity);
+        if (!timers) {
+            log_message(LOG_ERROR, "Coroutine scheduler: failed to grow timer heap");
+            exit(1);
+        }
+        scheduler.timers = timers;
+        scheduler.timer_capacity = new_capacity;
+    }
+
+    int i = scheduler.timer_count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (scheduler.timers[parent].deadline <= deadline) break;
+        scheduler.timers[i] = scheduler.timers[parent];
+        i = parent;
+    }
+    scheduler.timers[i].deadline = deadline;
+    scheduler.timers[i].journey = journey;
+}
+
+static JourneyTimer timer_pop() {
+    JourneyTimer top = scheduler.timers[0];
+    JourneyTimer last = scheduler.timers[--scheduler.timer_count];
+
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= scheduler.timer_count) break;
+        if (child + 1 < scheduler.timer_count &&
+            scheduler.timers[child + 1].deadline < scheduler.timers[child].deadline) {
+            child++;
+        }
+        if (last.deadline <= scheduler.timers[child].deadline) break;
+        scheduler.timers[i] = scheduler.timers[child];
+        i = child;
+    }
+    if (scheduler.timer_count > 0) {
+        scheduler.timers[i] = last;
+    }
+    return top;
+}
+
+// Occupy a server and schedule the journey's wake-up at treatment end
+static void start_service(Journey *j, double now) {
+    int duration = random_int_range(scheduler.seed, RANDOM_SERVICE, j->patient_id - 1, j->hop,
+                                    TREATMENT_TIME_MIN, TREATMENT_TIME_MAX);
+    j->total_waiting_time += now - j->enqueue_time;
+    j->total_treatment_time += duration;
+    timer_push(now + duration, j);
+}
+
+// Awaitable: ask a department for treatment; resumes when treatment ends
+static void request_service(Journey *j, DepartmentType dept) {
+    JourneyDepartment *d = &scheduler.departments[dept];
+    double now = scheduler.current_time;
+    j->enqueue_time = now;
+
+    advance_occupancy(&d->occupancy, now, d->busy, (int)d->queue_length, d->capacity);
+    if (d->busy < d->capacity) {
+        d->busy++;
+        start_service(j, now);
+        return;
+    }
+
+    j->next = NULL;
+    if (d->wait_tail) {
+        d->wait_tail->next = j;
+    } else {
+        d->wait_head = j;
+    }
+    d->wait_tail = j;
+    if (++d->queue_length > d->max_queue_length) {
+        d->max_queue_length = d->queue_length;
+    }
+}
+
+// Free the server held by a journey whose treatment just ended
+static void release_service(DepartmentType dept) {
+    JourneyDepartment *d = &scheduler.departments[dept];
+    d->served++;
+    advance_occupancy(&d->occupancy, scheduler.current_time, d->busy, (int)d->queue_length, d->capacity);
+
+    Journey *next = d->wait_head;
+    if (!next) {
+        d->busy--;
+        return;
+    }
+
+    d->wait_head = next->next;
+    if (!d->wait_head) {
+        d->wait_tail = NULL;
+    }
+    d->queue_length--;
+    start_service(next, scheduler.current_time);
+}
+
+// A patient's whole visit, written as straight-line code
+static JourneyStatus patient_journey(Journey *j) {
+    JOURNEY_BEGIN(j);
+
+    j->arrival_time = scheduler.current_time;
+
+    for (j->hop = 0; get_route_department(j->route_type, j->hop) != (DepartmentType)-1; j->hop++) {
+        JOURNEY_AWAIT(j, request_service(j, get_route_department(j->route_type, j->hop)));
+        release_service(get_route_department(j->route_type, j->hop));
+    }
+
+    j->discharge_time = scheduler.current_time;
+    PatientRecord record = { j->arrival_time, j->discharge_time, j->total_waiting_time,
+                             j->total_treatment_time, j->patient_id, j->route_type, 0, {0} };
+    export_patient(&record);
+
+    JOURNEY_END(j);
+}
+
+// Run a journey until its next suspension point
+static void resume_journey(Journey *j) {
+    int was_started = j->resume_point != 0;
+
+    scheduler.resumes++;
+    JourneyStatus status = patient_journey(j);
+
+    if (status == JOURNEY_DONE) {
+        scheduler.completed++;
+        if (was_started) scheduler.suspended--;
+    } else if (!was_started) {
+        scheduler.suspended++;
+        if (scheduler.suspended > scheduler.max_suspended) {
+            scheduler.max_suspended = scheduler.suspended;
+        }
+    }
+}
+
+// Aggregate journey results into the standard global metrics
+static void summarize_journeys(GlobalMetrics *metrics, time_t epoch) {
+    memset(metrics, 0, sizeof(GlobalMetrics));
+    metrics->total_patients = scheduler.num_journeys;
+
+    double last_discharge = 0.0;
+    for (int i = 0; i < scheduler.num_journeys; i++) {
+        Journey *j = &scheduler.journeys[i];
+        metrics->avg_waiting_time += j->total_waiting_time;
+        metrics->avg_treatment_time += j->total_treatment_time;
+        metrics->avg_time_in_system += j->discharge_time - j->arrival_time;
+        if (j->discharge_time > last_discharge) last_discharge = j->discharge_time;
+    }
+
+    metrics->avg_waiting_time /= scheduler.num_journeys;
+    metrics->avg_treatment_time /= scheduler.num_journeys;
+    metrics->avg_time_in_system /= scheduler.num_journeys;
+    metrics->simulation_start = epoch;
+    metrics->simulation_end = epoch + (time_t)last_discharge;
+    metrics->throughput = last_discharge > 0 ? scheduler.num_journeys / (last_discharge / 60.0) : 0.0;
+
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        JourneyDepartment *dept = &scheduler.departments[d];
+        add_unit_utilization(&metrics->departments[d], &dept->occupancy, dept->capacity,
+                             (int)dept->max_queue_length, last_discharge, 1);
+    }
+}
+
+static void print_coroutine_report(double wall_seconds) {
+    printf("╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                  COROUTINE SCHEDULER REPORT                    ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    double frame_mb = (double)scheduler.num_journeys * sizeof(Journey) / (1024.0 * 1024.0);
+    printf("Journeys                    : %d\n", scheduler.num_journeys);
+    printf("Peak Suspended Journeys     : %ld\n", scheduler.max_suspended);
+    printf("Coroutine Resumes           : %ld\n", scheduler.resumes);
+    printf("Journey Frame Size          : %zu bytes (%.1f MB total)\n", sizeof(Journey), frame_mb);
+    printf("Wall Clock Duration         : %.2f seconds\n\n", wall_seconds);
+
+    printf("%-12s %12s %16s\n", "Department", "Served", "Max Queue");
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        printf("%-12s %12ld %16ld\n", get_department_name((DepartmentType)d),
+               scheduler.departments[d].served, scheduler.departments[d].max_queue_length);
+    }
+    printf("\n");
+}
+
+// Copy the run's global metrics and, if wanted, every journey's times into its results
+static void collect_journey_results(SimResults *results, time_t epoch, const GlobalMetrics *metrics,
+                                    int with_patients) {
+    if (!results) return;
+    results->metrics = *metrics;
+    if (!with_patients || init_sim_results(results, scheduler.num_journeys) != 0) return;
+
+    for (int i = 0; i < scheduler.num_journeys; i++) {
+        Journey *j = &scheduler.journeys[i];
+        PatientMetrics *result = &results->patients[i];
+        result->patient_id = j->patient_id;
+        result->route_type = (RouteType)j->route_type;
+        result->arrival_time = epoch + (time_t)j->arrival_time;
+        result->discharge_time = epoch + (time_t)j->discharge_time;
+        result->total_waiting_time = j->total_waiting_time;
+        result->total_treatment_time = j->total_treatment_time;
+        result->time_in_system = j->discharge_time - j->arrival_time;
+    }
+}
+
+// Run every patient journey as a coroutine on one real-time event loop
+int run_coroutine_simulation(const SimConfig *config, SimResults *results) {
+    memset(&scheduler, 0, sizeof(scheduler));
+    scheduler.num_journeys = config->num_patients;
+    scheduler.time_scale = config->time_scale;
+    scheduler.seed = config->seed;
+    scheduler.journeys = (Journey*)calloc(scheduler.num_journeys, sizeof(Journey));
+    if (!scheduler.journeys) {
+        fprintf(stderr, "Failed to allocate %d journeys\n", scheduler.num_journeys);
+        return -1;
+    }
+
+    for (int i = 0; i < scheduler.num_journeys; i++) {
+        scheduler.journeys[i].patient_id = i + 1;
+        scheduler.journeys[i].route_type = (uint8_t)get_default_route(i);
+    }
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        scheduler.departments[d].capacity = get_department_resources((DepartmentType)d);
+        init_occupancy(&scheduler.departments[d].occupancy, 0.0);
+    }
+
+    if (!config->quiet) {
+        printf("Running %d patient journeys as coroutines...\n", scheduler.num_journeys);
+    }
+    log_message(LOG_INFO, "Coroutine scheduler started with %d journeys", scheduler.num_journeys);
+
+    time_t epoch = time(NULL);
+    clock_gettime(CLOCK_MONOTONIC, &scheduler.start);
+    double arrival_interval = DISPATCH_INTERVAL / 1e6;
+
+    // Event loop: next arrival or next treatment completion, whichever is first
+    while (scheduler.completed < scheduler.num_journeys) {
+        double next_arrival = scheduler.next_arrival < scheduler.num_journeys ?
+                              scheduler.next_arrival * arrival_interval : INFINITY;
+        double next_timer = scheduler.timer_count > 0 ? scheduler.timers[0].deadline : INFINITY;
+
+        if (next_arrival <= next_timer) {
+            sleep_until(next_arrival);
+            resume_journey(&scheduler.journeys[scheduler.next_arrival++]);
+        } else {
+            sleep_until(next_timer);
+            resume_journey(timer_pop().journey);
+        }
+    }
+
+    double wall_seconds = sim_now() * scheduler.time_scale;
+    log_message(LOG_INFO, "Coroutine scheduler finished in %.2f seconds", wall_seconds);
+
+    GlobalMetrics metrics;
+    summarize_journeys(&metrics, epoch);
+    collect_journey_results(results, epoch, &metrics, config->keep_patients);
+    if (!config->quiet) {
+        print_global_metrics(&metrics);
+        print_coroutine_report(wall_seconds);
+    }
+
+    free(scheduler.journeys);
+    free(scheduler.timers);
+    memset(&scheduler, 0, sizeof(scheduler));
+    return 0;
+}
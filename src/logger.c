@@ -1,4 +1,5 @@
 #include "logger.h"
+#include "profiler.h"
 #include <stdio.h>
 #include <stdarg.h>
 #include <time.h>
@@ -29,6 +30,7 @@ int init_logger(const char *filename) {
 
 // Log message with timestamp and level
 void log_message(LogLevel level, const char *format, ...) {
+    PROFILE_SCOPE(PROF_LOG_MESSAGE);
     pthread_mutex_lock(&log_mutex);
     
     if (!log_file) {
@@ -1,14 +1,154 @@
 #include "message_queue.h"
 #include "logger.h"
 #include "department.h"
+#include "profiler.h"
+#include "shared_memory.h"
 #include <sys/ipc.h>
 #include <sys/msg.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 
-// Create message queue
+// In-process queues for the thread backend
+#define MAX_INPROC_QUEUES 8
+#define NUM_MESSAGE_TYPES (COMPLETION_MSG_TYPE + 1)  // Indexed by mtype
+#define INPROC_INITIAL_CAPACITY 16
+
+// Growable FIFO ring of messages of one type
+typedef struct {
+    Message *items;
+    int capacity;
+    int head;
+    int count;
+} MessageRing;
+
+// In-process queue: one ring per message type, like msgrcv type selection
+typedef struct {
+    int in_use;
+    pthread_mutex_t mutex;
+    pthread_cond_t available[NUM_MESSAGE_TYPES];
+    MessageRing rings[NUM_MESSAGE_TYPES];
+} InProcQueue;
+
+static TransportType current_transport = TRANSPORT_SYSV;
+static InProcQueue inproc_queues[MAX_INPROC_QUEUES];
+static pthread_mutex_t inproc_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Select the transport used by queues created afterwards
+void set_message_transport(TransportType transport) {
+    current_transport = transport;
+}
+
+// Append message to ring, doubling its storage when full
+static int ring_push(MessageRing *ring, const Message *msg) {
+    if (ring->count == ring->capacity) {
+        int new_capacity = ring->capacity ? ring->capacity * 2 : INPROC_INITIAL_CAPACITY;
+        Message *items = (Message*)malloc(sizeof(Message) * new_capacity);
+        if (!items) return -1;
+        
+        for (int i = 0; i < ring->count; i++) {
+            items[i] = ring->items[(ring->head + i) % ring->capacity];
+        }
+        free(ring->items);
+        ring->items = items;
+        ring->capacity = new_capacity;
+        ring->head = 0;
+    }
+    
+    ring->items[(ring->head + ring->count) % ring->capacity] = *msg;
+    ring->count++;
+    return 0;
+}
+
+// Remove oldest message from ring
+static void ring_pop(MessageRing *ring, Message *msg) {
+    *msg = ring->items[ring->head];
+    ring->head = (ring->head + 1) % ring->capacity;
+    ring->count--;
+}
+
+// Create in-process queue, returns its slot index as the queue ID
+static int create_inproc_queue() {
+    pthread_mutex_lock(&inproc_table_mutex);
+    
+    for (int id = 0; id < MAX_INPROC_QUEUES; id++) {
+        InProcQueue *queue = &inproc_queues[id];
+        if (queue->in_use) continue;
+        
+        memset(queue, 0, sizeof(InProcQueue));
+        pthread_mutex_init(&queue->mutex, NULL);
+        for (int t = 0; t < NUM_MESSAGE_TYPES; t++) {
+            pthread_cond_init(&queue->available[t], NULL);
+        }
+        queue->in_use = 1;
+        
+        pthread_mutex_unlock(&inproc_table_mutex);
+        return id;
+    }
+    
+    pthread_mutex_unlock(&inproc_table_mutex);
+    errno = ENOSPC;
+    return -1;
+}
+
+// Send message of the given type on the current transport; errno is EAGAIN
+// if a full kernel queue would block and blocking is off. In-process rings grow.
+static int queue_send(int msg_queue_id, long mtype, const Message *msg, int blocking) {
+    if (current_transport == TRANSPORT_SYSV) {
+        MessageBuffer msg_buf;
+        msg_buf.mtype = mtype;
+        msg_buf.data = *msg;
+        return msgsnd(msg_queue_id, &msg_buf, sizeof(Message), blocking ? 0 : IPC_NOWAIT);
+    }
+    
+    InProcQueue *queue = &inproc_queues[msg_queue_id];
+    pthread_mutex_lock(&queue->mutex);
+    int result = ring_push(&queue->rings[mtype], msg);
+    pthread_mutex_unlock(&queue->mutex);
+    
+    if (result != 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    pthread_cond_signal(&queue->available[mtype]);
+    return 0;
+}
+
+// Receive oldest message of the given type; errno is ENOMSG if none and not blocking
+static int queue_receive(int msg_queue_id, long mtype, Message *msg, int blocking) {
+    if (current_transport == TRANSPORT_SYSV) {
+        MessageBuffer msg_buf;
+        ssize_t result = msgrcv(msg_queue_id, &msg_buf, sizeof(Message), mtype,
+                                blocking ? 0 : IPC_NOWAIT);
+        if (result == -1) return -1;
+        *msg = msg_buf.data;
+        return 0;
+    }
+    
+    InProcQueue *queue = &inproc_queues[msg_queue_id];
+    pthread_mutex_lock(&queue->mutex);
+    
+    while (queue->rings[mtype].count == 0) {
+        if (!blocking) {
+            pthread_mutex_unlock(&queue->mutex);
+            errno = ENOMSG;
+            return -1;
+        }
+        pthread_cond_wait(&queue->available[mtype], &queue->mutex);
+    }
+    ring_pop(&queue->rings[mtype], msg);
+    
+    pthread_mutex_unlock(&queue->mutex);
+    return 0;
+}
+
+// Create message queue; a keyed SysV queue must not exist yet
 int create_message_queue(int key) {
-    int msg_queue_id = msgget(key, IPC_CREAT | 0666);
+    int exclusive = key != IPC_PRIVATE ? IPC_EXCL : 0;
+    int msg_queue_id = (current_transport == TRANSPORT_SYSV) ?
+                       msgget(key, IPC_CREAT | exclusive | 0600) : create_inproc_queue();
     if (msg_queue_id == -1) {
         log_message(LOG_ERROR, "Failed to create message queue: %s", strerror(errno));
         return -1;
@@ -18,18 +158,35 @@ int create_message_queue(int key) {
     return msg_queue_id;
 }
 
+// Messages a queue holds before senders block, INT_MAX if unbounded
+int message_queue_capacity(int msg_queue_id) {
+    if (current_transport == TRANSPORT_INPROC) return INT_MAX;
+    
+    struct msqid_ds info;
+    if (msgctl(msg_queue_id, IPC_STAT, &info) == -1) {
+        log_message(LOG_ERROR, "Failed to query message queue: %s", strerror(errno));
+        return -1;
+    }
+    return (int)(info.msg_qbytes / sizeof(Message));
+}
+
 // Send message to specific department
 int send_message_to_department(int msg_queue_id, DepartmentType dept, Patient *patient) {
     if (!patient) return -1;
+    PROFILE_SCOPE(PROF_MSG_SEND);
     
-    MessageBuffer msg_buf;
-    msg_buf.mtype = dept + 1;  // Message type 1-5 for departments
-    msg_buf.data.patient_id = patient->id;
-    msg_buf.data.route_type = patient->route_type;
-    msg_buf.data.current_dept_index = patient->current_dept_index;
-    msg_buf.data.sent_time = time(NULL);
+    Message msg;
+    msg.msg_type = dept + 1;  // Message type 1-5 for departments
+    msg.patient_id = patient->id;
+    msg.route_type = patient->route_type;
+    msg.current_dept_index = patient->current_dept_index;
+    msg.sent_time = time(NULL);
+    msg.enqueue_time = hospital_clock();
+    msg.sim_time = patient->ready_time;
+    msg.waiting_time = 0.0;
+    msg.treatment_time = 0.0;
     
-    if (msgsnd(msg_queue_id, &msg_buf, sizeof(Message), 0) == -1) {
+    if (queue_send(msg_queue_id, dept + 1, &msg, 1) == -1) {
         log_message(LOG_ERROR, "Failed to send message for Patient %d to %s: %s",
                     patient->id, get_department_name(dept), strerror(errno));
         return -1;
@@ -43,27 +200,77 @@ int send_message_to_department(int msg_queue_id, DepartmentType dept, Patient *p
 // Receive message from department
 int receive_message_from_department(int msg_queue_id, DepartmentType dept, Message *msg, int blocking) {
     if (!msg) return -1;
+    PROFILE_SCOPE(PROF_MSG_RECEIVE);
     
-    MessageBuffer msg_buf;
-    int flags = blocking ? 0 : IPC_NOWAIT;
     long msg_type = dept + 1;  // Receive messages for this department
     
-    ssize_t result = msgrcv(msg_queue_id, &msg_buf, sizeof(Message), msg_type, flags);
-    
-    if (result == -1) {
+    if (queue_receive(msg_queue_id, msg_type, msg, blocking) == -1) {
         if (errno != ENOMSG) {  // ENOMSG is expected for non-blocking when no message
+            int saved_errno = errno;
             log_message(LOG_ERROR, "Failed to receive message from %s: %s",
                         get_department_name(dept), strerror(errno));
+            errno = saved_errno;
+        }
+        return -1;
+    }
+    
+    return 0;
+}
+
+// Send treatment completion back to the scheduler; without blocking, errno
+// is EAGAIN when the return queue is full
+int send_completion_message(int return_queue_id, const Message *msg, int blocking) {
+    if (!msg) return -1;
+    
+    Message response = *msg;
+    response.sent_time = time(NULL);
+    
+    return queue_send(return_queue_id, COMPLETION_MSG_TYPE, &response, blocking);
+}
+
+// Receive treatment completion from any department
+int receive_completion_message(int return_queue_id, Message *msg, int blocking) {
+    if (!msg) return -1;
+    
+    if (queue_receive(return_queue_id, COMPLETION_MSG_TYPE, msg, blocking) == -1) {
+        if (errno != ENOMSG) {
+            log_message(LOG_ERROR, "Failed to receive completion message: %s", strerror(errno));
         }
         return -1;
     }
     
-    *msg = msg_buf.data;
     return 0;
 }
 
+// Ask a department worker to leave its service loop
+int send_shutdown_to_department(int msg_queue_id, DepartmentType dept) {
+    Message msg;
+    memset(&msg, 0, sizeof(Message));
+    msg.msg_type = dept + 1;
+    msg.patient_id = SHUTDOWN_PATIENT_ID;
+    msg.sent_time = time(NULL);
+    
+    return queue_send(msg_queue_id, dept + 1, &msg, 1);
+}
+
 // Destroy message queue
 void destroy_message_queue(int msg_queue_id) {
+    if (current_transport == TRANSPORT_INPROC) {
+        InProcQueue *queue = &inproc_queues[msg_queue_id];
+        
+        pthread_mutex_lock(&inproc_table_mutex);
+        for (int t = 0; t < NUM_MESSAGE_TYPES; t++) {
+            free(queue->rings[t].items);
+            pthread_cond_destroy(&queue->available[t]);
+        }
+        pthread_mutex_destroy(&queue->mutex);
+        queue->in_use = 0;
+        pthread_mutex_unlock(&inproc_table_mutex);
+        
+        log_message(LOG_INFO, "Message queue destroyed");
+        return;
+    }
+    
     if (msgctl(msg_queue_id, IPC_RMID, NULL) == -1) {
         log_message(LOG_ERROR, "Failed to destroy message queue: %s", strerror(errno));
     } else {
@@ -2,6 +2,7 @@
 #include "department.h"
 #include "logger.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 // Record patient arrival
@@ -44,10 +45,8 @@ void record_patient_discharge(Patient *patient) {
 void calculate_global_metrics(Patient **all_patients, int num_patients, GlobalMetrics *metrics) {
     if (!all_patients || !metrics || num_patients == 0) return;
     
+    memset(metrics, 0, sizeof(GlobalMetrics));
     metrics->total_patients = num_patients;
-    metrics->avg_waiting_time = 0.0;
-    metrics->avg_treatment_time = 0.0;
-    metrics->avg_time_in_system = 0.0;
     
     time_t earliest = all_patients[0]->arrival_time;
     time_t latest = all_patients[0]->discharge_time;
@@ -79,36 +78,33 @@ void calculate_global_metrics(Patient **all_patients, int num_patients, GlobalMe
                           num_patients / simulation_duration_minutes : 0.0;
 }
 
-// Print individual patient metrics
-void print_patient_metrics(Patient *patient) {
-    if (!patient) return;
-    
-    const char *route_names[] = {"Route A", "Route B", "Route C", "Route D"};
-    
-    char arrival_str[26], discharge_str[26];
-    struct tm *tm_info;
-    
-    tm_info = localtime(&patient->arrival_time);
-    strftime(arrival_str, 26, "%H:%M:%S", tm_info);
-    
-    if (patient->discharge_time > 0) {
-        tm_info = localtime(&patient->discharge_time);
-        strftime(discharge_str, 26, "%H:%M:%S", tm_info);
-    } else {
-        strcpy(discharge_str, "In Progress");
+// Add one discharged patient, as exported, to the run's totals
+void add_discharge_totals(DischargeTotals *totals, const PatientRecord *record) {
+    totals->discharged++;
+    totals->waiting_time += record->waiting_time;
+    totals->treatment_time += record->treatment_time;
+    totals->time_in_system += record->discharge_time - record->arrival_time;
+    if (record->discharge_time > totals->last_discharge) {
+        totals->last_discharge = record->discharge_time;
     }
+}
+
+// Global metrics from discharge totals, averaged as calculate_global_metrics() does
+void calculate_discharge_metrics(const DischargeTotals *totals, int num_patients, time_t first_arrival,
+                                 GlobalMetrics *metrics) {
+    memset(metrics, 0, sizeof(GlobalMetrics));
+    if (num_patients == 0) return;
     
-    double total_time = patient->completed ? 
-                       difftime(patient->discharge_time, patient->arrival_time) : 0.0;
+    metrics->total_patients = num_patients;
+    metrics->avg_waiting_time = totals->waiting_time / num_patients;
+    metrics->avg_treatment_time = totals->treatment_time / num_patients;
+    metrics->avg_time_in_system = totals->time_in_system / num_patients;
+    metrics->simulation_start = first_arrival;
+    metrics->simulation_end = first_arrival + (time_t)totals->last_discharge;
     
-    printf("│ %-4d │ %-8s │ %-10s │ %-12s │ %8.2f │ %10.2f │ %9.2f │\n",
-           patient->id,
-           route_names[patient->route_type],
-           arrival_str,
-           discharge_str,
-           patient->total_waiting_time,
-           patient->total_treatment_time,
-           total_time);
+    double simulation_duration_minutes = totals->last_discharge / 60.0;
+    metrics->throughput = (simulation_duration_minutes > 0) ? 
+                          num_patients / simulation_duration_minutes : 0.0;
 }
 
 // Print global metrics
@@ -126,5 +122,184 @@ void print_global_metrics(GlobalMetrics *metrics) {
     printf("Throughput                  : %.2f patients/minute\n", metrics->throughput);
     
     double total_duration = difftime(metrics->simulation_end, metrics->simulation_start);
-    printf("Total Simulation Duration   : %.2f seconds\n\n", total_duration);
+    printf("Total Simulation Duration   : %.2f seconds\n", total_duration);
+    if (metrics->balked + metrics->reneged > 0) {
+        printf("Balked (waiting room full)  : %d\n", metrics->balked);
+        printf("Reneged (out of patience)   : %d\n", metrics->reneged);
+        printf("Left Without Being Seen     : %d (%.1f%% of arrivals)\n", metrics->left_without_being_seen,
+               metrics->total_patients > 0 ? 100.0 * metrics->left_without_being_seen / metrics->total_patients : 0.0);
+    }
+    printf("\n");
+    
+    int abandoned = metrics->balked + metrics->reneged > 0;
+    printf("%-12s %12s %12s %12s %12s", "Department", "Utilization", "Avg Queue", "Max Queue", "All Busy");
+    if (abandoned) {
+        printf(" %10s %10s", "Balked", "Reneged");
+    }
+    printf("\n");
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        DepartmentUtilization *department = &metrics->departments[d];
+        printf("%-12s %11.1f%% %12.2f %12d %11.1f%%", get_department_name((DepartmentType)d),
+               department->utilization * 100.0, department->avg_queue_length,
+               department->max_queue_length, department->saturated_fraction * 100.0);
+        if (abandoned) {
+            printf(" %10ld %10ld", department->balked, department->reneged);
+        }
+        printf("\n");
+    }
+    printf("\n");
+    
+    if (metrics->num_pools > 0) {
+        printf("%-14s %6s %12s %10s %12s %10s  %s\n", "Resource Pool", "Units", "Utilization", "All Busy",
+               "Acquired", "Queued", "Used By");
+        for (int p = 0; p < metrics->num_pools; p++) {
+            PoolUtilization *pool = &metrics->pools[p];
+            if (pool->departments == 0) continue;
+            printf("%-14s %6d %11.1f%% %9.1f%% %12ld %10ld ", pool->name, pool->capacity,
+                   pool->utilization * 100.0, pool->saturated_fraction * 100.0, pool->acquisitions, pool->queued);
+            for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+                if ((pool->departments >> d) & 1) {
+                    printf(" %s", get_department_name((DepartmentType)d));
+                }
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+    
+    if (metrics->dispatch_credits == 0) return;
+    long deferred = 0, blocked = 0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        deferred += metrics->departments[d].deferred_dispatches;
+        blocked += metrics->departments[d].blocked_completions;
+    }
+    printf("Dispatch Credits            : %d per department (%ld dispatches deferred, %ld completions blocked)\n",
+           metrics->dispatch_credits, deferred, blocked);
+    if (deferred + blocked > 0) {
+        printf("%-12s %12s %12s %12s %12s\n", "Department", "Deferred", "Max Backlog", "Backpressure", "Blocked");
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            DepartmentUtilization *department = &metrics->departments[d];
+            printf("%-12s %12ld %12d %11.1f%% %12ld\n", get_department_name((DepartmentType)d),
+                   department->deferred_dispatches, department->max_dispatch_backlog,
+                   department->backpressure_fraction * 100.0, department->blocked_completions);
+        }
+    }
+    printf("\n");
+}
+
+// Begin time-weighted accounting at now, with nothing busy or waiting
+void init_occupancy(DepartmentOccupancy *occupancy, double now) {
+    memset(occupancy, 0, sizeof(DepartmentOccupancy));
+    occupancy->start = now;
+    occupancy->last_change = now;
+}
+
+// Credit the levels held since the last change, up to now
+void advance_occupancy(DepartmentOccupancy *occupancy, double now, int busy, int queue_length, int servers) {
+    double held = now - occupancy->last_change;
+    if (held <= 0.0) return;
+    
+    occupancy->busy_area += busy * held;
+    occupancy->queue_area += queue_length * held;
+    occupancy->capacity_area += servers * held;
+    if (busy >= servers) {
+        occupancy->saturated_time += held;
+    }
+    occupancy->last_change = now;
+}
+
+// Servers available over [start, end]: those integrated up to the last
+// change, then the current servers until the end
+static double capacity_time(const DepartmentOccupancy *occupancy, int servers, double end) {
+    return occupancy->capacity_area + servers * (end - occupancy->last_change);
+}
+
+// Add one service unit's share of its department type's utilization over
+// [start, end]. Units of a type are weighted equally.
+void add_unit_utilization(DepartmentUtilization *department, const DepartmentOccupancy *occupancy,
+                          int servers, int max_queue_length, double end, int units_of_type) {
+    double duration = end - occupancy->start;
+    double capacity = capacity_time(occupancy, servers, end);
+    if (duration <= 0.0 || capacity <= 0.0 || units_of_type <= 0) return;
+    
+    department->utilization += occupancy->busy_area / capacity / units_of_type;
+    department->avg_queue_length += occupancy->queue_area / duration / units_of_type;
+    department->saturated_fraction += occupancy->saturated_time / duration / units_of_type;
+    if (max_queue_length > department->max_queue_length) {
+        department->max_queue_length = max_queue_length;
+    }
+}
+
+// Name the plan's pools in the metrics; with one pool per department the
+// department table already covers them and none are listed
+void init_pool_metrics(GlobalMetrics *metrics, const ResourcePlan *plan) {
+    metrics->num_pools = 0;
+    if (is_default_resource_plan(plan)) return;
+    
+    metrics->num_pools = plan->num_pools;
+    for (int p = 0; p < plan->num_pools; p++) {
+        PoolUtilization *pool = &metrics->pools[p];
+        memset(pool, 0, sizeof(PoolUtilization));
+        memcpy(pool->name, plan->names[p], MAX_POOL_NAME);
+        pool->capacity = plan->capacity[p];
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            if ((plan->needs[d] >> p) & 1) {
+                pool->departments |= 1u << d;
+            }
+        }
+    }
+}
+
+// Add one site's share of a pool's use over [start, end]; the occupancy's
+// busy level is the units in use
+void add_pool_utilization(PoolUtilization *pool, const DepartmentOccupancy *occupancy, int units,
+                          double end, int sites) {
+    double duration = end - occupancy->start;
+    double capacity = capacity_time(occupancy, units, end);
+    if (duration <= 0.0 || capacity <= 0.0 || sites <= 0) return;
+    
+    pool->utilization += occupancy->busy_area / capacity / sites;
+    pool->saturated_fraction += occupancy->saturated_time / duration / sites;
+}
+
+// Allocate the per-patient table of a run's results
+int init_sim_results(SimResults *results, int num_patients) {
+    free(results->patients);
+    results->num_patients = 0;
+    results->patients = (PatientMetrics*)calloc(num_patients, sizeof(PatientMetrics));
+    if (!results->patients) {
+        log_message(LOG_ERROR, "Failed to allocate results for %d patients", num_patients);
+        return -1;
+    }
+    results->num_patients = num_patients;
+    return 0;
+}
+
+// Copy the run's global metrics and, if wanted, every finished patient into its results
+void collect_patient_results(Patient **all_patients, int num_patients, const GlobalMetrics *metrics,
+                             int with_patients, SimResults *results) {
+    if (!results) return;
+    results->metrics = *metrics;
+    if (!with_patients || init_sim_results(results, num_patients) != 0) return;
+    
+    for (int i = 0; i < num_patients; i++) {
+        record_patient_result(&results->patients[i], all_patients[i]);
+    }
+}
+
+// One patient's entry in a run's results
+void record_patient_result(PatientMetrics *result, const Patient *patient) {
+    result->patient_id = patient->id;
+    result->route_type = patient->route_type;
+    result->arrival_time = patient->arrival_time;
+    result->discharge_time = patient->discharge_time;
+    result->total_waiting_time = patient->total_waiting_time;
+    result->total_treatment_time = patient->total_treatment_time;
+    result->time_in_system = patient->completed ? difftime(patient->discharge_time, patient->arrival_time) : 0.0;
+}
+
+void free_sim_results(SimResults *results) {
+    if (!results) return;
+    free(results->patients);
+    memset(results, 0, sizeof(SimResults));
 }
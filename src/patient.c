@@ -1,4 +1,5 @@
 #include "patient.h"
+#include "department.h"
 #include "logger.h"
 #include <stdlib.h>
 #include <string.h>
@@ -10,6 +11,21 @@ static DepartmentType route_b[] = {EMERGENCY, RADIOLOGY, PHARMACY, BILLING};
 static DepartmentType route_c[] = {RADIOLOGY, OPD, BILLING};
 static DepartmentType route_d[] = {PHARMACY, BILLING};
 
+// Paths registered at runtime (e.g. from an arrival trace), after ROUTE_D
+typedef struct {
+    DepartmentType path[MAX_ROUTE_HOPS];
+    int length;
+} RegisteredRoute;
+
+static RegisteredRoute registered_routes[MAX_ROUTES - ROUTE_D - 1];
+static int num_registered_routes = 0;
+
+// Default patient mix, repeated when more patients are requested
+static const RouteType default_route_mix[] = {
+    ROUTE_A, ROUTE_A, ROUTE_A, ROUTE_B, ROUTE_B, ROUTE_C,
+    ROUTE_C, ROUTE_D, ROUTE_D, ROUTE_A, ROUTE_B, ROUTE_D
+};
+
 // Create a new patient with dynamic memory allocation
 Patient* create_patient(int id, RouteType route_type) {
     Patient *patient = (Patient*)malloc(sizeof(Patient));
@@ -25,6 +41,7 @@ Patient* create_patient(int id, RouteType route_type) {
     patient->discharge_time = 0;
     patient->total_waiting_time = 0.0;
     patient->total_treatment_time = 0.0;
+    patient->ready_time = 0.0;
     patient->completed = 0;
     
     log_message(LOG_INFO, "Created Patient %d with Route Type %d", id, route_type);
@@ -110,14 +127,22 @@ void print_patient_info(Patient *patient) {
            patient->total_waiting_time, patient->total_treatment_time);
 }
 
-// Get next department for patient based on route
-DepartmentType get_next_department(Patient *patient) {
-    if (!patient) return -1;
-    
+// Route of the index-th patient in the default mix
+RouteType get_default_route(int index) {
+    return default_route_mix[index % get_default_mix_length()];
+}
+
+// Patients before the default mix repeats
+int get_default_mix_length() {
+    return sizeof(default_route_mix) / sizeof(RouteType);
+}
+
+// Get department at a position of a route, -1 past the end
+DepartmentType get_route_department(RouteType route_type, int index) {
     DepartmentType *route = NULL;
     int route_length = 0;
     
-    switch (patient->route_type) {
+    switch (route_type) {
         case ROUTE_A:
             route = route_a;
             route_length = sizeof(route_a) / sizeof(DepartmentType);
@@ -135,14 +160,61 @@ DepartmentType get_next_department(Patient *patient) {
             route_length = sizeof(route_d) / sizeof(DepartmentType);
             break;
         default:
-            return -1;
+            if ((int)route_type <= ROUTE_D || (int)route_type > ROUTE_D + num_registered_routes) {
+                return -1;
+            }
+            route = registered_routes[route_type - ROUTE_D - 1].path;
+            route_length = registered_routes[route_type - ROUTE_D - 1].length;
+            break;
     }
     
-    if (patient->current_dept_index >= route_length) {
+    if (index < 0 || index >= route_length) {
         return -1;  // Route complete
     }
     
-    return route[patient->current_dept_index];
+    return route[index];
+}
+
+// Route id for a department path: a built-in route if one matches, else a
+// registered one (added on first use). Returns -1 when the table is full.
+int register_route(const DepartmentType *path, int length) {
+    if (length < 1 || length > MAX_ROUTE_HOPS) return -1;
+
+    for (int route = 0; route < get_num_routes(); route++) {
+        int hop = 0;
+        while (hop < length && get_route_department((RouteType)route, hop) == path[hop]) hop++;
+        if (hop == length && get_route_department((RouteType)route, hop) == (DepartmentType)-1) {
+            return route;
+        }
+    }
+
+    if (get_num_routes() == MAX_ROUTES) return -1;
+    RegisteredRoute *registered = &registered_routes[num_registered_routes++];
+    memcpy(registered->path, path, sizeof(DepartmentType) * length);
+    registered->length = length;
+    return ROUTE_D + num_registered_routes;
+}
+
+// Built-in plus registered routes
+int get_num_routes() {
+    return ROUTE_D + 1 + num_registered_routes;
+}
+
+// Department names of a route joined by '>', as in an arrival trace
+void format_route_path(RouteType route_type, char *path, size_t size) {
+    path[0] = '\0';
+    for (int hop = 0; ; hop++) {
+        DepartmentType dept = get_route_department(route_type, hop);
+        if (dept == (DepartmentType)-1) break;
+        size_t used = strlen(path);
+        snprintf(path + used, size - used, "%s%s", hop > 0 ? ">" : "", get_department_name(dept));
+    }
+}
+
+// Get next department for patient based on route
+DepartmentType get_next_department(Patient *patient) {
+    if (!patient) return -1;
+    return get_route_department(patient->route_type, patient->current_dept_index);
 }
 
 // Check if patient route is complete
@@ -0,0 +1,255 @@
+#include "patient_export.h"
+#include "patient.h"
+#include "steady_state.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#define EXPORT_BUFFER_SIZE (1 << 20)
+#define ROUTE_NAME_LENGTH 128
+
+// Discharges may come from several worker threads or logical processes
+static pthread_mutex_t export_mutex = PTHREAD_MUTEX_INITIALIZER;
+static FILE *export_file = NULL;
+static const char *export_path = NULL;
+static char *export_buffer = NULL;
+static int export_binary = 0;
+static int64_t exported = 0;
+static char route_names[MAX_ROUTES][ROUTE_NAME_LENGTH];  // Formatted on first use
+
+// Slowest journeys so far: a min-heap on time in system, so the root is the
+// first to be displaced. Journeys faster than a full heap's root skip the lock.
+static PatientRecord *slowest = NULL;
+static int slowest_capacity = 0;
+static int slowest_count = 0;
+static double slowest_threshold = -INFINITY;
+
+static inline double time_in_system(const PatientRecord *record) {
+    return record->discharge_time - record->arrival_time;
+}
+
+// a ranks below b: shorter stay, or equal stay and higher patient ID
+static inline int ranks_below(const PatientRecord *a, const PatientRecord *b) {
+    double ta = time_in_system(a), tb = time_in_system(b);
+    return ta < tb || (ta == tb && a->patient_id > b->patient_id);
+}
+
+static void sift_down(int i, int count) {
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < count && ranks_below(&slowest[left], &slowest[smallest])) smallest = left;
+        if (right < count && ranks_below(&slowest[right], &slowest[smallest])) smallest = right;
+        if (smallest == i) return;
+        PatientRecord tmp = slowest[i];
+        slowest[i] = slowest[smallest];
+        slowest[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static void keep_if_slowest(const PatientRecord *record) {
+    if (slowest_count < slowest_capacity) {
+        int i = slowest_count++;
+        slowest[i] = *record;
+        while (i > 0 && ranks_below(&slowest[i], &slowest[(i - 1) / 2])) {
+            PatientRecord tmp = slowest[i];
+            slowest[i] = slowest[(i - 1) / 2];
+            slowest[(i - 1) / 2] = tmp;
+            i = (i - 1) / 2;
+        }
+    } else if (ranks_below(&slowest[0], record)) {
+        slowest[0] = *record;
+        sift_down(0, slowest_count);
+    } else {
+        return;
+    }
+
+    if (slowest_count == slowest_capacity) {
+        double threshold = time_in_system(&slowest[0]);
+        __atomic_store(&slowest_threshold, &threshold, __ATOMIC_RELAXED);
+    }
+}
+
+// Decimal digits of a non-negative integer
+static char* put_digits(char *out, uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) *out++ = digits[--n];
+    return out;
+}
+
+// value with three decimals, like "%.3f" but without printf's cost per field
+static char* put_fixed3(char *out, double value) {
+    if (value < 0) {
+        *out++ = '-';
+        value = -value;
+    }
+    uint64_t millis = (uint64_t)llround(value * 1000.0);
+    out = put_digits(out, millis / 1000);
+    *out++ = '.';
+    *out++ = (char)('0' + millis / 100 % 10);
+    *out++ = (char)('0' + millis / 10 % 10);
+    *out++ = (char)('0' + millis % 10);
+    return out;
+}
+
+// One CSV line; the caller holds the export mutex
+static void write_csv_record(const PatientRecord *record) {
+    char *route = route_names[record->route_type];
+    if (route[0] == '\0') {
+        format_route_path((RouteType)record->route_type, route, ROUTE_NAME_LENGTH);
+    }
+
+    char line[ROUTE_NAME_LENGTH + 160];
+    char *out = put_digits(line, (uint32_t)record->patient_id);
+    *out++ = ',';
+    size_t length = strlen(route);
+    memcpy(out, route, length);
+    out += length;
+    *out++ = ',';
+    out = put_digits(out, record->triage);
+    const double fields[5] = { record->arrival_time, record->discharge_time, record->waiting_time,
+                               record->treatment_time, time_in_system(record) };
+    for (int i = 0; i < 5; i++) {
+        *out++ = ',';
+        out = put_fixed3(out, fields[i]);
+    }
+    *out++ = '\n';
+    fwrite(line, 1, out - line, export_file);
+}
+
+// Start a run's export. With a path every discharged patient is streamed
+// there through a large buffer, as binary records when the name ends in
+// ".bin" and as CSV otherwise. The slowest journeys are kept either way.
+int start_patient_export(const char *path, int slowest_journeys) {
+    free(slowest);
+    slowest = NULL;
+    slowest_count = 0;
+    slowest_capacity = 0;
+    slowest_threshold = -INFINITY;
+    exported = 0;
+    memset(route_names, 0, sizeof(route_names));
+
+    if (slowest_journeys > 0) {
+        slowest = (PatientRecord*)calloc(slowest_journeys, sizeof(PatientRecord));
+        if (!slowest) return -1;
+        slowest_capacity = slowest_journeys;
+    }
+    if (!path) return 0;
+
+    export_file = fopen(path, "wb");
+    if (!export_file) {
+        perror("open patient export");
+        return -1;
+    }
+    export_buffer = (char*)malloc(EXPORT_BUFFER_SIZE);
+    if (export_buffer) {
+        setvbuf(export_file, export_buffer, _IOFBF, EXPORT_BUFFER_SIZE);
+    }
+    export_path = path;
+
+    size_t length = strlen(path);
+    export_binary = length > 4 && strcmp(path + length - 4, ".bin") == 0;
+    if (export_binary) {
+        PatientExportHeader header;
+        memset(&header, 0, sizeof(header));
+        fwrite(&header, sizeof(header), 1, export_file);  // Completed by finish_patient_export()
+    } else {
+        fprintf(export_file, "patient_id,route,triage,arrival,discharge,waiting,treatment,time_in_system\n");
+    }
+    return 0;
+}
+
+// Record one patient whose times are final
+void export_patient(const PatientRecord *record) {
+    observe_discharge(record->arrival_time, record->discharge_time, record->waiting_time, record->patient_id);
+    if (!export_file) {
+        double threshold;
+        __atomic_load(&slowest_threshold, &threshold, __ATOMIC_RELAXED);
+        if (slowest_capacity == 0 || time_in_system(record) < threshold) return;
+    }
+
+    pthread_mutex_lock(&export_mutex);
+    if (slowest_capacity > 0) {
+        keep_if_slowest(record);
+    }
+    if (export_file) {
+        if (export_binary) {
+            fwrite(record, sizeof(PatientRecord), 1, export_file);
+        } else {
+            write_csv_record(record);
+        }
+        exported++;
+    }
+    pthread_mutex_unlock(&export_mutex);
+}
+
+// Slowest journeys of the run, slowest first. Heapsorts the min-heap in
+// place, so nothing may be exported after it until the next start.
+void print_slowest_journeys() {
+    if (slowest_count == 0) return;
+
+    for (int end = slowest_count - 1; end > 0; end--) {
+        PatientRecord tmp = slowest[0];
+        slowest[0] = slowest[end];
+        slowest[end] = tmp;
+        sift_down(0, end);
+    }
+    const PatientRecord *sorted = slowest;
+
+    printf("╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                 SLOWEST PATIENT JOURNEYS                       ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+    printf("%10s  %-40s %10s %10s %10s\n", "Patient", "Route", "Arrival", "Waiting", "Total");
+    for (int i = 0; i < slowest_count; i++) {
+        char route[ROUTE_NAME_LENGTH];
+        format_route_path((RouteType)sorted[i].route_type, route, sizeof(route));
+        printf("%10d  %-40s %10.2f %10.2f %10.2f\n", sorted[i].patient_id, route,
+               sorted[i].arrival_time, sorted[i].waiting_time, time_in_system(&sorted[i]));
+    }
+    printf("\n");
+}
+
+// Flush and close the export; the binary header gets its record count
+int finish_patient_export(int report) {
+    if (!export_file) return 0;
+
+    int result = 0;
+    if (export_binary) {
+        PatientExportHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, PATIENT_EXPORT_MAGIC, sizeof(header.magic));
+        header.version = PATIENT_EXPORT_VERSION;
+        header.record_size = sizeof(PatientRecord);
+        header.num_records = exported;
+        fseek(export_file, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, export_file);
+    }
+    if (ferror(export_file)) {
+        result = -1;
+    }
+    if (fclose(export_file) != 0) {
+        result = -1;
+    }
+    free(export_buffer);
+    export_file = NULL;
+    export_buffer = NULL;
+
+    if (result != 0) {
+        fprintf(stderr, "Failed to write patient export %s\n", export_path);
+        return -1;
+    }
+    if (report) {
+        printf("Patient export              : %s (%lld patients)\n", export_path, (long long)exported);
+    }
+    log_message(LOG_INFO, "Exported %lld patients to %s", (long long)exported, export_path);
+    return 0;
+}
@@ -0,0 +1,214 @@
+#define _GNU_SOURCE
+#include "placement.h"
+#include "logger.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define MAX_NUMA_NODES 64
+#define MPOL_PREFERRED 1   // From <numaif.h>, without linking libnuma
+
+// CPUs this process may run on, in the order roles are assigned to them
+static PlacementPolicy active_policy = PLACEMENT_NONE;
+static int cpu_order[MAX_PLACEMENT_CPUS];
+static int num_ordered_cpus = 0;
+static int cpu_node[MAX_PLACEMENT_CPUS];
+static int num_nodes = 1;
+
+// Parse "0-3,8,10-11" into a CPU list, returns count or -1
+static int parse_cpu_list(const char *text, int *cpus, int max_cpus) {
+    int count = 0;
+    const char *p = text;
+
+    while (*p && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return -1;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (count == max_cpus) return -1;
+            cpus[count++] = (int)cpu;
+        }
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+    }
+    return count;
+}
+
+// Map every CPU to its NUMA node from sysfs; one node if unavailable
+static void read_numa_topology() {
+    memset(cpu_node, 0, sizeof(cpu_node));
+    num_nodes = 1;
+
+    for (int node = 0; node < MAX_NUMA_NODES; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *file = fopen(path, "r");
+        if (!file) continue;
+
+        char line[1024];
+        int cpus[MAX_PLACEMENT_CPUS];
+        int count = fgets(line, sizeof(line), file) ? parse_cpu_list(line, cpus, MAX_PLACEMENT_CPUS) : -1;
+        fclose(file);
+
+        // CPUs beyond the table can never be placed, so their node is moot
+        for (int i = 0; i < count; i++) {
+            if (cpus[i] < MAX_PLACEMENT_CPUS) {
+                cpu_node[cpus[i]] = node;
+            }
+        }
+        if (count > 0 && node + 1 > num_nodes) {
+            num_nodes = node + 1;
+        }
+    }
+}
+
+// Parse --pin: none, compact, spread or a CPU list
+int parse_cpu_placement(const char *spec, CpuPlacement *placement) {
+    memset(placement, 0, sizeof(CpuPlacement));
+
+    if (strcmp(spec, "none") == 0) {
+        placement->policy = PLACEMENT_NONE;
+    } else if (strcmp(spec, "compact") == 0) {
+        placement->policy = PLACEMENT_COMPACT;
+    } else if (strcmp(spec, "spread") == 0) {
+        placement->policy = PLACEMENT_SPREAD;
+    } else {
+        placement->num_cpus = parse_cpu_list(spec, placement->cpus, MAX_PLACEMENT_CPUS);
+        if (placement->num_cpus <= 0) return -1;
+        placement->policy = PLACEMENT_LIST;
+    }
+    return 0;
+}
+
+// Build the role-to-CPU order from the allowed CPUs and NUMA topology
+int init_cpu_placement(const CpuPlacement *placement) {
+    active_policy = placement->policy;
+    num_ordered_cpus = 0;
+    if (active_policy == PLACEMENT_NONE) return 0;
+
+    read_numa_topology();
+
+    if (active_policy == PLACEMENT_LIST) {
+        for (int i = 0; i < placement->num_cpus; i++) {
+            if (placement->cpus[i] >= MAX_PLACEMENT_CPUS) {
+                fprintf(stderr, "CPU %d is out of range\n", placement->cpus[i]);
+                return -1;
+            }
+            cpu_order[num_ordered_cpus++] = placement->cpus[i];
+        }
+        return 0;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        perror("sched_getaffinity");
+        return -1;
+    }
+
+    // Compact walks node by node; spread takes the next CPU of each node in turn
+    int taken[MAX_NUMA_NODES] = {0};
+    int remaining = CPU_COUNT(&allowed);
+    while (num_ordered_cpus < remaining) {
+        for (int node = 0; node < num_nodes; node++) {
+            int skipped = 0;
+            for (int cpu = 0; cpu < MAX_PLACEMENT_CPUS; cpu++) {
+                if (!CPU_ISSET(cpu, &allowed) || cpu_node[cpu] != node) continue;
+                if (skipped++ < taken[node]) continue;
+
+                cpu_order[num_ordered_cpus++] = cpu;
+                taken[node]++;
+                if (active_policy == PLACEMENT_SPREAD) break;
+            }
+        }
+    }
+    return 0;
+}
+
+// CPU assigned to a role, -1 when unpinned
+int placement_cpu_for_role(int role) {
+    if (active_policy == PLACEMENT_NONE || num_ordered_cpus == 0) return -1;
+    return cpu_order[role % num_ordered_cpus];
+}
+
+// NUMA node of a role's CPU, -1 when unpinned
+int placement_node_for_role(int role) {
+    int cpu = placement_cpu_for_role(role);
+    return cpu < 0 ? -1 : cpu_node[cpu];
+}
+
+// Pin the calling thread (or single-threaded process) to its role's CPU
+int pin_to_role(int role) {
+    int cpu = placement_cpu_for_role(role);
+    if (cpu < 0) return -1;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        log_message(LOG_WARNING, "Failed to pin role %d to CPU %d", role, cpu);
+        return -1;
+    }
+    return cpu;
+}
+
+// Prefer a NUMA node for the pages of a region not yet touched
+void bind_memory_to_node(void *addr, size_t length, int node) {
+    if (node < 0 || num_nodes < 2) return;
+
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)addr + page - 1) & ~(uintptr_t)(page - 1);
+    uintptr_t end = ((uintptr_t)addr + length) & ~(uintptr_t)(page - 1);
+    if (end <= start) return;
+
+    unsigned long nodemask = 1UL << node;
+    if (syscall(SYS_mbind, (void*)start, end - start, MPOL_PREFERRED,
+                &nodemask, sizeof(nodemask) * 8, 0) != 0) {
+        log_message(LOG_WARNING, "Failed to bind shared memory to node %d", node);
+    }
+}
+
+// Get placement policy name
+const char* get_placement_name(PlacementPolicy policy) {
+    switch (policy) {
+        case PLACEMENT_NONE:    return "none";
+        case PLACEMENT_COMPACT: return "compact";
+        case PLACEMENT_SPREAD:  return "spread";
+        case PLACEMENT_LIST:    return "list";
+        default:                return "unknown";
+    }
+}
+
+// One line showing where each role runs and where shared memory lives.
+// Roles without a name (NULL array) are labelled by worker index.
+void print_cpu_placement(const char *const role_names[], int num_roles, int memory_node) {
+    printf("CPU Placement (%s):", get_placement_name(active_policy));
+    if (active_policy == PLACEMENT_NONE) {
+        printf(" unpinned\n");
+        return;
+    }
+
+    for (int role = 0; role < num_roles; role++) {
+        if (role_names) {
+            printf(" %s=cpu%d/node%d", role_names[role],
+                   placement_cpu_for_role(role), placement_node_for_role(role));
+        } else {
+            printf(" w%d=cpu%d/node%d", role,
+                   placement_cpu_for_role(role + 1), placement_node_for_role(role + 1));
+        }
+    }
+    if (memory_node >= 0) {
+        printf(num_nodes > 1 ? " | shm=node%d" : " | shm=node%d (single node)", memory_node);
+    }
+    printf("\n");
+}
@@ -0,0 +1,122 @@
+#include "profiler.h"
+
+#ifdef HOSPITAL_PROFILE
+
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+// Counters used until the process (or department thread) attaches to its slot
+static __thread ProfileSlot local_slot;
+static __thread ProfileSlot *current_slot = NULL;
+
+// Slot this thread is currently recording into
+static inline ProfileSlot* active_slot() {
+    if (!current_slot) {
+        current_slot = &local_slot;
+    }
+    return current_slot;
+}
+
+static const char *section_names[NUM_PROF_SECTIONS] = {
+    "msg_send", "msg_receive", "completion_send", "semaphore_wait",
+    "semaphore_post", "shm_mutex", "log_message", "scheduler_lookup"
+};
+
+// Nanoseconds from CLOCK_MONOTONIC_RAW
+static uint64_t raw_nanoseconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Initialize profile table and calibrate the tick rate
+void init_profiler(ProfileTable *table) {
+    if (!table) return;
+
+    memset(table, 0, sizeof(ProfileTable));
+
+    uint64_t ns_start = raw_nanoseconds();
+    uint64_t tick_start = profiler_ticks();
+    usleep(20000);
+    uint64_t elapsed_ns = raw_nanoseconds() - ns_start;
+    uint64_t elapsed_ticks = profiler_ticks() - tick_start;
+
+    table->ticks_per_ns = elapsed_ns > 0 ? (double)elapsed_ticks / elapsed_ns : 1.0;
+    log_message(LOG_INFO, "Profiler calibrated at %.3f ticks/ns", table->ticks_per_ns);
+}
+
+// Switch this process to its shared memory slot, keeping earlier counts
+void profiler_attach(ProfileTable *table, int slot, const char *name) {
+    if (!table || slot < 0 || slot >= PROF_MAX_PROCESSES) return;
+
+    ProfileSlot *shared = &table->slots[slot];
+    shared->pid = getpid();
+    snprintf(shared->name, sizeof(shared->name), "%s", name);
+
+    for (int i = 0; i < NUM_PROF_SECTIONS; i++) {
+        ProfileCounter *local = &active_slot()->counters[i];
+        shared->counters[i].calls += local->calls;
+        shared->counters[i].total_ticks += local->total_ticks;
+        if (local->max_ticks > shared->counters[i].max_ticks) {
+            shared->counters[i].max_ticks = local->max_ticks;
+        }
+    }
+
+    current_slot = shared;
+}
+
+// Fall back to private counters (used by forked children before attaching)
+void profiler_detach() {
+    memset(&local_slot, 0, sizeof(local_slot));
+    current_slot = &local_slot;
+}
+
+// Add one timed interval to the current process's counters
+void profiler_record(ProfileSection section, uint64_t start) {
+    uint64_t elapsed = profiler_ticks() - start;
+    ProfileCounter *counter = &active_slot()->counters[section];
+
+    counter->calls++;
+    counter->total_ticks += elapsed;
+    if (elapsed > counter->max_ticks) {
+        counter->max_ticks = elapsed;
+    }
+}
+
+// Print per-process breakdown of hot-path timings
+void print_profiler_report(ProfileTable *table) {
+    if (!table) return;
+
+    double ticks_per_ns = table->ticks_per_ns > 0 ? table->ticks_per_ns : 1.0;
+
+    printf("╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                  HOT-PATH PROFILE (inclusive)                  ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    printf("%-12s %-18s %10s %12s %12s %12s\n",
+           "Process", "Section", "Calls", "Total (ms)", "Avg (ns)", "Max (ns)");
+
+    for (int p = 0; p < PROF_MAX_PROCESSES; p++) {
+        ProfileSlot *slot = &table->slots[p];
+        if (slot->pid == 0) continue;
+
+        for (int i = 0; i < NUM_PROF_SECTIONS; i++) {
+            ProfileCounter *counter = &slot->counters[i];
+            if (counter->calls == 0) continue;
+
+            double total_ns = counter->total_ticks / ticks_per_ns;
+            printf("%-12s %-18s %10llu %12.3f %12.0f %12.0f\n",
+                   slot->name, section_names[i],
+                   (unsigned long long)counter->calls,
+                   total_ns / 1e6,
+                   total_ns / counter->calls,
+                   counter->max_ticks / ticks_per_ns);
+        }
+    }
+    printf("\n");
+}
+
+#endif // HOSPITAL_PROFILE
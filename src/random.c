@@ -0,0 +1,38 @@
+#include "random.h"
+#include <time.h>
+#include <unistd.h>
+
+// Counter-based generator: every draw is a pure function of
+// (seed, stream, entity, index), so results never depend on which process,
+// thread or event order happens to make the draw.
+
+// SplitMix64 finalizer
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// 64 random bits for one key
+uint64_t random_bits(uint64_t seed, RandomStream stream, uint64_t entity, uint64_t index) {
+    uint64_t z = mix64(seed + 0x9E3779B97F4A7C15ULL * ((uint64_t)stream + 1));
+    z = mix64(z ^ (entity + 0x9E3779B97F4A7C15ULL));
+    return mix64(z ^ (index + 0xD1B54A32D192ED03ULL));
+}
+
+// Uniform double in [0, 1)
+double random_uniform(uint64_t seed, RandomStream stream, uint64_t entity, uint64_t index) {
+    return (random_bits(seed, stream, entity, index) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Uniform integer in [min, max]
+int random_int_range(uint64_t seed, RandomStream stream, uint64_t entity, uint64_t index, int min, int max) {
+    return min + (int)(random_uniform(seed, stream, entity, index) * (max - min + 1));
+}
+
+// Seed for runs that did not ask for one
+uint64_t default_random_seed() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return mix64((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec + (uint64_t)getpid()) % 1000000000ULL + 1;
+}
@@ -0,0 +1,208 @@
+#include "replay.h"
+#include "department.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define MAX_HELD_MESSAGES 64
+
+// Recording: one O_APPEND descriptor shared by every department (forked
+// children inherit it; single-record writes do not interleave)
+static int record_fd = -1;
+static const char *record_path = NULL;
+
+// Replay: each department's recorded treatment order
+typedef struct {
+    ReplayRecord *records;
+    int count;
+    int next;                    // Next record to honour
+    Message held[MAX_HELD_MESSAGES];  // Arrived early, waiting for their turn
+    int held_count;
+} DepartmentReplay;
+
+static DepartmentReplay replays[NUM_DEPARTMENTS];
+static ReplayRecord *replay_records = NULL;
+static int replay_active = 0;
+
+// Create the log and write its header; call before departments start
+int start_replay_recording(const char *path, uint64_t seed, int num_patients) {
+    record_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (record_fd == -1) {
+        perror("open replay log");
+        return -1;
+    }
+
+    ReplayHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.record_size = sizeof(ReplayRecord);
+    header.seed = seed;
+    header.num_patients = num_patients;
+
+    if (write(record_fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        perror("write replay log");
+        close(record_fd);
+        record_fd = -1;
+        return -1;
+    }
+    record_path = path;
+    return 0;
+}
+
+// Append one treatment start (no-op unless recording)
+void record_treatment_order(uint64_t sequence, DepartmentType dept, const Message *msg, double start_time) {
+    if (record_fd == -1) return;
+
+    ReplayRecord record;
+    memset(&record, 0, sizeof(record));
+    record.sequence = sequence;
+    record.patient_id = msg->patient_id;
+    record.department = (int16_t)dept;
+    record.hop = (int16_t)msg->current_dept_index;
+    record.sim_time = start_time;
+
+    if (write(record_fd, &record, sizeof(record)) != (ssize_t)sizeof(record)) {
+        log_message(LOG_ERROR, "Failed to append to replay log");
+    }
+}
+
+int finish_replay_recording() {
+    if (record_fd == -1) return 0;
+
+    off_t size = lseek(record_fd, 0, SEEK_END);
+    close(record_fd);
+    record_fd = -1;
+    printf("Replay log                  : %s (%ld treatment starts recorded)\n", record_path,
+           (long)((size - (off_t)sizeof(ReplayHeader)) / (off_t)sizeof(ReplayRecord)));
+    return 0;
+}
+
+static int compare_sequence(const void *a, const void *b) {
+    const ReplayRecord *ra = (const ReplayRecord*)a;
+    const ReplayRecord *rb = (const ReplayRecord*)b;
+    return (ra->sequence > rb->sequence) - (ra->sequence < rb->sequence);
+}
+
+// Read a log and split it into per-department orders
+int load_replay(const char *path, uint64_t *seed, int *num_patients) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror("open replay log");
+        return -1;
+    }
+
+    ReplayHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != REPLAY_VERSION || header.record_size != sizeof(ReplayRecord)) {
+        fprintf(stderr, "%s: not a replay log for this version\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long count = (ftell(file) - (long)sizeof(header)) / (long)sizeof(ReplayRecord);
+    fseek(file, sizeof(header), SEEK_SET);
+
+    replay_records = (ReplayRecord*)malloc(sizeof(ReplayRecord) * (count > 0 ? count : 1));
+    if (!replay_records || fread(replay_records, sizeof(ReplayRecord), count, file) != (size_t)count) {
+        fprintf(stderr, "%s: truncated replay log\n", path);
+        fclose(file);
+        free(replay_records);
+        replay_records = NULL;
+        return -1;
+    }
+    fclose(file);
+
+    // Appends from different processes may land slightly out of order
+    qsort(replay_records, count, sizeof(ReplayRecord), compare_sequence);
+
+    // Group records by department, keeping global order within each
+    memset(replays, 0, sizeof(replays));
+    ReplayRecord *grouped = (ReplayRecord*)malloc(sizeof(ReplayRecord) * (count > 0 ? count : 1));
+    if (!grouped) {
+        free(replay_records);
+        replay_records = NULL;
+        return -1;
+    }
+    int offset = 0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        replays[d].records = grouped + offset;
+        int filled = 0;
+        for (long i = 0; i < count; i++) {
+            if (replay_records[i].department == d) {
+                replays[d].records[filled++] = replay_records[i];
+            }
+        }
+        replays[d].count = filled;
+        offset += filled;
+    }
+    free(replay_records);
+    replay_records = grouped;
+
+    *seed = header.seed;
+    *num_patients = header.num_patients;
+    replay_active = 1;
+    log_message(LOG_INFO, "Loaded replay log %s: %ld treatment starts, seed %llu",
+                path, count, (unsigned long long)header.seed);
+    return 0;
+}
+
+int is_replaying() {
+    return replay_active;
+}
+
+// Take a held message if it is the department's recorded next patient
+static int take_expected(DepartmentReplay *replay, Message *msg) {
+    if (replay->next >= replay->count) return 0;
+
+    ReplayRecord *expected = &replay->records[replay->next];
+    for (int i = 0; i < replay->held_count; i++) {
+        Message *held = &replay->held[i];
+        if (held->patient_id == expected->patient_id && held->current_dept_index == expected->hop) {
+            *msg = *held;
+            replay->held[i] = replay->held[--replay->held_count];
+            replay->next++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Next message a department should serve: the recorded order while the log
+// lasts, then arrival order. Returns 0 when the recorded order was followed,
+// 1 when it could not be, or -1 on a receive error.
+int next_replayed_message(int msg_queue_id, DepartmentType dept, Message *msg) {
+    DepartmentReplay *replay = &replays[dept];
+
+    while (1) {
+        if (take_expected(replay, msg)) return 0;
+
+        // Log exhausted or out of room: fall back to arrival order
+        if ((replay->next >= replay->count || replay->held_count == MAX_HELD_MESSAGES) &&
+            replay->held_count > 0) {
+            *msg = replay->held[0];
+            replay->held[0] = replay->held[--replay->held_count];
+            return 1;
+        }
+
+        Message incoming;
+        if (receive_message_from_department(msg_queue_id, dept, &incoming, 1) != 0) {
+            return -1;
+        }
+        if (incoming.patient_id == SHUTDOWN_PATIENT_ID) {
+            *msg = incoming;
+            return 0;
+        }
+        if (replay->next >= replay->count) {
+            // Not in the recording at all
+            *msg = incoming;
+            return 1;
+        }
+        replay->held[replay->held_count++] = incoming;
+    }
+}
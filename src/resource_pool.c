@@ -0,0 +1,291 @@
+#include "resource_pool.h"
+#include "department.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+
+#define POOL_SPEC_LENGTH 512
+#define MAX_POOL_CAPACITY 0xFFFF   // Largest resource gate
+
+// Plan of the simulation being set up; the default one until applied
+static ResourcePlan active_plan;
+static int plan_ready = 0;
+
+// Every department with a pool of its own, as the hospital is staffed
+void init_resource_plan(ResourcePlan *plan) {
+    init_department_configs();
+    memset(plan, 0, sizeof(ResourcePlan));
+    plan->num_pools = NUM_DEPARTMENTS;
+    plan->shift_cycle = DEFAULT_SHIFT_CYCLE;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        strncpy(plan->names[d], get_department_name((DepartmentType)d), MAX_POOL_NAME - 1);
+        plan->capacity[d] = department_configs[d].resource_count;
+        plan->needs[d] = 1u << d;
+    }
+}
+
+static int find_pool(const ResourcePlan *plan, const char *name) {
+    for (int p = 0; p < plan->num_pools; p++) {
+        if (strcasecmp(plan->names[p], name) == 0) return p;
+    }
+    return -1;
+}
+
+static int valid_pool_name(const char *name) {
+    size_t length = strlen(name);
+    if (length == 0 || length >= MAX_POOL_NAME) return 0;
+    for (size_t i = 0; i < length; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') return 0;
+    }
+    return 1;
+}
+
+// "doctors=5,technicians=2": add pools, or resize existing ones (a
+// department's own pool is named after it). Returns -1 if malformed or full.
+int parse_pool_spec(ResourcePlan *plan, const char *spec) {
+    char text[POOL_SPEC_LENGTH];
+    if (strlen(spec) >= sizeof(text)) return -1;
+    strcpy(text, spec);
+
+    char *save = NULL;
+    for (char *item = strtok_r(text, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char *equals = strchr(item, '=');
+        if (!equals) return -1;
+        *equals = '\0';
+
+        char *end;
+        long capacity = strtol(equals + 1, &end, 10);
+        if (end == equals + 1 || *end != '\0' || capacity < 1 || capacity > MAX_POOL_CAPACITY) return -1;
+        if (!valid_pool_name(item)) return -1;
+
+        int pool = find_pool(plan, item);
+        if (pool < 0) {
+            if (plan->num_pools == MAX_RESOURCE_POOLS) return -1;
+            pool = plan->num_pools++;
+            strcpy(plan->names[pool], item);
+        }
+        plan->capacity[pool] = (int)capacity;
+    }
+    return 0;
+}
+
+// "Emergency=doctors,Radiology=Radiology+technicians": the pools each named
+// department draws from, replacing its own. Pools must already be defined.
+int parse_needs_spec(ResourcePlan *plan, const char *spec) {
+    char text[POOL_SPEC_LENGTH];
+    if (strlen(spec) >= sizeof(text)) return -1;
+    strcpy(text, spec);
+
+    char *save = NULL;
+    for (char *item = strtok_r(text, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char *equals = strchr(item, '=');
+        if (!equals) return -1;
+        *equals = '\0';
+
+        int dept = 0;
+        while (dept < NUM_DEPARTMENTS && strcasecmp(item, get_department_name((DepartmentType)dept)) != 0) {
+            dept++;
+        }
+        if (dept == NUM_DEPARTMENTS) return -1;
+
+        uint32_t needs = 0;
+        char *pool_save = NULL;
+        for (char *name = strtok_r(equals + 1, "+", &pool_save); name; name = strtok_r(NULL, "+", &pool_save)) {
+            int pool = find_pool(plan, name);
+            if (pool < 0) return -1;
+            needs |= 1u << pool;
+        }
+        if (needs == 0) return -1;
+        plan->needs[dept] = needs;
+    }
+    return 0;
+}
+
+// Seconds into the cycle from "HH:MM", "HH:MM:SS" or plain seconds; -1 if malformed
+static double parse_shift_time(const char *text) {
+    char *end;
+    double seconds = strtod(text, &end);
+    if (end == text || !(seconds >= 0.0)) return -1.0;
+    if (*end == '\0') return seconds;
+
+    // Clock time: whole hours, minutes and seconds
+    long hours = strtol(text, &end, 10);
+    if (*end != ':' || hours > 9999) return -1.0;
+    char *minutes_text = end + 1;
+    long minutes = strtol(minutes_text, &end, 10);
+    if (end - minutes_text != 2 || minutes > 59) return -1.0;
+    long secs = 0;
+    if (*end == ':') {
+        char *secs_text = end + 1;
+        secs = strtol(secs_text, &end, 10);
+        if (end - secs_text != 2 || secs > 59) return -1.0;
+    }
+    if (*end != '\0') return -1.0;
+    return hours * 3600.0 + minutes * 60.0 + secs;
+}
+
+// "OPD=08:00=3,16:00=1": a pool's staffing from each time of the cycle on.
+// Times must ascend and lie within the cycle; a pool may be unstaffed for
+// part of it but not all of it. Returns -1 if malformed.
+int parse_shift_spec(ResourcePlan *plan, const char *spec) {
+    char text[POOL_SPEC_LENGTH];
+    if (strlen(spec) >= sizeof(text)) return -1;
+    strcpy(text, spec);
+
+    char *equals = strchr(text, '=');
+    if (!equals) return -1;
+    *equals = '\0';
+    int pool = find_pool(plan, text);
+    if (pool < 0) return -1;
+
+    ShiftSchedule schedule;
+    memset(&schedule, 0, sizeof(schedule));
+    int peak = 0;
+    char *save = NULL;
+    for (char *item = strtok_r(equals + 1, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char *split = strrchr(item, '=');
+        if (!split || schedule.num_changes == MAX_SHIFT_CHANGES) return -1;
+        *split = '\0';
+
+        double start = parse_shift_time(item);
+        char *end;
+        long capacity = strtol(split + 1, &end, 10);
+        if (start < 0.0 || start >= plan->shift_cycle || end == split + 1 || *end != '\0' ||
+            capacity < 0 || capacity > MAX_POOL_CAPACITY) return -1;
+        if (schedule.num_changes > 0 && start <= schedule.start[schedule.num_changes - 1]) return -1;
+
+        schedule.start[schedule.num_changes] = start;
+        schedule.capacity[schedule.num_changes++] = (int)capacity;
+        if (capacity > peak) peak = (int)capacity;
+    }
+    if (peak == 0) return -1;
+
+    plan->shifts[pool] = schedule;
+    plan->capacity[pool] = peak;
+    return 0;
+}
+
+int has_shift_schedules(const ResourcePlan *plan) {
+    for (int p = 0; p < plan->num_pools; p++) {
+        if (plan->shifts[p].num_changes > 0) return 1;
+    }
+    return 0;
+}
+
+// Units of a pool at a time of the shift clock
+int scheduled_capacity(const ResourcePlan *plan, int pool, double clock) {
+    const ShiftSchedule *schedule = &plan->shifts[pool];
+    if (schedule->num_changes == 0) return plan->capacity[pool];
+
+    double offset = fmod(clock, plan->shift_cycle);
+    if (offset < 0.0) offset += plan->shift_cycle;
+    int current = schedule->num_changes - 1;   // Before the first change: the cycle's last shift
+    for (int i = 0; i < schedule->num_changes && schedule->start[i] <= offset; i++) {
+        current = i;
+    }
+    return schedule->capacity[current];
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// FNV-1a over what decides the DES state: capacities, needs and schedules
+uint64_t resource_plan_digest(const ResourcePlan *plan) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    hash = hash_bytes(hash, &plan->num_pools, sizeof(plan->num_pools));
+    hash = hash_bytes(hash, plan->capacity, sizeof(int) * plan->num_pools);
+    hash = hash_bytes(hash, plan->needs, sizeof(plan->needs));
+    hash = hash_bytes(hash, &plan->shift_cycle, sizeof(plan->shift_cycle));
+    for (int p = 0; p < plan->num_pools; p++) {
+        const ShiftSchedule *schedule = &plan->shifts[p];
+        hash = hash_bytes(hash, &schedule->num_changes, sizeof(int));
+        hash = hash_bytes(hash, schedule->start, sizeof(double) * schedule->num_changes);
+        hash = hash_bytes(hash, schedule->capacity, sizeof(int) * schedule->num_changes);
+    }
+    return hash;
+}
+
+// True if every department still uses only its own, unresized pool
+int is_default_resource_plan(const ResourcePlan *plan) {
+    ResourcePlan staffed;
+    init_resource_plan(&staffed);
+    if (plan->num_pools != staffed.num_pools) return 0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        if (plan->needs[d] != staffed.needs[d] || plan->capacity[d] != staffed.capacity[d]) return 0;
+    }
+    return !has_shift_schedules(plan);
+}
+
+// Patients a department can treat at once: its scarcest pool's units
+int pooled_capacity(const ResourcePlan *plan, DepartmentType dept) {
+    int capacity = MAX_POOL_CAPACITY;
+    for (int p = 0; p < plan->num_pools; p++) {
+        if (((plan->needs[dept] >> p) & 1) && plan->capacity[p] < capacity) {
+            capacity = plan->capacity[p];
+        }
+    }
+    return capacity;
+}
+
+// Patients a department can treat at once at a time of the shift clock
+static int pooled_capacity_at(const ResourcePlan *plan, DepartmentType dept, double clock) {
+    int capacity = MAX_POOL_CAPACITY;
+    for (int p = 0; p < plan->num_pools; p++) {
+        int units = scheduled_capacity(plan, p, clock);
+        if (((plan->needs[dept] >> p) & 1) && units < capacity) {
+            capacity = units;
+        }
+    }
+    return capacity;
+}
+
+// First department (or -1) that no time of the cycle has every pool it
+// needs staffed; its patients would wait forever
+int unstaffed_department(const ResourcePlan *plan) {
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        int staffed = 0;
+        for (int p = -1; p < plan->num_pools && !staffed; p++) {
+            // Candidate times: the start of the cycle and every change
+            int changes = p < 0 ? 1 : plan->shifts[p].num_changes;
+            for (int i = 0; i < changes && !staffed; i++) {
+                double clock = p < 0 ? 0.0 : plan->shifts[p].start[i];
+                staffed = pooled_capacity_at(plan, (DepartmentType)d, clock) > 0;
+            }
+        }
+        if (!staffed) return d;
+    }
+    return -1;
+}
+
+// Departments (bit per department, itself included) whose patients may be
+// able to start when one of this department's treatments ends
+uint32_t pool_sharers(const ResourcePlan *plan, DepartmentType dept) {
+    uint32_t sharers = 0;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        if (plan->needs[d] & plan->needs[dept]) {
+            sharers |= 1u << d;
+        }
+    }
+    return sharers;
+}
+
+// Make a plan the one get_resource_plan() and department capacities follow
+void apply_resource_plan(const ResourcePlan *plan) {
+    active_plan = *plan;
+    plan_ready = 1;
+}
+
+const ResourcePlan* get_resource_plan() {
+    if (!plan_ready) {
+        init_resource_plan(&active_plan);
+        plan_ready = 1;
+    }
+    return &active_plan;
+}
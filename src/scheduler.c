@@ -2,9 +2,151 @@
 #include "logger.h"
 #include "department.h"
 #include "message_queue.h"
+#include "profiler.h"
+#include "patient_export.h"
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 
+// Take discharge times from completions' simulated clock instead of time()
+static int simulated_clock = 0;
+
+void use_simulated_clock(int enabled) {
+    simulated_clock = enabled;
+}
+
+// Count forwarded patients as waiting at their next department (none in the bench)
+static HospitalState *hospital_state = NULL;
+
+void use_hospital_state(HospitalState *state) {
+    hospital_state = state;
+}
+
+// Dispatch credits of one department. At most dispatch_credits patients are
+// sent to it and not yet returned, so its share of the dispatch and return
+// queues is bounded and neither side ever blocks on a full queue. Patients
+// beyond that are held here, oldest first, until a completion frees a credit.
+typedef struct {
+    int in_flight;
+    SchedulerNode *backlog;
+    SchedulerNode *backlog_tail;
+    int backlog_length;
+    int max_backlog;
+    long deferred;
+    double backpressure_since;   // hospital_clock() when the backlog last filled
+    double backpressure_time;    // Seconds with a backlog
+} DispatchFlow;
+
+static DispatchFlow flows[NUM_DEPARTMENTS];
+static int dispatch_credits = 0;   // 0 = no flow control (the bench)
+static double flow_start = 0.0;
+
+// Give every department its credits for a run; patients held from an
+// earlier run are dropped
+void init_dispatch_flow(int credits) {
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        while (flows[d].backlog) {
+            SchedulerNode *node = flows[d].backlog;
+            flows[d].backlog = node->next;
+            free(node);
+        }
+    }
+    memset(flows, 0, sizeof(flows));
+    dispatch_credits = credits;
+    flow_start = hospital_clock();
+}
+
+static void send_to_department(int msg_queue_id, DepartmentType dept, Patient *patient) {
+    flows[dept].in_flight++;
+    send_message_to_department(msg_queue_id, dept, patient);
+    patient->current_dept_index++;
+}
+
+// Send a patient to its next department, or hold it there if the department
+// has no credit left. It counts as waiting at the department either way.
+void dispatch_patient(int msg_queue_id, DepartmentType dept, Patient *patient) {
+    DispatchFlow *flow = &flows[dept];
+    change_department_occupancy(hospital_state, dept, 0, 1);
+    
+    if (dispatch_credits == 0 || (flow->backlog == NULL && flow->in_flight < dispatch_credits)) {
+        send_to_department(msg_queue_id, dept, patient);
+        return;
+    }
+    
+    SchedulerNode *node = (SchedulerNode*)malloc(sizeof(SchedulerNode));
+    if (!node) {
+        log_message(LOG_ERROR, "Failed to hold Patient %d for %s, sending it now",
+                    patient->id, get_department_name(dept));
+        send_to_department(msg_queue_id, dept, patient);
+        return;
+    }
+    node->patient = patient;
+    node->enqueue_time = time(NULL);
+    node->next = NULL;
+    
+    if (flow->backlog == NULL) {
+        flow->backlog = node;
+        flow->backpressure_since = hospital_clock();
+    } else {
+        flow->backlog_tail->next = node;
+    }
+    flow->backlog_tail = node;
+    flow->deferred++;
+    if (++flow->backlog_length > flow->max_backlog) {
+        flow->max_backlog = flow->backlog_length;
+    }
+    log_message(LOG_DEBUG, "Patient %d held for %s (no dispatch credit)", patient->id, get_department_name(dept));
+}
+
+// A department returned a patient: send the patients held for it while it has credits
+static void return_dispatch_credit(int msg_queue_id, DepartmentType dept) {
+    DispatchFlow *flow = &flows[dept];
+    if (flow->in_flight > 0) {
+        flow->in_flight--;
+    }
+    
+    while (flow->backlog && flow->in_flight < dispatch_credits) {
+        SchedulerNode *node = flow->backlog;
+        flow->backlog = node->next;
+        flow->backlog_length--;
+        if (flow->backlog == NULL) {
+            flow->backlog_tail = NULL;
+            flow->backpressure_time += hospital_clock() - flow->backpressure_since;
+        }
+        
+        // Time held counts as waiting on the wall clock; the simulated clock
+        // already measures it from the patient's ready time
+        Patient *patient = node->patient;
+        if (!simulated_clock) {
+            patient->total_waiting_time += difftime(time(NULL), node->enqueue_time);
+        }
+        free(node);
+        send_to_department(msg_queue_id, dept, patient);
+    }
+}
+
+// Backpressure counters of the run so far, per department
+void add_dispatch_metrics(GlobalMetrics *metrics) {
+    metrics->dispatch_credits = dispatch_credits;
+    double now = hospital_clock();
+    double duration = now - flow_start;
+    
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        DispatchFlow *flow = &flows[d];
+        DepartmentUtilization *department = &metrics->departments[d];
+        double backpressure = flow->backpressure_time + (flow->backlog ? now - flow->backpressure_since : 0.0);
+        
+        department->deferred_dispatches = flow->deferred;
+        department->max_dispatch_backlog = flow->max_backlog;
+        department->backpressure_fraction = duration > 0.0 ? backpressure / duration : 0.0;
+        if (hospital_state) {
+            department->blocked_completions = __atomic_load_n(&hospital_state->blocked_completions[d],
+                                                              __ATOMIC_RELAXED);
+        }
+    }
+}
+
 // Enqueue patient to ready queue (FCFS)
 void enqueue_patient(SchedulerNode **queue, Patient *patient) {
     SchedulerNode *new_node = (SchedulerNode*)malloc(sizeof(SchedulerNode));
@@ -75,64 +217,99 @@ void fcfs_scheduler(SchedulerNode **ready_queue, int msg_queue_id) {
     }
     
     // Send patient to next department
-    send_message_to_department(msg_queue_id, next_dept, patient);
-    patient->current_dept_index++;
+    dispatch_patient(msg_queue_id, next_dept, patient);
+}
+
+// Start a run's message scheduler with no patients arrived yet
+void init_message_scheduler(MessageScheduler *scheduler, int msg_queue_id, int return_queue_id,
+                            Patient **all_patients, DischargeTotals *totals, PatientMetrics *kept) {
+    memset(scheduler, 0, sizeof(MessageScheduler));
+    scheduler->msg_queue_id = msg_queue_id;
+    scheduler->return_queue_id = return_queue_id;
+    scheduler->all_patients = all_patients;
+    scheduler->totals = totals;
+    scheduler->kept = kept;
 }
 
-// Round Robin Message Scheduler
-void round_robin_message_scheduler(int msg_queue_id, Patient **all_patients, int num_patients) {
+// Credit the department, then discharge the patient or send it on
+static void handle_completion(MessageScheduler *scheduler, const Message *completion) {
+    if (completion->msg_type >= 1 && completion->msg_type <= NUM_DEPARTMENTS) {
+        return_dispatch_credit(scheduler->msg_queue_id, (DepartmentType)(completion->msg_type - 1));
+    }
+    
+    // Find the patient
+    Patient *patient = NULL;
+    {
+        PROFILE_SCOPE(PROF_SCHEDULER_LOOKUP);
+        if (completion->patient_id >= 1 && completion->patient_id <= scheduler->num_patients) {
+            patient = scheduler->all_patients[completion->patient_id - 1];
+        }
+    }
+    if (!patient) return;
+    
+    patient->total_waiting_time += completion->waiting_time;
+    patient->total_treatment_time += completion->treatment_time;
+    patient->ready_time = completion->sim_time + TIME_QUANTUM / 1e6;
+    
+    DepartmentType next_dept = get_next_department(patient);
+    
+    if (next_dept == (DepartmentType)-1) {
+        // Patient completed
+        patient->completed = 1;
+        patient->discharge_time = simulated_clock ? (time_t)completion->sim_time : time(NULL);
+        
+        PatientRecord record = { difftime(patient->arrival_time, scheduler->start),
+                                 difftime(patient->discharge_time, scheduler->start),
+                                 patient->total_waiting_time, patient->total_treatment_time,
+                                 patient->id, patient->route_type, 0, {0} };
+        export_patient(&record);
+        if (scheduler->totals) {
+            add_discharge_totals(scheduler->totals, &record);
+        }
+        if (scheduler->kept) {
+            record_patient_result(&scheduler->kept[patient->id - 1], patient);
+        }
+        log_message(LOG_INFO, "Patient %d completed all treatments", patient->id);
+        
+        scheduler->all_patients[patient->id - 1] = NULL;
+        free(patient);
+        scheduler->discharged++;
+    } else {
+        // Send to next department
+        usleep(TIME_QUANTUM);  // Time quantum delay (Round Robin)
+        dispatch_patient(scheduler->msg_queue_id, next_dept, patient);
+    }
+}
+
+// Handle the completions already returned without waiting for more, so
+// patients are discharged while later ones are still arriving
+void poll_message_scheduler(MessageScheduler *scheduler) {
+    Message completion;
+    while (receive_completion_message(scheduler->return_queue_id, &completion, 0) == 0) {
+        handle_completion(scheduler, &completion);
+    }
+}
+
+// Round Robin Message Scheduler: completions arrive on the return queue and
+// patients leave on the dispatch queue, which may be the same queue. Runs
+// until every patient arrived so far is discharged.
+void round_robin_message_scheduler(MessageScheduler *scheduler) {
     log_message(LOG_INFO, "Round Robin message scheduler started");
     
     int department_turn = 0;  // Round robin among departments
     int messages_processed = 0;
-    int max_iterations = num_patients * 10;  // Safety limit
+    int max_iterations = scheduler->num_patients * 10;  // Safety limit
     
-    while (messages_processed < max_iterations) {
+    while (scheduler->discharged < scheduler->num_patients && messages_processed < max_iterations) {
         // Try to receive completion message from any department
-        MessageBuffer msg_buf;
-        ssize_t result = msgrcv(msg_queue_id, &msg_buf, sizeof(Message), 
-                               NUM_DEPARTMENTS + 1, IPC_NOWAIT);
+        Message completion;
         
-        if (result != -1) {
+        // Block until a department finishes a treatment; the last one ends the run
+        if (receive_completion_message(scheduler->return_queue_id, &completion, 1) == 0) {
             messages_processed++;
-            
-            // Find the patient and update
-            for (int i = 0; i < num_patients; i++) {
-                if (all_patients[i]->id == msg_buf.data.patient_id) {
-                    Patient *patient = all_patients[i];
-                    
-                    DepartmentType next_dept = get_next_department(patient);
-                    
-                    if (next_dept == (DepartmentType)-1) {
-                        // Patient completed
-                        patient->completed = 1;
-                        patient->discharge_time = time(NULL);
-                        log_message(LOG_INFO, "Patient %d completed all treatments", patient->id);
-                    } else {
-                        // Send to next department
-                        usleep(TIME_QUANTUM);  // Time quantum delay (Round Robin)
-                        send_message_to_department(msg_queue_id, next_dept, patient);
-                        patient->current_dept_index++;
-                    }
-                    break;
-                }
-            }
-        } else {
-            // No message available, small delay
-            usleep(50000);  // 50ms
-        }
-        
-        // Check if all patients completed
-        int all_done = 1;
-        for (int i = 0; i < num_patients; i++) {
-            if (!all_patients[i]->completed) {
-                all_done = 0;
-                break;
-            }
-        }
-        
-        if (all_done) {
-            log_message(LOG_INFO, "All patients completed treatment");
+            handle_completion(scheduler, &completion);
+        } else if (errno != EINTR) {
+            log_message(LOG_ERROR, "Message scheduler stopped: completion queue unavailable");
             break;
         }
         
@@ -140,5 +317,8 @@ void round_robin_message_scheduler(int msg_queue_id, Patient **all_patients, int
         department_turn = (department_turn + 1) % NUM_DEPARTMENTS;
     }
     
+    if (scheduler->discharged == scheduler->num_patients) {
+        log_message(LOG_INFO, "All patients completed treatment");
+    }
     log_message(LOG_INFO, "Message scheduler finished");
 }
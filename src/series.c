@@ -0,0 +1,241 @@
+#include "series.h"
+#include "department.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SERIES_COLUMNS (NUM_SERIES_METRICS * NUM_DEPARTMENTS)
+
+static const char *metric_names[NUM_SERIES_METRICS] = { "queue", "busy", "completed" };
+
+// Where one chunk's columns live in the file, for the CSV export
+typedef struct {
+    int64_t first_row;
+    uint32_t rows;
+    long offset;
+} SeriesChunkIndex;
+
+// Create a series file; chunks are appended as sources fill them
+int open_series(const char *path, double interval, SeriesWriter *writer) {
+    memset(writer, 0, sizeof(SeriesWriter));
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        perror("open series");
+        return -1;
+    }
+
+    SeriesFileHeader *header = &writer->header;
+    memcpy(header->magic, SERIES_MAGIC, sizeof(header->magic));
+    header->version = SERIES_VERSION;
+    header->header_size = sizeof(SeriesFileHeader);
+    header->chunk_header_size = sizeof(SeriesChunkHeader);
+    header->num_metrics = NUM_SERIES_METRICS;
+    header->num_departments = NUM_DEPARTMENTS;
+    header->chunk_rows = SERIES_CHUNK_ROWS;
+    header->interval = interval;
+    fwrite(header, sizeof(SeriesFileHeader), 1, writer->file);
+
+    writer->first_row = -1;
+    pthread_mutex_init(&writer->mutex, NULL);
+    return 0;
+}
+
+// Record the row and chunk counts in the header and close the file
+int close_series(SeriesWriter *writer) {
+    if (!writer->file) return 0;
+
+    if (writer->first_row >= 0) {
+        writer->header.num_rows = writer->end_row - writer->first_row;
+    }
+    fseek(writer->file, 0, SEEK_SET);
+    fwrite(&writer->header, sizeof(SeriesFileHeader), 1, writer->file);
+    int result = writer->failed || ferror(writer->file) ? -1 : 0;
+    if (fclose(writer->file) != 0) {
+        result = -1;
+    }
+    pthread_mutex_destroy(&writer->mutex);
+    writer->file = NULL;
+
+    if (result != 0) {
+        fprintf(stderr, "Failed to write the time series\n");
+    }
+    return result;
+}
+
+int init_series_buffer(SeriesBuffer *buffer) {
+    buffer->first_row = 0;
+    buffer->rows = 0;
+    buffer->columns = (int64_t*)calloc((size_t)SERIES_COLUMNS * SERIES_CHUNK_ROWS, sizeof(int64_t));
+    return buffer->columns ? 0 : -1;
+}
+
+void free_series_buffer(SeriesBuffer *buffer) {
+    free(buffer->columns);
+    buffer->columns = NULL;
+    buffer->rows = 0;
+}
+
+// Append one source's chunk; rows are laid out column by column
+void flush_series_buffer(SeriesWriter *writer, SeriesBuffer *buffer, int source) {
+    if (buffer->rows == 0) return;
+
+    SeriesChunkHeader chunk = { buffer->first_row, buffer->rows, (uint32_t)source };
+    pthread_mutex_lock(&writer->mutex);
+    fwrite(&chunk, sizeof(chunk), 1, writer->file);
+    for (int c = 0; c < SERIES_COLUMNS; c++) {
+        if (fwrite(buffer->columns + (size_t)c * SERIES_CHUNK_ROWS, sizeof(int64_t), buffer->rows,
+                   writer->file) != buffer->rows) {
+            writer->failed = 1;
+        }
+    }
+    writer->header.num_chunks++;
+    if (writer->first_row < 0 || buffer->first_row < writer->first_row) {
+        writer->first_row = buffer->first_row;
+    }
+    if (buffer->first_row + buffer->rows > writer->end_row) {
+        writer->end_row = buffer->first_row + buffer->rows;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+
+    buffer->rows = 0;
+}
+
+// Add a sample to a source's chunk, writing the chunk out once it is full.
+// A source's rows must be consecutive.
+void append_series_row(SeriesWriter *writer, SeriesBuffer *buffer, int source, int64_t row,
+                       const int64_t values[NUM_SERIES_METRICS][NUM_DEPARTMENTS]) {
+    if (buffer->rows == 0) {
+        buffer->first_row = row;
+    }
+    for (int m = 0; m < NUM_SERIES_METRICS; m++) {
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            buffer->columns[(size_t)(m * NUM_DEPARTMENTS + d) * SERIES_CHUNK_ROWS + buffer->rows] = values[m][d];
+        }
+    }
+    if (++buffer->rows == SERIES_CHUNK_ROWS) {
+        flush_series_buffer(writer, buffer, source);
+    }
+}
+
+static int compare_chunks(const void *a, const void *b) {
+    const SeriesChunkIndex *x = (const SeriesChunkIndex*)a;
+    const SeriesChunkIndex *y = (const SeriesChunkIndex*)b;
+    return (x->first_row > y->first_row) - (x->first_row < y->first_row);
+}
+
+// Read every chunk header; the columns themselves are read during the export
+static SeriesChunkIndex* index_series(FILE *file, const char *path, const SeriesFileHeader *header) {
+    const char *problem = NULL;
+    if (memcmp(header->magic, SERIES_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a time-series file";
+    } else if (header->version != SERIES_VERSION) {
+        problem = "unsupported time-series version";
+    } else if (header->header_size != sizeof(SeriesFileHeader) ||
+               header->chunk_header_size != sizeof(SeriesChunkHeader) ||
+               header->num_metrics != NUM_SERIES_METRICS || header->num_departments != NUM_DEPARTMENTS ||
+               header->chunk_rows != SERIES_CHUNK_ROWS) {
+        problem = "layout differs from this build";
+    } else if (header->num_chunks < 0 || header->interval <= 0.0) {
+        problem = "corrupt header";
+    }
+    if (problem) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        return NULL;
+    }
+
+    SeriesChunkIndex *index = (SeriesChunkIndex*)calloc(header->num_chunks + 1, sizeof(SeriesChunkIndex));
+    if (!index) return NULL;
+
+    for (int64_t i = 0; i < header->num_chunks; i++) {
+        SeriesChunkHeader chunk;
+        if (fread(&chunk, sizeof(chunk), 1, file) != 1 || chunk.rows == 0 || chunk.rows > SERIES_CHUNK_ROWS) {
+            fprintf(stderr, "%s: truncated or corrupt chunk %lld\n", path, (long long)i);
+            free(index);
+            return NULL;
+        }
+        index[i].first_row = chunk.first_row;
+        index[i].rows = chunk.rows;
+        index[i].offset = ftell(file);
+        fseek(file, (long)(sizeof(int64_t) * SERIES_COLUMNS * chunk.rows), SEEK_CUR);
+    }
+    qsort(index, header->num_chunks, sizeof(SeriesChunkIndex), compare_chunks);
+    return index;
+}
+
+// Write a series file as CSV, one line per sample with the sources summed.
+// Only one chunk of rows is held in memory at a time.
+int export_series_csv(const char *path, FILE *output) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror("open series");
+        return -1;
+    }
+
+    SeriesFileHeader header;
+    SeriesChunkIndex *index = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1) {
+        index = index_series(file, path, &header);
+    } else {
+        fprintf(stderr, "%s: not a time-series file\n", path);
+    }
+    int64_t *sum = (int64_t*)malloc(sizeof(int64_t) * SERIES_COLUMNS * SERIES_CHUNK_ROWS);
+    int64_t *column = (int64_t*)malloc(sizeof(int64_t) * SERIES_CHUNK_ROWS);
+    if (!index || !sum || !column) {
+        free(index);
+        free(sum);
+        free(column);
+        fclose(file);
+        return -1;
+    }
+
+    fprintf(output, "time");
+    for (int m = 0; m < NUM_SERIES_METRICS; m++) {
+        for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+            fprintf(output, ",%s_%s", get_department_name((DepartmentType)d), metric_names[m]);
+        }
+    }
+    fprintf(output, "\n");
+
+    int status = 0;
+    for (int64_t group = 0; group < header.num_chunks && status == 0; ) {
+        int64_t first_row = index[group].first_row;
+        uint32_t rows = index[group].rows;
+        memset(sum, 0, sizeof(int64_t) * SERIES_COLUMNS * SERIES_CHUNK_ROWS);
+
+        // Every source's chunk covering these rows
+        int64_t next = group;
+        for (; next < header.num_chunks && index[next].first_row == first_row; next++) {
+            if (index[next].rows != rows) {
+                fprintf(stderr, "%s: sources disagree on rows from sample %lld\n", path, (long long)first_row);
+                status = -1;
+                break;
+            }
+            fseek(file, index[next].offset, SEEK_SET);
+            for (int c = 0; c < SERIES_COLUMNS && status == 0; c++) {
+                if (fread(column, sizeof(int64_t), rows, file) != rows) {
+                    fprintf(stderr, "%s: truncated chunk\n", path);
+                    status = -1;
+                }
+                for (uint32_t r = 0; r < rows && status == 0; r++) {
+                    sum[(size_t)c * SERIES_CHUNK_ROWS + r] += column[r];
+                }
+            }
+        }
+        if (status != 0) break;
+
+        for (uint32_t r = 0; r < rows; r++) {
+            fprintf(output, "%.3f", (first_row + r) * header.interval);
+            for (int c = 0; c < SERIES_COLUMNS; c++) {
+                fprintf(output, ",%lld", (long long)sum[(size_t)c * SERIES_CHUNK_ROWS + r]);
+            }
+            fprintf(output, "\n");
+        }
+        group = next;
+    }
+
+    free(index);
+    free(sum);
+    free(column);
+    fclose(file);
+    return status;
+}
@@ -1,15 +1,24 @@
 #include "shared_memory.h"
 #include "logger.h"
+#include "department.h"
+#include "ipc_namespace.h"
+#include <stdio.h>
+#include <errno.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-// Create shared memory segment
+// Create this instance's shared memory segment
 int create_shared_memory() {
-    int shm_id = shmget(SHM_KEY, sizeof(HospitalState), IPC_CREAT | 0666);
+    int shm_id = shmget(instance_ipc_key(IPC_OBJECT_STATE), sizeof(HospitalState), IPC_CREAT | IPC_EXCL | 0600);
     if (shm_id == -1) {
-        log_message(LOG_ERROR, "Failed to create shared memory");
+        if (errno == EEXIST) {
+            fprintf(stderr, "IPC instance %s is already in use (running, or left behind: make clean-ipc)\n",
+                    get_ipc_instance());
+        }
+        log_message(LOG_ERROR, "Failed to create shared memory: %s", strerror(errno));
         return -1;
     }
     
@@ -51,9 +60,19 @@ void init_hospital_state(HospitalState *state) {
     state->total_patients = 0;
     state->completed_patients = 0;
     state->patients_in_system = 0;
+    state->seed = 0;
+    state->simulated_clock = 0;
+    state->treatment_sequence = 0;
+    state->replay_divergences = 0;
+    state->run_generation = 0;
+    init_latch(&state->departments_ready);
     
     for (int i = 0; i < NUM_DEPARTMENTS; i++) {
         state->active_patients[i] = 0;
+        state->waiting_patients[i] = 0;
+        state->max_waiting_patients[i] = 0;
+        state->blocked_completions[i] = 0;
+        init_occupancy(&state->occupancy[i], 0.0);
     }
     
     // Initialize mutex with process-shared attribute
@@ -65,3 +84,74 @@ void init_hospital_state(HospitalState *state) {
     
     log_message(LOG_INFO, "Hospital state initialized in shared memory");
 }
+
+// Clear the per-run counters for another run with the same departments.
+// Only called while every department is idle.
+void reset_hospital_state(HospitalState *state) {
+    if (!state) return;
+    
+    lock_mutex(&state->mutex);
+    state->total_patients = 0;
+    state->completed_patients = 0;
+    state->patients_in_system = 0;
+    for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+        state->active_patients[i] = 0;
+        state->waiting_patients[i] = 0;
+        state->max_waiting_patients[i] = 0;
+        __atomic_store_n(&state->blocked_completions[i], 0, __ATOMIC_RELAXED);
+    }
+    for (int p = 0; p < state->num_pools; p++) {
+        state->pool_in_use[p] = 0;
+    }
+    __atomic_store_n(&state->treatment_sequence, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&state->replay_divergences, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&state->run_generation, 1, __ATOMIC_RELEASE);
+    unlock_mutex(&state->mutex);
+}
+
+// Seconds on the monotonic clock, comparable between the scheduler and
+// department processes
+double hospital_clock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Start every department's occupancy accounting at the first dispatch
+void start_department_occupancy(HospitalState *state) {
+    if (!state) return;
+    
+    lock_mutex(&state->mutex);
+    double now = hospital_clock();
+    for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+        init_occupancy(&state->occupancy[i], now);
+    }
+    for (int p = 0; p < state->num_pools; p++) {
+        init_occupancy(&state->pool_occupancy[p], now);
+    }
+    unlock_mutex(&state->mutex);
+}
+
+// Credit a department's current levels up to now, then apply a change:
+// +1 waiting when a patient is sent to it, -1 waiting +1 busy when treatment
+// starts and -1 busy when it ends. Busy patients hold a unit of each of the
+// department's pools.
+void change_department_occupancy(HospitalState *state, DepartmentType dept, int busy_change, int waiting_change) {
+    if (!state) return;
+    
+    lock_mutex(&state->mutex);
+    double now = hospital_clock();
+    advance_occupancy(&state->occupancy[dept], now, state->active_patients[dept],
+                      state->waiting_patients[dept], get_department_resources(dept));
+    for (int p = 0; busy_change != 0 && p < state->num_pools; p++) {
+        if (!((state->pool_needs[dept] >> p) & 1)) continue;
+        advance_occupancy(&state->pool_occupancy[p], now, state->pool_in_use[p], 0, state->gates[p].capacity);
+        state->pool_in_use[p] += busy_change;
+    }
+    state->active_patients[dept] += busy_change;
+    state->waiting_patients[dept] += waiting_change;
+    if (state->waiting_patients[dept] > state->max_waiting_patients[dept]) {
+        state->max_waiting_patients[dept] = state->waiting_patients[dept];
+    }
+    unlock_mutex(&state->mutex);
+}
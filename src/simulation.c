@@ -0,0 +1,585 @@
+#include "simulation.h"
+#include "analytic.h"
+#include "patient.h"
+#include "department.h"
+#include "scheduler.h"
+#include "message_queue.h"
+#include "synchronization.h"
+#include "logger.h"
+#include "profiler.h"
+#include "thread_backend.h"
+#include "executor.h"
+#include "journey.h"
+#include "des.h"
+#include "placement.h"
+#include "random.h"
+#include "replay.h"
+#include "ipc_namespace.h"
+#include "patient_export.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+static int uses_department_workers(const SimConfig *config) {
+    return config->backend == BACKEND_PROCESS || config->backend == BACKEND_THREAD;
+}
+
+// Fork one process per department
+static int start_department_processes(Simulation *sim) {
+    pid_t parent = getpid();
+    fflush(stdout);  // Children must not inherit unflushed output
+
+    for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+        pid_t pid = fork();
+
+        if (pid == 0) {
+            // Child process - department. Cleanup belongs to the parent: a
+            // terminal interrupt is left to it, and the child goes when it does.
+            signal(SIGINT, SIG_IGN);
+            signal(SIGTERM, SIG_DFL);
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != parent) _exit(1);  // Parent died before the line above
+
+            profiler_detach();
+            pin_to_role(i + 1);
+            department_process((DepartmentType)i, sim->msg_queue_id, sim->return_queue_id, sim->shm_id);
+            _exit(0);  // Never run the embedding program's exit handlers
+        } else if (pid > 0) {
+            sim->dept_pids[i] = pid;
+        } else {
+            log_message(LOG_ERROR, "Failed to fork department process");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Credits per department such that every patient in flight, and its
+// completion, fits its queue without a sender ever blocking
+static int fit_dispatch_credits(Simulation *sim) {
+    int dispatch_capacity = message_queue_capacity(sim->msg_queue_id);
+    int return_capacity = message_queue_capacity(sim->return_queue_id);
+    if (dispatch_capacity < 0 || return_capacity < 0) return -1;
+    
+    // Shutdown messages share the dispatch queue
+    int capacity = dispatch_capacity - NUM_DEPARTMENTS < return_capacity ?
+                   dispatch_capacity - NUM_DEPARTMENTS : return_capacity;
+    int credits = sim->config.dispatch_credits;
+    if (credits > capacity / NUM_DEPARTMENTS) {
+        credits = capacity / NUM_DEPARTMENTS;
+        log_message(LOG_WARNING, "Dispatch credits lowered to %d to fit the message queues", credits);
+    }
+    if (credits < 1) {
+        fprintf(stderr, "Message queues too small for one patient per department\n");
+        return -1;
+    }
+    return credits;
+}
+
+// One gate per resource pool, sized to the pool. Departments read which
+// pools they need from the state, so forked workers need nothing else.
+static int init_resource_gates(HospitalState *hospital_state, const ResourcePlan *plan) {
+    hospital_state->num_pools = plan->num_pools;
+    for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+        hospital_state->pool_needs[d] = plan->needs[d];
+    }
+    for (int p = 0; p < plan->num_pools; p++) {
+        if (init_semaphore(&hospital_state->gates[p], plan->capacity[p]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Create the hospital state, queues and gates, then start the department workers
+static int start_department_workers(Simulation *sim) {
+    SimConfig *config = &sim->config;
+    log_message(LOG_INFO, "Using %s backend", get_backend_name(config->backend));
+
+    // Pin the scheduler first so the hospital state is first touched on its node
+    pin_to_role(PLACEMENT_SCHEDULER_ROLE);
+    sim->memory_node = placement_node_for_role(PLACEMENT_SCHEDULER_ROLE);
+
+    if (config->backend == BACKEND_THREAD) {
+        // Departments share the state directly; no IPC objects are created
+        set_message_transport(TRANSPORT_INPROC);
+        sim->hospital_state = (HospitalState*)calloc(1, sizeof(HospitalState));
+        if (!sim->hospital_state) {
+            fprintf(stderr, "Failed to allocate hospital state\n");
+            return -1;
+        }
+    } else {
+        set_message_transport(TRANSPORT_SYSV);
+        sim->shm_id = create_shared_memory();
+        if (sim->shm_id == -1) {
+            fprintf(stderr, "Failed to create shared memory\n");
+            return -1;
+        }
+
+        sim->hospital_state = attach_shared_memory(sim->shm_id);
+        if (!sim->hospital_state) {
+            fprintf(stderr, "Failed to attach to shared memory\n");
+            return -1;
+        }
+    }
+
+    HospitalState *hospital_state = sim->hospital_state;
+    bind_memory_to_node(hospital_state, sizeof(HospitalState), sim->memory_node);
+    init_hospital_state(hospital_state);
+    hospital_state->seed = config->seed;
+    hospital_state->simulated_clock = config->deterministic;
+    use_simulated_clock(config->deterministic);
+    use_hospital_state(hospital_state);
+
+    // Children inherit the log descriptor, so open it before they start
+    if (config->record_path &&
+        start_replay_recording(config->record_path, config->seed, config->num_patients) != 0) {
+        return -1;
+    }
+    init_profiler(&hospital_state->profile);
+    profiler_attach(&hospital_state->profile, PROF_SCHEDULER_SLOT, "Scheduler");
+
+    sim->msg_queue_id = create_message_queue(instance_ipc_key(IPC_OBJECT_QUEUE));
+    if (sim->msg_queue_id == -1) {
+        fprintf(stderr, "Failed to create message queue\n");
+        return -1;
+    }
+    sim->return_queue_id = create_message_queue(instance_ipc_key(IPC_OBJECT_RETURN));
+    if (sim->return_queue_id == -1) {
+        fprintf(stderr, "Failed to create return queue\n");
+        return -1;
+    }
+    sim->dispatch_credits = fit_dispatch_credits(sim);
+    if (sim->dispatch_credits == -1) {
+        return -1;
+    }
+
+    // Create resource gates (semaphores) for each resource pool in shared memory
+    if (init_resource_gates(hospital_state, &config->resources) != 0) {
+        fprintf(stderr, "Failed to create semaphores\n");
+        return -1;
+    }
+
+    if (!config->quiet) {
+        if (config->backend == BACKEND_THREAD) {
+            printf("✓ Hospital state allocated (thread backend)\n");
+            printf("✓ In-process message and return queues created\n");
+        } else {
+            printf("✓ Shared memory created (IPC instance %s, key 0x%08x)\n",
+                   get_ipc_instance(), (unsigned int)instance_ipc_key(IPC_OBJECT_STATE));
+            printf("✓ Message queue created (key 0x%08x)\n", (unsigned int)instance_ipc_key(IPC_OBJECT_QUEUE));
+            printf("✓ Return queue created (key 0x%08x)\n", (unsigned int)instance_ipc_key(IPC_OBJECT_RETURN));
+        }
+        printf("✓ Dispatch credits: %d patients in flight per department\n", sim->dispatch_credits);
+        printf("✓ Semaphores created:\n");
+        if (is_default_resource_plan(&config->resources)) {
+            printf("  - Emergency: %d doctors\n", EMERGENCY_DOCTORS);
+            printf("  - OPD: %d doctors\n", OPD_DOCTORS);
+            printf("  - Radiology: %d machine\n", RADIOLOGY_MACHINES);
+            printf("  - Pharmacy: %d pharmacists\n", PHARMACY_PHARMACISTS);
+            printf("  - Billing: %d cashier\n\n", BILLING_CASHIERS);
+        } else {
+            const ResourcePlan *plan = &config->resources;
+            for (int p = 0; p < plan->num_pools; p++) {
+                printf("  - %s: %d units, for", plan->names[p], plan->capacity[p]);
+                int users = 0;
+                for (int d = 0; d < NUM_DEPARTMENTS; d++) {
+                    if ((plan->needs[d] >> p) & 1) {
+                        printf("%s %s", users++ ? "," : "", get_department_name((DepartmentType)d));
+                    }
+                }
+                printf("%s\n", users ? "" : " no department");
+            }
+            printf("\n");
+        }
+        printf("Starting department %s...\n", config->backend == BACKEND_THREAD ? "threads" : "processes");
+    }
+
+    int started = (config->backend == BACKEND_THREAD) ?
+                  start_department_threads(sim->msg_queue_id, sim->return_queue_id, hospital_state) :
+                  start_department_processes(sim);
+    if (started != 0) {
+        log_message(LOG_ERROR, "Failed to start department workers");
+        return -1;
+    }
+
+    if (!config->quiet) {
+        for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+            if (config->backend == BACKEND_THREAD) {
+                printf("✓ %s department started (thread)\n", get_department_name((DepartmentType)i));
+            } else {
+                printf("✓ %s department started (PID: %d)\n",
+                       get_department_name((DepartmentType)i), sim->dept_pids[i]);
+            }
+        }
+
+        const char *role_names[NUM_DEPARTMENTS + 1] = {"Scheduler"};
+        for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+            role_names[i + 1] = get_department_name((DepartmentType)i);
+        }
+        print_cpu_placement(role_names, NUM_DEPARTMENTS + 1, sim->memory_node);
+    }
+
+    // Start as soon as every department is serving
+    if (wait_latch(&hospital_state->departments_ready, NUM_DEPARTMENTS, DEPARTMENT_STARTUP_TIMEOUT) != 0) {
+        fprintf(stderr, "Departments did not start within %d ms\n", DEPARTMENT_STARTUP_TIMEOUT);
+        return -1;
+    }
+    return 0;
+}
+
+// Global metrics, final hospital state and run summary of the department backends
+static void print_department_report(Simulation *sim, int num_patients) {
+    HospitalState *hospital_state = sim->hospital_state;
+
+    print_global_metrics(&sim->results.metrics);
+    print_profiler_report(&hospital_state->profile);
+
+    printf("╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                 FINAL HOSPITAL STATE                           ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    lock_mutex(&hospital_state->mutex);
+    printf("Total Patients          : %d\n", hospital_state->total_patients);
+    printf("Completed Patients      : %d\n", num_patients);
+    printf("Active Patients:\n");
+    for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+        printf("  - %-15s: %d\n", get_department_name((DepartmentType)i),
+               hospital_state->active_patients[i]);
+    }
+    printf("Resource Gate Contention:\n");
+    for (int i = 0; i < hospital_state->num_pools; i++) {
+        ResourceGate *gate = &hospital_state->gates[i];
+        double avg_wait = gate->contended > 0 ? gate->wait_ns / 1e9 / gate->contended : 0.0;
+        printf("  - %-15s: %llu acquisitions, %llu queued, %u max waiting, %.2fs avg queued wait\n",
+               sim->config.resources.names[i],
+               (unsigned long long)gate->acquisitions,
+               (unsigned long long)gate->contended,
+               gate->max_waiters, avg_wait);
+    }
+    unlock_mutex(&hospital_state->mutex);
+
+    printf("\nSeed                        : %llu (%s clock)\n", (unsigned long long)sim->config.seed,
+           sim->config.deterministic ? "simulated" : "wall");
+}
+
+// Dispatch one run's patients to the running department workers. Each
+// patient is created as it arrives and freed by the scheduler at discharge;
+// the run's metrics come from the discharges.
+static int run_department_patients(Simulation *sim) {
+    SimConfig *config = &sim->config;
+    HospitalState *hospital_state = sim->hospital_state;
+    int num_patients = config->num_patients;
+
+    Patient **all_patients = (Patient**)calloc(num_patients, sizeof(Patient*));
+    PatientMetrics *kept = NULL;
+    if (!all_patients || (config->keep_patients && init_sim_results(&sim->results, num_patients) != 0)) {
+        fprintf(stderr, "Failed to allocate %d patients\n", num_patients);
+        free(all_patients);
+        return -1;
+    }
+    if (config->keep_patients) {
+        kept = sim->results.patients;
+    }
+
+    // Diverse patient mix (OPD, Emergency, Radiology and Pharmacy-only routes)
+    const char *route_names[] = {"Route A (OPD)", "Route B (Emergency)",
+                                  "Route C (Radiology)", "Route D (Pharmacy)"};
+    if (!config->quiet) {
+        printf("\nPatient mix:\n");
+        for (int i = 0; i < num_patients; i++) {
+            printf("  Patient %2d: %s\n", i + 1, route_names[get_default_route(i)]);
+        }
+    }
+
+    hospital_state->total_patients = num_patients;
+
+    if (!config->quiet) {
+        printf("\n╔════════════════════════════════════════════════════════════════╗\n");
+        printf("║                  SIMULATION RUNNING...                         ║\n");
+        printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+        printf("Dispatching patients to departments...\n\n");
+    }
+
+    // Send patients to their first departments as they arrive, using FCFS,
+    // as far as each department's credits go. The interval is the arrival
+    // process on the wall clock; on the simulated clock arrivals are already
+    // spaced by their ready times.
+    init_dispatch_flow(sim->dispatch_credits);
+    start_department_occupancy(hospital_state);
+    DischargeTotals totals;
+    memset(&totals, 0, sizeof(totals));
+    MessageScheduler scheduler;
+    init_message_scheduler(&scheduler, sim->msg_queue_id, sim->return_queue_id, all_patients, &totals, kept);
+    int result = 0;
+    int arrived = 0;
+    time_t first_arrival = 0;
+    double next_arrival = hospital_clock();
+    for (; arrived < num_patients; arrived++) {
+        Patient *patient = create_patient(arrived + 1, get_default_route(arrived));
+        if (!patient) {
+            fprintf(stderr, "Failed to allocate patient %d; finishing the %d already arrived\n",
+                    arrived + 1, arrived);
+            result = -1;
+            break;
+        }
+        all_patients[arrived] = patient;
+        scheduler.num_patients = arrived + 1;
+        record_patient_arrival(patient);
+        if (config->deterministic) {
+            // The simulated clock starts at 0 with the first dispatch
+            patient->ready_time = arrived * (DISPATCH_INTERVAL / 1e6);
+            patient->arrival_time = (time_t)patient->ready_time;
+        }
+        if (arrived == 0) {
+            first_arrival = patient->arrival_time;
+            scheduler.start = first_arrival;
+        }
+        DepartmentType first_dept = get_next_department(patient);
+        dispatch_patient(sim->msg_queue_id, first_dept, patient);
+        if (!config->deterministic) {
+            // Discharge (and free) the patients done so far before the next
+            // arrival; on the simulated clock every patient is dispatched
+            // before the first treatment ends
+            poll_message_scheduler(&scheduler);
+            next_arrival += DISPATCH_INTERVAL / 1e6;
+            double wait = next_arrival - hospital_clock();
+            if (wait > 0.0) {
+                usleep((useconds_t)(wait * 1e6));
+            }
+        }
+    }
+
+    // Run Round Robin message scheduler until the last patient is discharged
+    round_robin_message_scheduler(&scheduler);
+
+    // Department occupancy is measured on the monotonic wall clock, on either clock
+    GlobalMetrics metrics;
+    calculate_discharge_metrics(&totals, arrived, first_arrival, &metrics);
+    add_dispatch_metrics(&metrics);
+    lock_mutex(&hospital_state->mutex);
+    double end = hospital_clock();
+    for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+        advance_occupancy(&hospital_state->occupancy[i], end, hospital_state->active_patients[i],
+                          hospital_state->waiting_patients[i], get_department_resources((DepartmentType)i));
+        add_unit_utilization(&metrics.departments[i], &hospital_state->occupancy[i],
+                             get_department_resources((DepartmentType)i),
+                             hospital_state->max_waiting_patients[i], end, 1);
+    }
+    init_pool_metrics(&metrics, &config->resources);
+    for (int p = 0; p < metrics.num_pools; p++) {
+        ResourceGate *gate = &hospital_state->gates[p];
+        advance_occupancy(&hospital_state->pool_occupancy[p], end, hospital_state->pool_in_use[p], 0, gate->capacity);
+        add_pool_utilization(&metrics.pools[p], &hospital_state->pool_occupancy[p],
+                             gate->capacity, end, 1);
+        metrics.pools[p].acquisitions = (long)gate->acquisitions;
+        metrics.pools[p].queued = (long)gate->contended;
+    }
+    unlock_mutex(&hospital_state->mutex);
+    sim->results.metrics = metrics;
+    if (!config->quiet) {
+        print_department_report(sim, totals.discharged);
+    }
+
+    finish_replay_recording();
+    if (config->replay_path && !config->quiet) {
+        int divergences = __atomic_load_n(&hospital_state->replay_divergences, __ATOMIC_RELAXED);
+        printf("Replay                      : %s\n", divergences == 0 ?
+               "every department followed the recorded order" : "diverged from the recorded order");
+    }
+    if (!config->quiet) {
+        printf("\n");
+    }
+
+    // Only patients the scheduler never saw discharged are left
+    for (int i = 0; i < arrived; i++) {
+        free(all_patients[i]);
+    }
+    free(all_patients);
+    return result;
+}
+
+// Set up a simulation from a configuration. Process and thread backends start
+// their department workers here, once for every later run.
+Simulation* create_simulation(const SimConfig *config) {
+    Simulation *sim = (Simulation*)calloc(1, sizeof(Simulation));
+    if (!sim) {
+        fprintf(stderr, "Failed to allocate simulation\n");
+        return NULL;
+    }
+    sim->config = *config;
+    sim->shm_id = -1;
+    sim->msg_queue_id = -1;
+    sim->return_queue_id = -1;
+    sim->memory_node = -1;
+
+    init_department_configs();
+    apply_resource_plan(&sim->config.resources);
+
+    if (init_cpu_placement(&sim->config.placement) != 0) {
+        free(sim);
+        return NULL;
+    }
+
+    // A replay takes its seed and patient count from the log
+    if (sim->config.replay_path) {
+        uint64_t replay_seed;
+        if (load_replay(sim->config.replay_path, &replay_seed, &sim->config.num_patients) != 0) {
+            free(sim);
+            return NULL;
+        }
+        if (sim->config.seed != 0 && sim->config.seed != replay_seed && !sim->config.quiet) {
+            printf("Note: --seed ignored, replaying with the recorded seed %llu\n",
+                   (unsigned long long)replay_seed);
+        }
+        sim->config.seed = replay_seed;
+    }
+
+    // Every backend draws treatment durations from one seed (a restored
+    // checkpoint keeps its own unless one is given)
+    if (sim->config.seed == 0 && !sim->config.restore_path) {
+        sim->config.seed = default_random_seed();
+    }
+
+    if (uses_department_workers(&sim->config) && start_department_workers(sim) != 0) {
+        destroy_simulation(sim);
+        return NULL;
+    }
+
+    return sim;
+}
+
+// Run the simulation once. Returns 0 on success; results stay readable until
+// the next reset or destroy.
+int run_simulation(Simulation *sim) {
+    if (sim->ran) {
+        fprintf(stderr, "Simulation already ran; reset it before running again\n");
+        return -1;
+    }
+    sim->ran = 1;
+
+    // The analytic baseline costs microseconds, so it goes first
+    NetworkEstimate estimate;
+    int compare = sim->config.estimate != ESTIMATE_NONE && !sim->config.quiet &&
+                  estimate_network(&sim->config, &estimate) == 0;
+    if (compare) {
+        print_network_estimate(&estimate);
+    }
+
+    // Patients are streamed out as they are discharged
+    if (start_patient_export(sim->config.export_path, sim->config.quiet ? 0 : sim->config.slowest_journeys) != 0 ||
+        start_steady_state(sim->config.steady_state_batches) != 0) {
+        return -1;
+    }
+
+    int result;
+    switch (sim->config.backend) {
+        case BACKEND_EXECUTOR:
+            // Every department runs on its own worker pool; no IPC or forking
+            result = run_executor_simulation(&sim->config, &sim->results);
+            break;
+        case BACKEND_COROUTINE:
+            // Journeys run on a single event loop; no IPC or forking either
+            result = run_coroutine_simulation(&sim->config, &sim->results);
+            break;
+        case BACKEND_DES:
+        case BACKEND_PDES:
+            // Discrete-event engines advance simulated time directly, without pacing
+            result = run_des_simulation(&sim->config, &sim->results);
+            break;
+        default:
+            result = run_department_patients(sim);
+            break;
+    }
+
+    if (result == 0 && !sim->config.quiet) {
+        print_slowest_journeys();
+    }
+    if (finish_steady_state(&sim->results.steady_state) != 0) {
+        result = -1;
+    } else if (result == 0 && sim->config.steady_state_batches > 0 && !sim->config.quiet) {
+        print_steady_state(&sim->results.steady_state);
+    }
+    if (finish_patient_export(!sim->config.quiet) != 0) {
+        result = -1;
+    }
+    if (compare && result == 0 && sim->results.metrics.total_patients > 0) {
+        print_estimate_comparison(&estimate, &sim->results.metrics);
+    }
+    return result;
+}
+
+const SimResults* get_simulation_results(const Simulation *sim) {
+    return sim->ran ? &sim->results : NULL;
+}
+
+// Prepare another run with a new seed (0 keeps the current one), reusing the
+// running department workers and IPC objects
+int reset_simulation(Simulation *sim, uint64_t seed) {
+    if (sim->config.record_path || sim->config.replay_path) {
+        fprintf(stderr, "Recorded and replayed simulations run once\n");
+        return -1;
+    }
+
+    free_sim_results(&sim->results);
+    if (seed != 0) {
+        sim->config.seed = seed;
+    }
+    sim->ran = 0;
+
+    HospitalState *hospital_state = sim->hospital_state;
+    if (hospital_state) {
+        reset_hospital_state(hospital_state);
+        hospital_state->seed = sim->config.seed;
+        if (init_resource_gates(hospital_state, &sim->config.resources) != 0) {
+            return -1;
+        }
+    }
+
+    log_message(LOG_INFO, "Simulation reset (seed %llu)", (unsigned long long)sim->config.seed);
+    return 0;
+}
+
+// Stop the department workers, remove the IPC objects and free the simulation
+void destroy_simulation(Simulation *sim) {
+    if (!sim) return;
+
+    if (sim->config.backend == BACKEND_THREAD) {
+        if (sim->msg_queue_id != -1) {
+            stop_department_threads(sim->msg_queue_id);
+            destroy_message_queue(sim->msg_queue_id);
+        }
+        if (sim->return_queue_id != -1) {
+            destroy_message_queue(sim->return_queue_id);
+        }
+        free(sim->hospital_state);
+    } else if (sim->config.backend == BACKEND_PROCESS) {
+        for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+            if (sim->dept_pids[i] > 0) {
+                kill(sim->dept_pids[i], SIGTERM);
+                waitpid(sim->dept_pids[i], NULL, 0);
+            }
+        }
+        if (sim->msg_queue_id != -1) {
+            destroy_message_queue(sim->msg_queue_id);
+        }
+        if (sim->return_queue_id != -1) {
+            destroy_message_queue(sim->return_queue_id);
+        }
+        if (sim->hospital_state) {
+            detach_shared_memory(sim->hospital_state);
+        }
+        if (sim->shm_id != -1) {
+            destroy_shared_memory(sim->shm_id);
+        }
+    }
+
+    use_hospital_state(NULL);
+    free_sim_results(&sim->results);
+    free(sim);
+}
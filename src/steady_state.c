@@ -0,0 +1,284 @@
+#include "steady_state.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#define MAX_BATCH_CORRELATION 0.5   // Lag-1 correlation above which batches are too short
+
+// One discharged patient
+typedef struct {
+    double arrival_time;
+    double discharge_time;
+    double waiting_time;
+    int32_t patient_id;
+} Observation;
+
+// Discharges may come from several worker threads or logical processes
+static pthread_mutex_t observation_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Observation *observations = NULL;
+static int64_t num_observations = 0;
+static int64_t observation_capacity = 0;
+static int observation_failed = 0;
+static int num_batches = 0;   // 0 while not collecting
+
+// Collect the discharges of the next run for batches batch means (0 = none)
+int start_steady_state(int batches) {
+    if (batches != 0 && (batches < 2 || batches > MAX_STEADY_STATE_BATCHES)) {
+        fprintf(stderr, "Steady-state estimates need 2-%d batches\n", MAX_STEADY_STATE_BATCHES);
+        return -1;
+    }
+    free(observations);
+    observations = NULL;
+    num_observations = 0;
+    observation_capacity = 0;
+    observation_failed = 0;
+    num_batches = batches;
+    return 0;
+}
+
+// Record one discharged patient; times in seconds since the run started
+void observe_discharge(double arrival_time, double discharge_time, double waiting_time, int32_t patient_id) {
+    if (num_batches == 0) return;
+
+    pthread_mutex_lock(&observation_mutex);
+    if (num_observations == observation_capacity && !observation_failed) {
+        int64_t capacity = observation_capacity ? observation_capacity * 2 : 16384;
+        Observation *grown = (Observation*)realloc(observations, sizeof(Observation) * capacity);
+        if (grown) {
+            observations = grown;
+            observation_capacity = capacity;
+        } else {
+            observation_failed = 1;
+        }
+    }
+    if (num_observations < observation_capacity) {
+        Observation *observation = &observations[num_observations++];
+        observation->arrival_time = arrival_time;
+        observation->discharge_time = discharge_time;
+        observation->waiting_time = waiting_time;
+        observation->patient_id = patient_id;
+    }
+    pthread_mutex_unlock(&observation_mutex);
+}
+
+// Arrival order, so every backend and partitioning sees the same sequence
+static int compare_arrival(const void *a, const void *b) {
+    const Observation *x = (const Observation*)a;
+    const Observation *y = (const Observation*)b;
+    if (x->arrival_time != y->arrival_time) return x->arrival_time < y->arrival_time ? -1 : 1;
+    return (x->patient_id > y->patient_id) - (x->patient_id < y->patient_id);
+}
+
+// Two-sided 95% Student t quantile: exact for few degrees of freedom, then
+// the Cornish-Fisher expansion around the normal quantile
+double t_quantile_975(int df) {
+    static const double table[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228 };
+    if (df <= (int)(sizeof(table) / sizeof(table[0]))) return table[df - 1];
+
+    double z = 1.959964, v = df;
+    double z3 = z * z * z, z5 = z3 * z * z, z7 = z5 * z * z;
+    return z + (z3 + z) / (4.0 * v) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * v * v) +
+           (3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * v * v * v);
+}
+
+// Patients to drop as warm-up (MSER-5): over means of 5 patients, the
+// truncation minimizing the squared standard error of what is left. Only
+// the first half is searched; a minimum at its end means the output never
+// settled.
+static int64_t mser_truncation(const Observation *sorted, int64_t n, int *at_limit) {
+    int64_t m = n / MSER_BATCH_SIZE;
+    double *means = (double*)malloc(sizeof(double) * (m > 0 ? m : 1));
+    if (!means) return -1;
+
+    double overall = 0.0;
+    for (int64_t j = 0; j < m; j++) {
+        double sum = 0.0;
+        for (int i = 0; i < MSER_BATCH_SIZE; i++) {
+            sum += sorted[j * MSER_BATCH_SIZE + i].waiting_time;
+        }
+        means[j] = sum / MSER_BATCH_SIZE;
+        overall += means[j];
+    }
+    overall /= m;
+
+    // Suffix sums, centred on the overall mean to keep the differences exact
+    int64_t limit = m / 2;
+    int64_t best = 0;
+    double best_statistic = INFINITY;
+    double sum = 0.0, sum_sq = 0.0;
+    for (int64_t d = m - 1; d >= 0; d--) {
+        double z = means[d] - overall;
+        sum += z;
+        sum_sq += z * z;
+        if (d >= limit) continue;
+
+        double kept = (double)(m - d);
+        double statistic = (sum_sq - sum * sum / kept) / (kept * kept);
+        if (statistic <= best_statistic) {
+            best_statistic = statistic;
+            best = d;
+        }
+    }
+    free(means);
+    *at_limit = limit > 1 && best == limit - 1;
+    return best * MSER_BATCH_SIZE;
+}
+
+// Mean, 95% half-width and lag-1 correlation of batch means
+static BatchEstimate estimate_batches(const double *values, int batches) {
+    BatchEstimate estimate;
+    memset(&estimate, 0, sizeof(estimate));
+    for (int j = 0; j < batches; j++) {
+        estimate.mean += values[j];
+    }
+    estimate.mean /= batches;
+
+    double squares = 0.0, lagged = 0.0;
+    for (int j = 0; j < batches; j++) {
+        double deviation = values[j] - estimate.mean;
+        squares += deviation * deviation;
+        if (j + 1 < batches) {
+            lagged += deviation * (values[j + 1] - estimate.mean);
+        }
+    }
+    estimate.half_width = t_quantile_975(batches - 1) * sqrt(squares / (batches - 1) / batches);
+    estimate.lag1_correlation = squares > 0.0 ? lagged / squares : 0.0;
+    return estimate;
+}
+
+// Truncate and batch the sorted discharges. Returns -1 if out of memory.
+static int analyze_observations(SteadyStateEstimate *estimate, int batches) {
+    if (batches < 2) return -1;   // Checked by start_steady_state()
+
+    int64_t n = num_observations;
+    qsort(observations, n, sizeof(Observation), compare_arrival);
+    double *values = (double*)malloc(sizeof(double) * batches);
+    int64_t truncated = values ? mser_truncation(observations, n, &estimate->truncation_at_limit) : -1;
+    if (truncated < 0) {
+        free(values);
+        return -1;
+    }
+    estimate->truncated = truncated;
+    estimate->warmup_time = observations[truncated].arrival_time;
+
+    // Equal batches of the kept patients; the odd few nearest the warm-up go
+    int64_t size = (n - truncated) / batches;
+    int64_t first = n - size * batches;
+    estimate->batch_size = size;
+    for (int j = 0; j < batches; j++) {
+        double sum = 0.0;
+        for (int64_t i = first + j * size; i < first + (j + 1) * size; i++) {
+            sum += observations[i].waiting_time;
+        }
+        values[j] = sum / size;
+    }
+    estimate->waiting_time = estimate_batches(values, batches);
+    for (int j = 0; j < batches; j++) {
+        double sum = 0.0;
+        for (int64_t i = first + j * size; i < first + (j + 1) * size; i++) {
+            sum += observations[i].discharge_time - observations[i].arrival_time;
+        }
+        values[j] = sum / size;
+    }
+    estimate->time_in_system = estimate_batches(values, batches);
+
+    // Throughput: discharges in equal spans from the warm-up to the last
+    // arrival, before the hospital drains
+    double end = observations[n - 1].arrival_time;
+    estimate->batch_span = (end - estimate->warmup_time) / batches;
+    if (estimate->batch_span > 0.0) {
+        memset(values, 0, sizeof(double) * batches);
+        for (int64_t i = 0; i < n; i++) {
+            double offset = observations[i].discharge_time - estimate->warmup_time;
+            double batch = floor(offset / estimate->batch_span);
+            if (offset >= 0.0 && batch < batches) {
+                values[(int)batch] += 60.0 / estimate->batch_span;
+            }
+        }
+        estimate->throughput = estimate_batches(values, batches);
+    }
+    free(values);
+    estimate->valid = 1;
+    log_message(LOG_INFO, "Steady state: %lld of %lld patients dropped as warm-up, %d batches of %lld",
+                (long long)truncated, (long long)n, batches, (long long)size);
+    return 0;
+}
+
+// Analyze the run's discharges and release them. Returns -1 if they could
+// not all be kept; too few of them is not an error (valid stays 0).
+int finish_steady_state(SteadyStateEstimate *estimate) {
+    memset(estimate, 0, sizeof(SteadyStateEstimate));
+    int batches = num_batches;
+    int64_t n = num_observations;
+    num_batches = 0;
+    if (batches == 0) return 0;
+
+    estimate->batches = batches;
+    estimate->observations = n;
+    for (int64_t i = 0; i < n; i++) {
+        estimate->all_waiting_time += observations[i].waiting_time / n;
+        estimate->all_time_in_system += (observations[i].discharge_time - observations[i].arrival_time) / n;
+    }
+
+    int result = 0;
+    if (observation_failed) {
+        fprintf(stderr, "Out of memory keeping discharges for steady-state estimates\n");
+        result = -1;
+    } else if (n >= 2LL * batches * MIN_STEADY_STATE_BATCH && analyze_observations(estimate, batches) != 0) {
+        // MSER may drop up to half, and every batch needs enough patients
+        fprintf(stderr, "Out of memory computing steady-state estimates\n");
+        result = -1;
+    }
+    free(observations);
+    observations = NULL;
+    num_observations = 0;
+    observation_capacity = 0;
+    return result;
+}
+
+static void print_estimate_row(const char *label, const BatchEstimate *estimate, double all) {
+    printf("%-28s %12.2f %12.2f", label, estimate->mean, estimate->half_width);
+    if (all >= 0.0) {
+        printf(" %14.2f", all);
+    } else {
+        printf(" %14s", "-");
+    }
+    printf(" %12.2f\n", estimate->lag1_correlation);
+}
+
+void print_steady_state(const SteadyStateEstimate *estimate) {
+    printf("╔════════════════════════════════════════════════════════════════╗\n");
+    printf("║                 STEADY-STATE ESTIMATES                         ║\n");
+    printf("╚════════════════════════════════════════════════════════════════╝\n\n");
+
+    if (!estimate->valid) {
+        printf("Too few discharges for %d batches: %lld (need %lld)\n\n", estimate->batches,
+               (long long)estimate->observations, 2LL * estimate->batches * MIN_STEADY_STATE_BATCH);
+        return;
+    }
+    printf("Warm-up (MSER-5)            : %lld of %lld patients dropped (arrivals before %.2f s)\n",
+           (long long)estimate->truncated, (long long)estimate->observations, estimate->warmup_time);
+    printf("Batches                     : %d of %lld patients, throughput over %.2f s each\n\n",
+           estimate->batches, (long long)estimate->batch_size, estimate->batch_span);
+
+    printf("%-28s %12s %12s %14s %12s\n", "Metric", "Steady State", "95% CI +/-", "All Patients", "Lag-1 Corr");
+    print_estimate_row("Average Waiting Time (s)", &estimate->waiting_time, estimate->all_waiting_time);
+    print_estimate_row("Average Time in System (s)", &estimate->time_in_system, estimate->all_time_in_system);
+    if (estimate->batch_span > 0.0) {
+        print_estimate_row("Throughput (patients/min)", &estimate->throughput, -1.0);
+    }
+
+    if (estimate->truncation_at_limit) {
+        printf("\nThe warm-up search reached the middle of the run, so waiting never settled:\n"
+               "the load may exceed capacity, or the run is too short for a steady state.\n");
+    }
+    if (estimate->waiting_time.lag1_correlation > MAX_BATCH_CORRELATION ||
+        estimate->time_in_system.lag1_correlation > MAX_BATCH_CORRELATION) {
+        printf("\nSuccessive batch means are correlated, so the intervals are too narrow;\n"
+               "use fewer batches or a longer run.\n");
+    }
+    printf("\n");
+}
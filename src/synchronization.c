@@ -1,9 +1,13 @@
 #include "synchronization.h"
 #include "logger.h"
-#include <fcntl.h>
-#include <sys/stat.h>
-#include <errno.h>
+#include "profiler.h"
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 // Initialize mutex
 int init_mutex(pthread_mutex_t *mutex) {
@@ -16,6 +20,7 @@ int init_mutex(pthread_mutex_t *mutex) {
 
 // Lock mutex
 int lock_mutex(pthread_mutex_t *mutex) {
+    PROFILE_SCOPE(PROF_SHM_MUTEX);
     if (pthread_mutex_lock(mutex) != 0) {
         log_message(LOG_ERROR, "Failed to lock mutex");
         return -1;
@@ -41,55 +46,149 @@ int destroy_mutex(pthread_mutex_t *mutex) {
     return 0;
 }
 
-// Create named semaphore
-sem_t* create_semaphore(const char *name, int initial_value) {
-    // First unlink if exists
-    sem_unlink(name);
-    
-    sem_t *sem = sem_open(name, O_CREAT | O_EXCL, 0644, initial_value);
-    if (sem == SEM_FAILED) {
-        log_message(LOG_ERROR, "Failed to create semaphore %s: %s", name, strerror(errno));
-        return NULL;
-    }
-    
-    log_message(LOG_INFO, "Created semaphore %s with value %d", name, initial_value);
-    return sem;
+// Gate state word layout
+#define GATE_FREE_MASK 0xFFFFu
+#define GATE_WAITER_SHIFT 16
+#define GATE_WAITER_ONE (1u << GATE_WAITER_SHIFT)
+
+// Futex wait/wake on a word that may be shared between processes
+static void futex_wait(uint32_t *addr, uint32_t expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+// Returns -1 with errno ETIMEDOUT once the relative timeout passes
+static int futex_wait_timeout(uint32_t *addr, uint32_t expected, const struct timespec *timeout) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT, expected, timeout, NULL, 0);
 }
 
-// Open existing semaphore
-sem_t* open_semaphore(const char *name) {
-    sem_t *sem = sem_open(name, 0);
-    if (sem == SEM_FAILED) {
-        log_message(LOG_ERROR, "Failed to open semaphore %s: %s", name, strerror(errno));
-        return NULL;
+static void futex_wake_all(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Initialize resource gate with the number of available units
+int init_semaphore(ResourceGate *gate, int initial_value) {
+    if (!gate || initial_value < 0 || initial_value > (int)GATE_FREE_MASK) {
+        log_message(LOG_ERROR, "Invalid resource gate value %d", initial_value);
+        return -1;
     }
-    return sem;
+    
+    memset(gate, 0, sizeof(ResourceGate));
+    gate->state = (uint32_t)initial_value;
+    gate->capacity = initial_value;
+    
+    log_message(LOG_INFO, "Created resource gate with value %d", initial_value);
+    return 0;
 }
 
 // Wait on semaphore (decrement)
-int wait_semaphore(sem_t *sem) {
-    if (sem_wait(sem) != 0) {
-        log_message(LOG_ERROR, "Failed to wait on semaphore: %s", strerror(errno));
-        return -1;
+int wait_semaphore(ResourceGate *gate) {
+    PROFILE_SCOPE(PROF_SEMAPHORE_WAIT);
+    uint32_t state = __atomic_load_n(&gate->state, __ATOMIC_RELAXED);
+    
+    while (1) {
+        uint32_t waiters = state >> GATE_WAITER_SHIFT;
+        
+        // Fast path: a free unit and nobody queued ahead of us
+        if ((state & GATE_FREE_MASK) > 0 && waiters == 0) {
+            if (__atomic_compare_exchange_n(&gate->state, &state, state - 1, 1,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                __atomic_fetch_add(&gate->acquisitions, 1, __ATOMIC_RELAXED);
+                return 0;
+            }
+            continue;
+        }
+        
+        // Register as a waiter
+        if (__atomic_compare_exchange_n(&gate->state, &state, state + GATE_WAITER_ONE, 1,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    
+    // Slow path: take a ticket and sleep until post() grants it
+    uint64_t wait_start = monotonic_ns();
+    uint32_t ticket = __atomic_fetch_add(&gate->next_ticket, 1, __ATOMIC_RELAXED);
+    uint32_t queued = (state >> GATE_WAITER_SHIFT) + 1;
+    
+    uint32_t max_waiters = __atomic_load_n(&gate->max_waiters, __ATOMIC_RELAXED);
+    while (queued > max_waiters &&
+           !__atomic_compare_exchange_n(&gate->max_waiters, &max_waiters, queued, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
     }
+    
+    uint32_t granted;
+    while ((int32_t)((granted = __atomic_load_n(&gate->granted, __ATOMIC_ACQUIRE)) - ticket) <= 0) {
+        futex_wait(&gate->granted, granted);
+    }
+    
+    __atomic_fetch_add(&gate->acquisitions, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&gate->contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&gate->wait_ns, monotonic_ns() - wait_start, __ATOMIC_RELAXED);
     return 0;
 }
 
 // Post to semaphore (increment)
-int post_semaphore(sem_t *sem) {
-    if (sem_post(sem) != 0) {
-        log_message(LOG_ERROR, "Failed to post to semaphore: %s", strerror(errno));
-        return -1;
+int post_semaphore(ResourceGate *gate) {
+    PROFILE_SCOPE(PROF_SEMAPHORE_POST);
+    uint32_t state = __atomic_load_n(&gate->state, __ATOMIC_RELAXED);
+    
+    while (1) {
+        if ((state >> GATE_WAITER_SHIFT) > 0) {
+            // Hand the unit straight to the oldest ticket
+            if (__atomic_compare_exchange_n(&gate->state, &state, state - GATE_WAITER_ONE, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                __atomic_fetch_add(&gate->granted, 1, __ATOMIC_RELEASE);
+                futex_wake_all(&gate->granted);
+                return 0;
+            }
+        } else {
+            if ((state & GATE_FREE_MASK) == GATE_FREE_MASK) {
+                log_message(LOG_ERROR, "Failed to post to resource gate: value overflow");
+                return -1;
+            }
+            if (__atomic_compare_exchange_n(&gate->state, &state, state + 1, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                return 0;
+            }
+        }
     }
-    return 0;
 }
 
-// Destroy named semaphore
-int destroy_semaphore(const char *name) {
-    if (sem_unlink(name) != 0) {
-        log_message(LOG_ERROR, "Failed to destroy semaphore %s: %s", name, strerror(errno));
-        return -1;
+// Initialize latch with no workers arrived
+void init_latch(ReadyLatch *latch) {
+    __atomic_store_n(&latch->arrived, 0, __ATOMIC_RELAXED);
+}
+
+// Count this worker in and wake the waiting scheduler
+void arrive_latch(ReadyLatch *latch) {
+    __atomic_add_fetch(&latch->arrived, 1, __ATOMIC_RELEASE);
+    futex_wake_all(&latch->arrived);
+}
+
+// Wait until count workers have arrived; -1 if they have not within timeout_ms
+int wait_latch(ReadyLatch *latch, uint32_t count, int timeout_ms) {
+    uint64_t deadline = monotonic_ns() + (uint64_t)timeout_ms * 1000000ULL;
+    uint32_t arrived;
+    
+    while ((arrived = __atomic_load_n(&latch->arrived, __ATOMIC_ACQUIRE)) < count) {
+        uint64_t now = monotonic_ns();
+        if (now >= deadline) {
+            log_message(LOG_ERROR, "Only %u of %u workers ready after %d ms", arrived, count, timeout_ms);
+            return -1;
+        }
+        struct timespec timeout = {(time_t)((deadline - now) / 1000000000ULL),
+                                   (long)((deadline - now) % 1000000000ULL)};
+        if (futex_wait_timeout(&latch->arrived, arrived, &timeout) == -1 &&
+            errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
+            log_message(LOG_ERROR, "Failed to wait for workers: %s", strerror(errno));
+            return -1;
+        }
     }
-    log_message(LOG_INFO, "Destroyed semaphore %s", name);
     return 0;
 }
@@ -0,0 +1,61 @@
+#include "thread_backend.h"
+#include "department.h"
+#include "message_queue.h"
+#include "logger.h"
+#include "placement.h"
+#include <pthread.h>
+
+// Arguments for one department thread
+typedef struct {
+    DepartmentType dept_type;
+    int msg_queue_id;
+    int return_queue_id;
+    HospitalState *hospital_state;
+} DepartmentThreadArgs;
+
+static pthread_t dept_threads[NUM_DEPARTMENTS];
+static DepartmentThreadArgs dept_thread_args[NUM_DEPARTMENTS];
+static int threads_started = 0;
+
+// Department thread - same service loop as the forked process
+static void* department_thread(void *arg) {
+    DepartmentThreadArgs *args = (DepartmentThreadArgs*)arg;
+    
+    pin_to_role(args->dept_type + 1);
+    log_message(LOG_INFO, "Department %s thread started", get_department_name(args->dept_type));
+    department_service_loop(args->dept_type, args->msg_queue_id, args->return_queue_id,
+                            args->hospital_state);
+    
+    return NULL;
+}
+
+// Start one thread per department sharing the in-process queues and state
+int start_department_threads(int msg_queue_id, int return_queue_id, HospitalState *hospital_state) {
+    for (int i = 0; i < NUM_DEPARTMENTS; i++) {
+        dept_thread_args[i].dept_type = (DepartmentType)i;
+        dept_thread_args[i].msg_queue_id = msg_queue_id;
+        dept_thread_args[i].return_queue_id = return_queue_id;
+        dept_thread_args[i].hospital_state = hospital_state;
+        
+        if (pthread_create(&dept_threads[i], NULL, department_thread, &dept_thread_args[i]) != 0) {
+            log_message(LOG_ERROR, "Failed to create %s department thread",
+                        get_department_name((DepartmentType)i));
+            stop_department_threads(msg_queue_id);
+            return -1;
+        }
+        threads_started = i + 1;
+    }
+    
+    return 0;
+}
+
+// Ask every department thread to finish and wait for it
+void stop_department_threads(int msg_queue_id) {
+    for (int i = 0; i < threads_started; i++) {
+        send_shutdown_to_department(msg_queue_id, (DepartmentType)i);
+    }
+    for (int i = 0; i < threads_started; i++) {
+        pthread_join(dept_threads[i], NULL);
+    }
+    threads_started = 0;
+}
@@ -0,0 +1,166 @@
+#include "timer_wheel.h"
+#include <math.h>
+#include <string.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define OVERFLOW_SLOT (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)
+#define DUE_SLOT (OVERFLOW_SLOT + 1)
+#define WHEEL_SPAN ((uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+#define MAX_TICK ((uint64_t)1 << 62)
+
+static int32_t* slot_head(TimerWheel *wheel, int slot) {
+    if (slot == OVERFLOW_SLOT) return &wheel->overflow;
+    if (slot == DUE_SLOT) return &wheel->due;
+    return &wheel->slots[slot / TIMER_WHEEL_SLOTS][slot & SLOT_MASK];
+}
+
+// Track which levels have timers, so empty stretches can be skipped
+static void count_slot(TimerWheel *wheel, int slot, int change) {
+    if (slot < OVERFLOW_SLOT) {
+        wheel->level_count[slot / TIMER_WHEEL_SLOTS] += change;
+    }
+}
+
+// Tick holding a time; MAX_TICK for times too far out to count in ticks
+static uint64_t time_tick(const TimerWheel *wheel, double time) {
+    double ticks = floor(time / wheel->tick);
+    if (!(ticks < (double)MAX_TICK)) return MAX_TICK;
+    return ticks > 0.0 ? (uint64_t)ticks : 0;
+}
+
+// Wheel starting at now, with no timers armed. Nodes are owned by the caller
+// and must start disarmed (prev == TIMER_NONE).
+void init_timer_wheel(TimerWheel *wheel, TimerNode *nodes, double tick, double now) {
+    memset(wheel, 0, sizeof(TimerWheel));
+    memset(wheel->slots, 0xff, sizeof(wheel->slots));   // TIMER_NONE
+    wheel->nodes = nodes;
+    wheel->tick = tick;
+    wheel->current = time_tick(wheel, now);
+    wheel->overflow = TIMER_NONE;
+    wheel->due = TIMER_NONE;
+}
+
+// Slot for a timer's expiry: the lowest level whose span still reaches it,
+// or the due list if its tick is already behind the wheel
+static void link_timer(TimerWheel *wheel, int32_t id) {
+    TimerNode *node = &wheel->nodes[id];
+    uint64_t tick = time_tick(wheel, node->expiry);
+    uint64_t delta = tick - wheel->current;
+
+    int slot = tick < wheel->current ? DUE_SLOT : OVERFLOW_SLOT;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS && slot == OVERFLOW_SLOT; level++) {
+        if (delta < (uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1))) {
+            slot = level * TIMER_WHEEL_SLOTS + (int)((tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+        }
+    }
+
+    int32_t *head = slot_head(wheel, slot);
+    if (*head == TIMER_NONE) {
+        count_slot(wheel, slot, 1);
+    } else {
+        wheel->nodes[*head].prev = id;
+    }
+    node->next = *head;
+    node->prev = -slot - 2;
+    *head = id;
+    wheel->count++;
+}
+
+// Take a slot's whole list; its timers are disarmed by the caller's walk
+static int32_t detach_slot(TimerWheel *wheel, int slot) {
+    int32_t *head = slot_head(wheel, slot);
+    int32_t first = *head;
+    if (first != TIMER_NONE) {
+        *head = TIMER_NONE;
+        count_slot(wheel, slot, -1);
+    }
+    return first;
+}
+
+// Move a higher-level slot's timers to the levels below as its span begins
+static void cascade(TimerWheel *wheel, int slot) {
+    for (int32_t id = detach_slot(wheel, slot); id != TIMER_NONE; ) {
+        int32_t next = wheel->nodes[id].next;
+        wheel->count--;
+        link_timer(wheel, id);
+        id = next;
+    }
+}
+
+static void fire_slot(TimerWheel *wheel, int slot, TimerCallback fire, void *context) {
+    for (int32_t id = detach_slot(wheel, slot); id != TIMER_NONE; ) {
+        TimerNode *node = &wheel->nodes[id];
+        int32_t next = node->next;
+        node->prev = TIMER_NONE;
+        wheel->count--;
+        fire(context, id, node->expiry);
+        id = next;
+    }
+}
+
+// Arm a disarmed timer
+void arm_timer(TimerWheel *wheel, int32_t id, double expiry) {
+    wheel->nodes[id].expiry = expiry;
+    link_timer(wheel, id);
+}
+
+// Disarm a timer; does nothing if it already fired or was never armed
+void cancel_timer(TimerWheel *wheel, int32_t id) {
+    TimerNode *node = &wheel->nodes[id];
+    if (node->prev == TIMER_NONE) return;
+
+    if (node->prev >= 0) {
+        wheel->nodes[node->prev].next = node->next;
+    } else {
+        int slot = -node->prev - 2;
+        *slot_head(wheel, slot) = node->next;
+        if (node->next == TIMER_NONE) {
+            count_slot(wheel, slot, -1);
+        }
+    }
+    if (node->next != TIMER_NONE) {
+        wheel->nodes[node->next].prev = node->prev;
+    }
+    node->prev = TIMER_NONE;
+    wheel->count--;
+}
+
+// Fire every timer in a tick at or before now's, in no particular order, so
+// each may fire up to one tick early. Timers armed behind the wheel fire
+// first. Stretches where the lower levels are empty are skipped a whole block
+// at a time. Callbacks must not arm timers.
+void expire_timers(TimerWheel *wheel, double now, TimerCallback fire, void *context) {
+    fire_slot(wheel, DUE_SLOT, fire, context);
+
+    uint64_t target = time_tick(wheel, now);
+    if (target == MAX_TICK) {
+        for (int slot = 0; slot <= OVERFLOW_SLOT; slot++) {
+            fire_slot(wheel, slot, fire, context);
+        }
+        return;
+    }
+
+    while (wheel->count > 0 && wheel->current <= target) {
+        uint64_t current = wheel->current;
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if ((current >> (TIMER_WHEEL_BITS * (level - 1))) & SLOT_MASK) break;
+            cascade(wheel, level * TIMER_WHEEL_SLOTS + (int)((current >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK));
+        }
+        if (current % WHEEL_SPAN == 0) {
+            cascade(wheel, OVERFLOW_SLOT);
+        }
+        fire_slot(wheel, (int)(current & SLOT_MASK), fire, context);
+
+        // Jump to the next block boundary of the lowest non-empty level, but
+        // never past the target: a timer armed later must not land behind us
+        uint64_t next = current + 1;
+        for (int level = 0; level < TIMER_WHEEL_LEVELS && wheel->level_count[level] == 0; level++) {
+            uint64_t span = (uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1));
+            next = (current / span + 1) * span;
+        }
+        wheel->current = next < target + 1 ? next : target + 1;
+    }
+    if (wheel->current <= target) {
+        wheel->current = target + 1;
+    }
+}
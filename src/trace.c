@@ -0,0 +1,344 @@
+#include "trace.h"
+#include "department.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TRACE_MAX_FIELD 256
+#define TRACE_RELEASE_CHUNK (64UL << 20)  // Drop parsed pages every 64 MB
+
+// CSV layout, one arrival per line (blank lines and '#' comments skipped,
+// an optional header line first):
+//   arrival,route,triage,service_times
+// arrival        Unix seconds or "YYYY-MM-DD[T ]HH:MM[:SS[.fff]]" (UTC)
+// route          A-D, or department names joined by '>' (Emergency>Radiology>Billing)
+// triage         1-5, may be empty
+// service_times  Observed seconds per hop joined by ';', empty entries drawn from the model
+
+static void trace_error(const TraceReader *reader, const char *problem) {
+    if (reader->binary) {
+        fprintf(stderr, "%s: record %lld: %s\n", reader->path, (long long)reader->records + 1, problem);
+    } else {
+        fprintf(stderr, "%s:%lld: %s\n", reader->path, (long long)reader->line, problem);
+    }
+}
+
+// Give back the pages the cursor has moved past; the file stays in the page
+// cache, but the process no longer holds it mapped
+static void release_parsed_pages(TraceReader *reader) {
+    if (reader->offset - reader->released < TRACE_RELEASE_CHUNK) return;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t upto = reader->offset & ~(page - 1);
+    madvise((void*)(reader->mapping + reader->released), upto - reader->released, MADV_DONTNEED);
+    reader->released = upto;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static long days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long year_of_era = year - era * 400;
+    long day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+// Unix seconds or an ISO 8601 UTC timestamp
+static int parse_timestamp(const char *text, double *seconds) {
+    char *end;
+    double value = strtod(text, &end);
+    if (end != text && *end == '\0') {
+        if (!isfinite(value)) return -1;
+        *seconds = value;
+        return 0;
+    }
+
+    int year, month, day, hour, minute, consumed = 0;
+    char separator;
+    if (sscanf(text, "%4d-%2d-%2d%c%2d:%2d%n", &year, &month, &day, &separator,
+               &hour, &minute, &consumed) != 6 || (separator != 'T' && separator != ' ')) {
+        return -1;
+    }
+    double second = 0.0;
+    const char *rest = text + consumed;
+    if (*rest == ':') {
+        second = strtod(rest + 1, &end);
+        if (end == rest + 1) return -1;
+        rest = end;
+    }
+    if (*rest == 'Z') rest++;
+    if (*rest != '\0' || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour > 23 || minute > 59 || second < 0.0 || second >= 61.0) {
+        return -1;
+    }
+
+    *seconds = days_from_civil(year, month, day) * 86400.0 + hour * 3600.0 + minute * 60.0 + second;
+    return 0;
+}
+
+// A built-in route letter or a '>'-separated list of department names
+static int parse_route(char *text, TraceRecord *record) {
+    if (text[0] != '\0' && text[1] == '\0') {
+        int route = toupper((unsigned char)text[0]) - 'A';
+        if (route < ROUTE_A || route > ROUTE_D) return -1;
+        DepartmentType dept;
+        while ((dept = get_route_department((RouteType)route, record->num_hops)) != (DepartmentType)-1) {
+            record->path[record->num_hops++] = (uint8_t)dept;
+        }
+        return 0;
+    }
+
+    char *save = NULL;
+    for (char *name = strtok_r(text, ">", &save); name; name = strtok_r(NULL, ">", &save)) {
+        while (isspace((unsigned char)*name)) name++;
+        char *end = name + strlen(name);
+        while (end > name && isspace((unsigned char)end[-1])) *--end = '\0';
+
+        int dept = 0;
+        while (dept < NUM_DEPARTMENTS && strcasecmp(name, get_department_name((DepartmentType)dept)) != 0) {
+            dept++;
+        }
+        if (dept == NUM_DEPARTMENTS || record->num_hops == MAX_ROUTE_HOPS) return -1;
+        record->path[record->num_hops++] = (uint8_t)dept;
+    }
+    return record->num_hops > 0 ? 0 : -1;
+}
+
+// ';'-separated seconds per hop; empty entries keep TRACE_NO_SERVICE_TIME
+static int parse_service_times(const char *text, TraceRecord *record) {
+    const char *p = text;
+    for (int hop = 0; *p; hop++) {
+        if (hop == record->num_hops) return -1;
+        if (*p != ';') {
+            char *end;
+            double seconds = strtod(p, &end);
+            if (end == p || !isfinite(seconds) || seconds < 0.0 || (*end != ';' && *end != '\0')) {
+                return -1;
+            }
+            record->service_time[hop] = (float)seconds;
+            p = end;
+        }
+        if (*p == ';') p++;
+    }
+    return 0;
+}
+
+// Copy the next comma-separated field, trimmed, into field; returns the
+// position after it or NULL if it does not fit
+static const char* take_field(const char *p, const char *eol, char *field) {
+    while (p < eol && (*p == ' ' || *p == '\t')) p++;
+    const char *start = p;
+    while (p < eol && *p != ',') p++;
+    const char *end = p;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+
+    if (end - start >= TRACE_MAX_FIELD) return NULL;
+    memcpy(field, start, end - start);
+    field[end - start] = '\0';
+    return p < eol ? p + 1 : p;
+}
+
+static int next_csv_record(TraceReader *reader, TraceRecord *record) {
+    const char *end = reader->mapping + reader->mapping_size;
+
+    while (reader->offset < reader->mapping_size) {
+        const char *line = reader->mapping + reader->offset;
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        reader->offset = (eol - reader->mapping) + (eol < end);
+        reader->line++;
+        release_parsed_pages(reader);
+
+        if (eol > line && eol[-1] == '\r') eol--;
+        const char *p = line;
+        while (p < eol && isspace((unsigned char)*p)) p++;
+        if (p == eol || *p == '#') continue;
+
+        char fields[4][TRACE_MAX_FIELD];
+        int num_fields = 0;
+        while (num_fields < 4 && p && (p < eol || num_fields == 0)) {
+            p = take_field(p, eol, fields[num_fields++]);
+        }
+        if (!p || p < eol) {
+            trace_error(reader, "too many or overlong fields");
+            return -1;
+        }
+
+        memset(record, 0, sizeof(TraceRecord));
+        for (int hop = 0; hop < MAX_ROUTE_HOPS; hop++) {
+            record->service_time[hop] = TRACE_NO_SERVICE_TIME;
+        }
+
+        int may_be_header = !reader->header_checked;
+        reader->header_checked = 1;
+        if (parse_timestamp(fields[0], &record->arrival_time) != 0) {
+            if (may_be_header && isalpha((unsigned char)fields[0][0])) continue;
+            trace_error(reader, "bad arrival time");
+            return -1;
+        }
+        if (num_fields < 2 || parse_route(fields[1], record) != 0) {
+            trace_error(reader, "bad route");
+            return -1;
+        }
+        if (num_fields > 2 && fields[2][0] != '\0') {
+            char *triage_end;
+            long triage = strtol(fields[2], &triage_end, 10);
+            if (*triage_end != '\0' || triage < 0 || triage > 5) {
+                trace_error(reader, "triage level must be 1-5");
+                return -1;
+            }
+            record->triage = (uint8_t)triage;
+        }
+        if (num_fields > 3 && parse_service_times(fields[3], record) != 0) {
+            trace_error(reader, "bad service times");
+            return -1;
+        }
+
+        reader->records++;
+        return 1;
+    }
+    return 0;
+}
+
+static int next_binary_record(TraceReader *reader, TraceRecord *record) {
+    if (reader->offset + sizeof(TraceRecord) > reader->mapping_size) return 0;
+
+    memcpy(record, reader->mapping + reader->offset, sizeof(TraceRecord));
+    reader->offset += sizeof(TraceRecord);
+    release_parsed_pages(reader);
+
+    int valid = isfinite(record->arrival_time) && record->num_hops >= 1 &&
+                record->num_hops <= MAX_ROUTE_HOPS && record->triage <= 5;
+    for (int hop = 0; valid && hop < record->num_hops; hop++) {
+        valid = record->path[hop] < NUM_DEPARTMENTS && isfinite(record->service_time[hop]);
+    }
+    if (!valid) {
+        trace_error(reader, "corrupt record");
+        return -1;
+    }
+
+    reader->records++;
+    return 1;
+}
+
+// Map a trace for streaming; the format is detected from the magic
+int open_trace(const char *path, TraceReader *reader) {
+    memset(reader, 0, sizeof(TraceReader));
+    reader->path = path;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror("open trace");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty trace\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("mmap trace");
+        return -1;
+    }
+    madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+    reader->mapping = (const char*)mapping;
+    reader->mapping_size = st.st_size;
+
+    const TraceFileHeader *header = (const TraceFileHeader*)mapping;
+    if ((size_t)st.st_size < sizeof(TraceFileHeader) ||
+        memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0) {
+        return 0;  // CSV
+    }
+
+    const char *problem = NULL;
+    if (header->version != TRACE_VERSION) {
+        problem = "unsupported trace version";
+    } else if (header->record_size != sizeof(TraceRecord)) {
+        problem = "record layout differs from this build";
+    } else if (header->num_records < 0 ||
+               sizeof(TraceFileHeader) + (uint64_t)header->num_records * sizeof(TraceRecord) != (uint64_t)st.st_size) {
+        problem = "truncated trace";
+    }
+    if (problem) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        close_trace(reader);
+        return -1;
+    }
+
+    reader->binary = 1;
+    reader->offset = sizeof(TraceFileHeader);
+    return 0;
+}
+
+// Read the next record: 1 when one was read, 0 at the end, -1 on a bad record
+int next_trace_record(TraceReader *reader, TraceRecord *record) {
+    return reader->binary ? next_binary_record(reader, record) : next_csv_record(reader, record);
+}
+
+void close_trace(TraceReader *reader) {
+    if (reader->mapping) {
+        munmap((void*)reader->mapping, reader->mapping_size);
+    }
+    memset(reader, 0, sizeof(TraceReader));
+}
+
+// Rewrite a trace in the binary format, which loads without parsing
+int convert_trace(const char *path, const char *output_path) {
+    TraceReader reader;
+    if (open_trace(path, &reader) != 0) return -1;
+
+    FILE *output = fopen(output_path, "wb");
+    if (!output) {
+        perror("open binary trace");
+        close_trace(&reader);
+        return -1;
+    }
+
+    TraceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    fwrite(&header, sizeof(header), 1, output);
+
+    TraceRecord record;
+    int status;
+    while ((status = next_trace_record(&reader, &record)) == 1) {
+        fwrite(&record, sizeof(record), 1, output);
+    }
+
+    header.num_records = reader.records;
+    fseek(output, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, output);
+    if (ferror(output)) {
+        status = -1;
+    }
+    if (fclose(output) != 0) {
+        status = -1;
+    }
+    close_trace(&reader);
+
+    if (status != 0) {
+        fprintf(stderr, "Failed to convert %s\n", path);
+        unlink(output_path);
+        return -1;
+    }
+    printf("Converted %lld arrivals: %s -> %s\n", (long long)header.num_records, path, output_path);
+    log_message(LOG_INFO, "Converted trace %s to %s (%lld records)", path, output_path,
+                (long long)header.num_records);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "work_deque.h"
+#include "logger.h"
+#include <stdlib.h>
+
+// Initialize deque with 2^capacity_log2 slots
+int init_work_deque(WorkDeque *deque, int capacity_log2) {
+    int64_t capacity = (int64_t)1 << capacity_log2;
+    
+    deque->buffer = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    if (!deque->buffer) {
+        log_message(LOG_ERROR, "Failed to allocate work deque of %ld slots", (long)capacity);
+        return -1;
+    }
+    
+    deque->top = 0;
+    deque->bottom = 0;
+    deque->mask = capacity - 1;
+    return 0;
+}
+
+// Free deque storage
+void destroy_work_deque(WorkDeque *deque) {
+    free(deque->buffer);
+    deque->buffer = NULL;
+}
+
+// Owner: push task at the bottom, returns -1 if the deque is full
+int push_work(WorkDeque *deque, uint64_t task) {
+    int64_t b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    
+    if (b - t > deque->mask) {
+        return -1;
+    }
+    
+    __atomic_store_n(&deque->buffer[b & deque->mask], task, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Owner: take most recently pushed task
+uint64_t take_work(WorkDeque *deque) {
+    int64_t b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+    
+    if (t > b) {
+        // Empty: restore bottom
+        __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+        return DEQUE_EMPTY;
+    }
+    
+    uint64_t task = __atomic_load_n(&deque->buffer[b & deque->mask], __ATOMIC_RELAXED);
+    if (t == b) {
+        // Last task: race against thieves for it
+        if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            task = DEQUE_EMPTY;
+        }
+        __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+// Thief: steal oldest task, DEQUE_ABORT if another thread won the race
+uint64_t steal_work(WorkDeque *deque) {
+    int64_t t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    
+    if (t >= b) {
+        return DEQUE_EMPTY;
+    }
+    
+    uint64_t task = __atomic_load_n(&deque->buffer[t & deque->mask], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return DEQUE_ABORT;
+    }
+    return task;
+}
@@ -0,0 +1,27 @@
+#include "series.h"
+#include "department.h"
+#include <stdio.h>
+
+// Export a time series written with --series as CSV, to a file or stdout
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s SERIES_FILE [CSV_FILE]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *output = stdout;
+    if (argc == 3) {
+        output = fopen(argv[2], "w");
+        if (!output) {
+            perror("open CSV");
+            return 1;
+        }
+    }
+
+    init_department_configs();
+    int result = export_series_csv(argv[1], output);
+    if (output != stdout && fclose(output) != 0) {
+        result = -1;
+    }
+    return result == 0 ? 0 : 1;
+}